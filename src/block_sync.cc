@@ -16,12 +16,14 @@
  */
 #include "src/block_sync.hh"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <utility>
 
+#include "src/constants.hh"
 #include "src/group.hh"
 #include "src/options.hh"
 
@@ -67,6 +69,17 @@ Offset getNextOffsetFor(Offset this_offset) {
   return Offset::A;
 }
 
+// Offset words, IEC 62106:2015 section B.3.1 Table B.1
+// clang-format off
+constexpr std::array<std::pair<Offset, std::uint32_t>, 5> kOffsetWords{{
+    { Offset::A,      0b0011111100 },
+    { Offset::B,      0b0110011000 },
+    { Offset::C,      0b0101101000 },
+    { Offset::Cprime, 0b1101010000 },
+    { Offset::D,      0b0110110100 }
+}};
+// clang-format on
+
 // IEC 62106:2015 section B.3.1 Table B.1
 Offset getOffsetForSyndrome(std::uint32_t syndrome) {
   switch (syndrome) {
@@ -80,103 +93,167 @@ Offset getOffsetForSyndrome(std::uint32_t syndrome) {
   }
 }
 
+// clang-format off
+constexpr std::array<std::uint32_t, kBlockLength> kParityCheckMatrix{
+  0b1000000000,
+  0b0100000000,
+  0b0010000000,
+  0b0001000000,
+  0b0000100000,
+  0b0000010000,
+  0b0000001000,
+  0b0000000100,
+  0b0000000010,
+  0b0000000001,
+  0b1011011100,
+  0b0101101110,
+  0b0010110111,
+  0b1010000111,
+  0b1110011111,
+  0b1100010011,
+  0b1101010101,
+  0b1101110110,
+  0b0110111011,
+  0b1000000001,
+  0b1111011100,
+  0b0111101110,
+  0b0011110111,
+  0b1010100111,
+  0b1110001111,
+  0b1100011011
+};
+// clang-format on
+
+// g(x) = x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1 (EN 50067:1998, section B.1.1)
+constexpr std::uint32_t kGeneratorPolynomial = 0b101'1011'1001;
+
 // \param input_vector 26-bit word
 // \return 10-bit syndrome
-std::uint32_t calculateSyndrome(std::uint32_t input_vector) {
-  // clang-format off
-  constexpr std::array<std::uint32_t, 26> parity_check_matrix{
-    0b1000000000,
-    0b0100000000,
-    0b0010000000,
-    0b0001000000,
-    0b0000100000,
-    0b0000010000,
-    0b0000001000,
-    0b0000000100,
-    0b0000000010,
-    0b0000000001,
-    0b1011011100,
-    0b0101101110,
-    0b0010110111,
-    0b1010000111,
-    0b1110011111,
-    0b1100010011,
-    0b1101010101,
-    0b1101110110,
-    0b0110111011,
-    0b1000000001,
-    0b1111011100,
-    0b0111101110,
-    0b0011110111,
-    0b1010100111,
-    0b1110001111,
-    0b1100011011
-  };
-  // clang-format on
-
+constexpr std::uint32_t calculateSyndrome(std::uint32_t input_vector) {
   // EN 50067:1998, section B.1.1: Matrix multiplication is '-- calculated by
   // the modulo-two addition of all the rows of the -- matrix for which the
   // corresponding coefficient in the -- vector is 1.'
 
   std::uint32_t result{};
 
-  for (std::size_t k = 0; k < parity_check_matrix.size(); k++)
-    result ^= static_cast<std::uint32_t>(parity_check_matrix[parity_check_matrix.size() - 1U - k] *
+  for (std::size_t k = 0; k < kParityCheckMatrix.size(); k++)
+    result ^= static_cast<std::uint32_t>(kParityCheckMatrix[kParityCheckMatrix.size() - 1U - k] *
                                          (static_cast<std::uint32_t>(input_vector >> k) & 1U));
 
   return result;
 }
 
-// Precompute mapping of syndromes to error vectors
+// The block code is a shortened cyclic code, so shifting a word left by one bit multiplies its
+// syndrome by x, modulo g(x). This lets us keep the syndrome of a sliding window up to date one
+// bit at a time.
+constexpr std::uint32_t multiplySyndromeByX(std::uint32_t syndrome) {
+  syndrome <<= 1U;
+  if ((syndrome & (1U << kCheckwordLength)) != 0)
+    syndrome ^= kGeneratorPolynomial;
+  return syndrome;
+}
+
+static_assert(multiplySyndromeByX(calculateSyndrome(1U << 12U)) == calculateSyndrome(1U << 13U));
+
+// Contribution of the bit entering the window, and of the one leaving it (bit 26)
+constexpr std::uint32_t kSyndromeOfNewestBit = calculateSyndrome(1U);
+constexpr std::uint32_t kSyndromeOfDroppedBit =
+    multiplySyndromeByX(calculateSyndrome(1U << (kBlockLength - 1U)));
+
+constexpr std::uint32_t burstLength(std::uint32_t error_vector) {
+  std::uint32_t first{kBlockLength};
+  std::uint32_t last{0};
+  for (std::uint32_t i = 0; i < kBlockLength; i++) {
+    if (((error_vector >> i) & 1U) != 0) {
+      first = std::min(first, i);
+      last  = i;
+    }
+  }
+  return first > last ? 0 : last - first + 1;
+}
+
+struct BurstError {
+  std::uint32_t error_vector{};
+  // 0 = no correctable error has this syndrome
+  std::uint32_t burst_length{};
+};
+
+using ErrorLookupTable = std::array<std::array<BurstError, 1U << kCheckwordLength>, 5>;
+
+// Precompute mapping of syndromes to error vectors, directly indexed by the syndrome.
 // IEC 62106:2015 section B.3.1
-// Array of four vectors, one for each offset word.
-std::array<std::vector<std::pair<std::uint32_t, std::uint32_t>>, 5> makeErrorLookupTable() {
-  std::array<std::vector<std::pair<std::uint32_t, std::uint32_t>>, 5> lookup_table;
-
-  // Table B.1
-  // clang-format off
-  constexpr std::array<std::pair<Offset, std::uint32_t>, 5> offset_words{{
-      { Offset::A,      0b0011111100 },
-      { Offset::B,      0b0110011000 },
-      { Offset::C,      0b0101101000 },
-      { Offset::Cprime, 0b1101010000 },
-      { Offset::D,      0b0110110100 }
-  }};
-  // clang-format on
-
-  for (const auto& offset : offset_words) {
-    // Kopitz & Marks 1999: "RDS: The Radio Data System", p. 224:
-    // "...the error-correction system should be enabled, but should be
-    // restricted by attempting to correct bursts of errors spanning one or two
-    // bits."
-    for (const std::uint32_t error_bits : {0b1u, 0b11u}) {
-      for (std::uint32_t shift = 0; shift < kBlockLength; shift++) {
-        const std::uint32_t error_vector = ((error_bits << shift) & kBlockBitmask);
-
-        const std::uint32_t syndrome = calculateSyndrome(error_vector ^ offset.second);
-        lookup_table[static_cast<std::size_t>(offset.first)].emplace_back(syndrome, error_vector);
+// One table for each offset word.
+constexpr ErrorLookupTable makeErrorLookupTable() {
+  ErrorLookupTable lookup_table{};
+
+  for (const auto& offset : kOffsetWords) {
+    auto& table = lookup_table[static_cast<std::size_t>(offset.first)];
+
+    // All bursts up to the maximum length, shortest first. Every one of them has a unique
+    // syndrome.
+    for (std::uint32_t length = 1; length <= static_cast<std::uint32_t>(kMaxBurstErrorLength);
+         length++) {
+      const std::uint32_t num_patterns = length <= 2 ? 1U : 1U << (length - 2U);
+      for (std::uint32_t middle_bits = 0; middle_bits < num_patterns; middle_bits++) {
+        const std::uint32_t error_bits =
+            length == 1 ? 1U : (1U << (length - 1U)) | (middle_bits << 1U) | 1U;
+
+        for (std::uint32_t shift = 0; shift + length <= kBlockLength; shift++) {
+          const std::uint32_t error_vector = error_bits << shift;
+          const std::uint32_t syndrome     = calculateSyndrome(error_vector ^ offset.second);
+          if (table[syndrome].burst_length == 0)
+            table[syndrome] = BurstError{error_vector, length};
+        }
       }
     }
   }
   return lookup_table;
 }
 
-// EN 50067:1998, section B.2.2
-ErrorCorrectionResult correctBurstErrors(Block block, Offset expected_offset) {
-  static const auto error_lookup_table = makeErrorLookupTable();
+constexpr ErrorLookupTable kErrorLookupTable = makeErrorLookupTable();
+
+// Soft-decision decoding: a Chase-style search over the least reliable bits of a block. Their
+// number is kept small, since every extra pattern also adds a chance of accepting a wrong block.
+// With 5 bits, about 2% of the blocks it recovers from white noise are wrong, which is less than
+// for burst error correction; fewer bits recover markedly fewer blocks. See the "Soft-decision
+// error correction gain" benchmark.
+constexpr std::size_t kNumChaseBits = 5;
+// Bits more reliable than this (on the 0..255 scale) are never flipped; ~0.5 after the AGC
+constexpr std::uint8_t kMaxChaseReliability = 64;
+
+// Syndrome of a single bit error at each position of the block (0 = last bit received)
+constexpr std::array<std::uint32_t, kBlockLength> makeSingleBitSyndromes() {
+  std::array<std::uint32_t, kBlockLength> syndromes{};
+  for (std::uint32_t i = 0; i < kBlockLength; i++) syndromes[i] = calculateSyndrome(1U << i);
+  return syndromes;
+}
 
-  ErrorCorrectionResult result;
+constexpr std::array<std::uint32_t, kBlockLength> kSingleBitSyndromes = makeSingleBitSyndromes();
 
-  const std::uint32_t syndrome = calculateSyndrome(block.raw);
-  result.corrected_bits        = block.raw;
+// Syndrome of an error-free block with each offset word
+constexpr std::array<std::uint32_t, 5> makeOffsetSyndromes() {
+  std::array<std::uint32_t, 5> syndromes{};
+  for (const auto& offset : kOffsetWords)
+    syndromes[static_cast<std::size_t>(offset.first)] = calculateSyndrome(offset.second);
+  return syndromes;
+}
 
-  const auto& table = error_lookup_table[static_cast<std::size_t>(expected_offset)];
+constexpr std::array<std::uint32_t, 5> kOffsetSyndromes = makeOffsetSyndromes();
 
-  const auto search = std::find_if(table.begin(), table.end(),
-                                   [syndrome](const auto& pair) { return pair.first == syndrome; });
-  if (search != table.end()) {
-    const std::uint32_t error_vector = search->second;
-    result.corrected_bits ^= error_vector;
+static_assert(kOffsetSyndromes[static_cast<std::size_t>(Offset::A)] == 0b1111011000);
+
+// EN 50067:1998, section B.2.2
+// \param syndrome Syndrome of block.raw
+ErrorCorrectionResult correctBurstErrors(Block block, Offset expected_offset,
+                                         std::uint32_t syndrome, std::uint32_t max_burst_length) {
+  ErrorCorrectionResult result;
+  result.corrected_bits = block.raw;
+
+  const BurstError& burst =
+      kErrorLookupTable[static_cast<std::size_t>(expected_offset)][syndrome];
+
+  if (burst.burst_length > 0 && burst.burst_length <= max_burst_length) {
+    result.corrected_bits ^= burst.error_vector;
     result.succeeded = true;
   }
 
@@ -251,8 +328,16 @@ void BlockStream::acquireSync(Block block) {
 }
 
 // Receive a new bit
-void BlockStream::pushBit(bool bit) {
-  input_register_ = (input_register_ << 1U) + bit;
+// \param reliability How sure the demodulator is about the bit (0 to kMaxBitReliability)
+void BlockStream::pushBit(bool bit, std::uint8_t reliability) {
+  const bool is_dropped_bit_set = ((input_register_ >> (kBlockLength - 1U)) & 1U) != 0;
+
+  syndrome_register_ = multiplySyndromeByX(syndrome_register_) ^
+                       (is_dropped_bit_set ? kSyndromeOfDroppedBit : 0U) ^
+                       (bit ? kSyndromeOfNewestBit : 0U);
+  input_register_    = (input_register_ << 1U) + bit;
+  reliability_register_[reliability_write_index_] = reliability;
+  reliability_write_index_ = (reliability_write_index_ + 1U) % kBlockLength;
   num_bits_until_next_block_--;
   bitcount_++;
 
@@ -267,7 +352,7 @@ void BlockStream::pushBit(bool bit) {
 void BlockStream::findBlockInInputRegister() {
   Block block;
   block.raw    = input_register_ & kBlockBitmask;
-  block.offset = getOffsetForSyndrome(calculateSyndrome(block.raw));
+  block.offset = getOffsetForSyndrome(syndrome_register_);
 
   acquireSync(block);
 
@@ -289,10 +374,18 @@ void BlockStream::findBlockInInputRegister() {
     block.data = static_cast<std::uint16_t>(block.raw >> kCheckwordLength);
 
     if (block.had_errors && options_.use_fec) {
-      const auto correction = correctBurstErrors(block, expected_offset_);
+      const auto correction = correctBurstErrors(block, expected_offset_, syndrome_register_,
+                                                 options_.max_burst_length);
       if (correction.succeeded) {
         block.data   = static_cast<std::uint16_t>(correction.corrected_bits >> kCheckwordLength);
         block.offset = expected_offset_;
+      } else if (options_.soft_fec) {
+        const auto soft_correction = correctLeastReliableBits(block);
+        if (soft_correction.succeeded) {
+          block.data =
+              static_cast<std::uint16_t>(soft_correction.corrected_bits >> kCheckwordLength);
+          block.offset = expected_offset_;
+        }
       }
     }
 
@@ -312,6 +405,52 @@ void BlockStream::findBlockInInputRegister() {
   }
 }
 
+// Flip every combination of the least reliable bits in the block and see if one of them gives the
+// expected syndrome. If several do, the one that needs the least confident flips wins.
+ErrorCorrectionResult BlockStream::correctLeastReliableBits(Block block) const {
+  ErrorCorrectionResult result;
+  result.corrected_bits = block.raw;
+
+  // Bit position in the block (0 = last received), and its reliability
+  std::array<std::pair<std::uint32_t, std::uint8_t>, kBlockLength> bits{};
+  for (std::uint32_t i = 0; i < kBlockLength; i++) {
+    const std::uint32_t i_ring =
+        (reliability_write_index_ + kBlockLength - 1U - i) % kBlockLength;
+    bits[i] = {i, reliability_register_[i_ring]};
+  }
+  std::partial_sort(bits.begin(), bits.begin() + kNumChaseBits, bits.end(),
+                    [](const auto& a, const auto& b) { return a.second < b.second; });
+
+  std::size_t num_candidates{};
+  while (num_candidates < kNumChaseBits && bits[num_candidates].second < kMaxChaseReliability)
+    num_candidates++;
+
+  const std::uint32_t expected_syndrome =
+      kOffsetSyndromes[static_cast<std::size_t>(expected_offset_)];
+  std::uint32_t best_cost{~0U};
+
+  for (std::uint32_t pattern = 1; pattern < (1U << num_candidates); pattern++) {
+    std::uint32_t syndrome{syndrome_register_};
+    std::uint32_t error_vector{};
+    std::uint32_t cost{};
+    for (std::size_t i = 0; i < num_candidates; i++) {
+      if (((pattern >> i) & 1U) != 0) {
+        syndrome ^= kSingleBitSyndromes[bits[i].first];
+        error_vector |= 1U << bits[i].first;
+        cost += bits[i].second;
+      }
+    }
+
+    if (syndrome == expected_syndrome && cost < best_cost) {
+      best_cost             = cost;
+      result.corrected_bits = block.raw ^ error_vector;
+      result.succeeded      = true;
+    }
+  }
+
+  return result;
+}
+
 // Called after a whole group of four blocks was received.
 void BlockStream::handleNewlyReceivedGroup() {
   ready_group_     = current_group_;
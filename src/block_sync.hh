@@ -22,6 +22,7 @@
 
 #include "src/constants.hh"
 #include "src/group.hh"
+#include "src/io/bitbuffer.hh"
 #include "src/options.hh"
 #include "src/util/util.hh"
 
@@ -53,7 +54,7 @@ class BlockStream {
  public:
   BlockStream() = default;
   void init(const Options& options);
-  void pushBit(bool bit);
+  void pushBit(bool bit, std::uint8_t reliability = kMaxBitReliability);
   Group popGroup();
   [[nodiscard]] bool hasGroupReady() const;
   [[nodiscard]] Group flushCurrentGroup() const;
@@ -62,11 +63,17 @@ class BlockStream {
  private:
   void acquireSync(Block block);
   void findBlockInInputRegister();
+  [[nodiscard]] ErrorCorrectionResult correctLeastReliableBits(Block block) const;
   void handleNewlyReceivedGroup();
 
   std::uint32_t bitcount_{0};
   std::uint32_t num_bits_until_next_block_{1};
   std::uint32_t input_register_{0};
+  // Syndrome of the last 26 bits in input_register_
+  std::uint32_t syndrome_register_{0};
+  // Reliabilities of the bits in input_register_, as a ring buffer
+  std::array<std::uint8_t, 26> reliability_register_{};
+  std::uint32_t reliability_write_index_{0};
   Offset expected_offset_{Offset::A};
   bool is_in_sync_{false};
   RunningSum<int, 50> block_error_sum50_;
@@ -72,14 +72,9 @@ void Channel::processBit(bool bit, std::size_t which_data_stream, std::ostream&
 // \param buffer A bit buffer corresponding to 1 chunk of MPX
 void Channel::processBits(const BitBuffer& buffer, std::ostream& output_ostream) {
   for (int which_data_stream{}; which_data_stream < buffer.n_streams; which_data_stream++) {
-    for (std::size_t i_bit = 0; i_bit < buffer.bits[which_data_stream].size(); i_bit++) {
-      block_streams_[which_data_stream].pushBit(buffer.bits[which_data_stream].at(i_bit).value);
-
-      if (options_.time_from_start) {
-        delayed_time_offset_[which_data_stream].push(
-            buffer.chunk_time_from_start +
-            buffer.bits[which_data_stream].at(i_bit).time_from_chunk_start);
-      }
+    const auto& bits = buffer.bits[which_data_stream];
+    for (std::size_t i_bit = 0; i_bit < bits.size(); i_bit++) {
+      block_streams_[which_data_stream].pushBit(bits.get(i_bit), bits.getReliability(i_bit));
 
       if (block_streams_[which_data_stream].hasGroupReady()) {
         Group group = block_streams_[which_data_stream].popGroup();
@@ -90,7 +85,7 @@ void Channel::processBits(const BitBuffer& buffer, std::ostream& output_ostream)
           auto group_time =
               buffer.time_received -
               std::chrono::milliseconds(static_cast<int>(
-                  static_cast<double>(buffer.bits[which_data_stream].size() - 1 - i_bit) /
+                  static_cast<double>(bits.size() - 1 - i_bit) /
                   kBitsPerSecond * 1e3));
 
           // When the source is faster than real-time, backwards timestamp calculation
@@ -105,8 +100,11 @@ void Channel::processBits(const BitBuffer& buffer, std::ostream& output_ostream)
         }
 
         if (options_.time_from_start) {
-          // Remember the time_from_start from 104 bits ago = first bit of this group
-          group.setTimeFromStart(delayed_time_offset_[which_data_stream].get());
+          // The group started 104 bits before this one
+          group.setTimeFromStart(
+              buffer.chunk_time_from_start +
+              static_cast<double>(bits.getSamplePosition(i_bit) - 104 * kSamplesPerBit) /
+                  kTargetSampleRate_Hz);
         }
 
         processAndPrintGroup(group, which_data_stream, output_ostream);
@@ -178,7 +176,11 @@ void Channel::flush(std::ostream& output_ostream) {
 
 /// \note Not to be used for measurements - may lose precision
 float Channel::getSecondsSinceCarrierLost() const {
-  return static_cast<float>(block_streams_[0].getNumBitsSinceSyncLost()) / kBitsPerSecond;
+  return static_cast<float>(getNumBitsSinceCarrierLost()) / kBitsPerSecond;
+}
+
+std::uint32_t Channel::getNumBitsSinceCarrierLost() const {
+  return block_streams_[0].getNumBitsSinceSyncLost();
 }
 
 void Channel::resetPI() {
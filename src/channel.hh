@@ -88,6 +88,7 @@ class Channel {
                             std::ostream& output_ostream);
   void flush(std::ostream& output_ostream);
   [[nodiscard]] float getSecondsSinceCarrierLost() const;
+  [[nodiscard]] std::uint32_t getNumBitsSinceCarrierLost() const;
   void resetPI();
 
  private:
@@ -98,8 +99,6 @@ class Channel {
   Station station_;
   RunningAverage<float, kNumBlerAverageGroups> bler_average_;
   std::chrono::time_point<std::chrono::system_clock> last_group_rx_time_;
-  // When the first bit of this group was received
-  std::array<DelayLine<double, 104 + 1>, 4> delayed_time_offset_;
 };
 
 }  // namespace redsea
@@ -17,6 +17,8 @@
 #ifndef CONSTANTS_H_
 #define CONSTANTS_H_
 
+#include <cstdint>
+
 namespace redsea {
 
 // RDS bitrate
@@ -35,6 +37,14 @@ static_assert(kMaximumSampleRate_Hz < kTargetSampleRate_Hz / kLiquidMinimumResam
 
 constexpr float kMaxResampleRatio = kTargetSampleRate_Hz / kMinimumSampleRate_Hz;
 
+// Longest error burst the block code can correct (IEC 62106:2015, section B.3.1)
+constexpr int kMaxBurstErrorLength{5};
+// Kopitz & Marks 1999: "RDS: The Radio Data System", p. 224:
+// "...the error-correction system should be enabled, but should be
+// restricted by attempting to correct bursts of errors spanning one or two
+// bits."
+constexpr std::uint32_t kDefaultMaxBurstLength{2};
+
 // Channels take up memory, and we don't want to fill it up by accident.
 constexpr int kMaxNumChannels{32};
 
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/coeff_cache.hh"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "src/dsp/liquid_wrappers.hh"
+
+namespace redsea {
+
+namespace {
+
+// Orders the cached coefficient sets by their contents
+template <typename T>
+struct CompareContents {
+  bool operator()(const SharedCoeffs<T>& a, const SharedCoeffs<T>& b) const {
+    return *a < *b;
+  }
+};
+
+template <typename T>
+using CoeffSet = std::set<SharedCoeffs<T>, CompareContents<T>>;
+
+// Channels may be set up from several threads
+std::mutex& getCacheMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+template <typename T>
+SharedCoeffs<T> findOrInsert(CoeffSet<T>& cache, std::vector<T>&& coeffs) {
+  auto shared = std::make_shared<const std::vector<T>>(std::move(coeffs));
+  const std::lock_guard<std::mutex> lock(getCacheMutex());
+  return *cache.insert(std::move(shared)).first;
+}
+
+}  // namespace
+
+// \brief Same as liquid::designKaiserLowpass, but each filter is only designed once per process.
+SharedCoeffs<float> getKaiserLowpass(std::uint32_t len, float fc, float As, float mu) {
+  static std::map<std::tuple<std::uint32_t, float, float, float>, SharedCoeffs<float>> designs;
+
+  const auto key = std::make_tuple(len, fc, As, mu);
+  {
+    const std::lock_guard<std::mutex> lock(getCacheMutex());
+    const auto found = designs.find(key);
+    if (found != designs.end())
+      return found->second;
+  }
+
+  // Designed outside the lock; if another thread got there first, its copy is kept
+  auto coeffs = shareCoeffs(liquid::designKaiserLowpass(len, fc, As, mu));
+  const std::lock_guard<std::mutex> lock(getCacheMutex());
+  return designs.emplace(key, std::move(coeffs)).first->second;
+}
+
+// \brief Look up a set of coefficients in the process-wide cache, adding it the first time.
+// \return The cached copy; equal coefficients always give the same pointer
+SharedCoeffs<float> shareCoeffs(std::vector<float> coeffs) {
+  static CoeffSet<float> cache;
+  return findOrInsert(cache, std::move(coeffs));
+}
+
+SharedCoeffs<std::int16_t> shareCoeffs(std::vector<std::int16_t> coeffs) {
+  static CoeffSet<std::int16_t> cache;
+  return findOrInsert(cache, std::move(coeffs));
+}
+
+}  // namespace redsea
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_COEFF_CACHE_H_
+#define DSP_COEFF_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace redsea {
+
+// Filter coefficients are never modified after they're designed, so every filter that uses the
+// same ones can point to one read-only copy. With many channels and data streams that saves
+// both the repeated filter designs at startup and the cache space of the duplicate taps.
+
+template <typename T>
+using SharedCoeffs = std::shared_ptr<const std::vector<T>>;
+
+SharedCoeffs<float> getKaiserLowpass(std::uint32_t len, float fc, float As = 60.0f,
+                                     float mu = 0.0f);
+
+SharedCoeffs<float> shareCoeffs(std::vector<float> coeffs);
+SharedCoeffs<std::int16_t> shareCoeffs(std::vector<std::int16_t> coeffs);
+
+}  // namespace redsea
+
+#endif  // DSP_COEFF_CACHE_H_
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/decimator.hh"
+
+#include <array>
+#include <cassert>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+#include "src/dsp/simd.hh"
+#include "src/util/util.hh"
+
+namespace redsea {
+
+namespace {
+
+// Complex samples per iteration of the dot product. The independent accumulators let the
+// compiler vectorize the loop without reordering floating-point additions.
+constexpr std::size_t kDotProductUnroll = 4;
+
+// \param samples Interleaved I/Q, 2 * length floats
+// \param coeffs Duplicated coefficients, 2 * length floats
+// \param length Must be a multiple of kDotProductUnroll
+REDSEA_SIMD_INLINE
+std::complex<float> dotProduct(const float* samples, const float* coeffs, std::size_t length) {
+  std::array<float, 2 * kDotProductUnroll> acc{};
+
+  for (std::size_t i = 0; i < 2 * length; i += acc.size()) {
+    for (std::size_t j = 0; j < acc.size(); j++) {
+      acc[j] += coeffs[i + j] * samples[i + j];
+    }
+  }
+
+  std::complex<float> result;
+  for (std::size_t j = 0; j < acc.size(); j += 2) {
+    result += std::complex<float>(acc[j], acc[j + 1]);
+  }
+  return result;
+}
+
+// \brief One output for every ratio inputs, starting from input first_input.
+// \param samples Interleaved I/Q; the window for input i ends at sample i
+// \return Number of output samples written
+REDSEA_SIMD_CLONES
+std::size_t decimate(const float* samples, const float* coeffs, std::size_t padded_length,
+                     std::size_t first_input, std::size_t num_input, std::uint32_t ratio,
+                     std::complex<float>* output) {
+  std::size_t num_output{};
+  for (std::size_t i_input = first_input; i_input < num_input; i_input += ratio) {
+    output[num_output] = dotProduct(samples + 2 * i_input, coeffs, padded_length);
+    num_output++;
+  }
+  return num_output;
+}
+
+}  // namespace
+
+// \param coeffs Filter coefficients (impulse response) in natural order
+// \param ratio Decimation ratio; one output is computed for every `ratio` inputs
+void FIRDecimator::init(const std::vector<float>& coeffs, std::uint32_t ratio) {
+  assert(!coeffs.empty() && ratio >= 1);
+
+  filter_length_ = coeffs.size();
+  ratio_         = ratio;
+  next_output_   = 0;
+
+  const std::size_t padded_length = divideRoundingUp(filter_length_, kDotProductUnroll) *
+                                    kDotProductUnroll;
+
+  std::vector<float> prepared(2 * padded_length, 0.f);
+  for (std::size_t i = 0; i < filter_length_; i++) {
+    const std::size_t i_reversed = padded_length - 1 - i;
+    prepared[2 * i_reversed]     = coeffs[i];
+    prepared[2 * i_reversed + 1] = coeffs[i];
+  }
+  coeffs_ = shareCoeffs(std::move(prepared));
+
+  history_.assign(padded_length - 1, std::complex<float>{});
+}
+
+// \brief Filter and decimate a block of samples.
+// \param output Must have room for getOutputSize(num_input) samples
+// \return Number of output samples written
+// \note The output sample at index n corresponds to the input sample at index
+//       getNextOutputIndex() + n * ratio, as seen before the call.
+std::size_t FIRDecimator::execute(const std::complex<float>* input, std::size_t num_input,
+                                  std::complex<float>* output) {
+  const std::size_t padded_length = coeffs_->size() / 2;
+  const std::size_t num_history   = padded_length - 1;
+  assert(history_.size() == num_history);
+
+  history_.insert(history_.end(), input, input + num_input);
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const auto* samples = reinterpret_cast<const float*>(history_.data());
+
+  // Input sample i is at history_[num_history + i]; the window ends there
+  const std::size_t num_output =
+      decimate(samples, coeffs_->data(), padded_length, next_output_, num_input, ratio_, output);
+  next_output_ = next_output_ + num_output * ratio_ - num_input;
+
+  history_.erase(history_.begin(), history_.end() - static_cast<std::ptrdiff_t>(num_history));
+
+  return num_output;
+}
+
+// \return Index of the input sample (in the next block) that will produce the next output
+std::size_t FIRDecimator::getNextOutputIndex() const {
+  return next_output_;
+}
+
+// \return Number of output samples that execute() would produce for num_input samples
+std::size_t FIRDecimator::getOutputSize(std::size_t num_input) const {
+  return next_output_ < num_input ? (num_input - next_output_ - 1) / ratio_ + 1 : 0;
+}
+
+// \return Group delay in input samples (the filter is assumed to be linear-phase)
+float FIRDecimator::getGroupDelay() const {
+  return static_cast<float>(filter_length_ - 1) * 0.5f;
+}
+
+}  // namespace redsea
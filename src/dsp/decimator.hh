@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_DECIMATOR_H_
+#define DSP_DECIMATOR_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+
+namespace redsea {
+
+// \brief Decimating FIR filter for complex samples with real coefficients.
+//
+// Only the output samples that are kept get computed. Input can be fed in blocks of any size;
+// the filter history and the decimation phase are carried over between blocks.
+class FIRDecimator {
+ public:
+  FIRDecimator() = default;
+  void init(const std::vector<float>& coeffs, std::uint32_t ratio);
+
+  std::size_t execute(const std::complex<float>* input, std::size_t num_input,
+                      std::complex<float>* output);
+  [[nodiscard]] std::size_t getNextOutputIndex() const;
+  [[nodiscard]] std::size_t getOutputSize(std::size_t num_input) const;
+  [[nodiscard]] float getGroupDelay() const;
+
+ private:
+  // Coefficients in reverse order, each one duplicated to line up with interleaved I/Q, and
+  // zero-padded in the front to a multiple of the dot product's unroll factor. Shared by all
+  // decimators with the same filter.
+  SharedCoeffs<float> coeffs_;
+  std::size_t filter_length_{};
+  std::uint32_t ratio_{1};
+  // The last (padded length - 1) input samples, followed by the current input block
+  std::vector<std::complex<float>> history_;
+  // Index of the next output sample, relative to the beginning of the next input block
+  std::size_t next_output_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_DECIMATOR_H_
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/fft_frontend.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/liquid_wrappers.hh"
+#include "src/util/util.hh"
+
+namespace redsea {
+
+namespace {
+
+// Size of the inverse FFT; the forward FFT is this times the decimation ratio
+constexpr std::size_t kInverseFFTSize = 128;
+
+// Bins where the band-pass response is weaker than this (relative to its peak) are left out;
+// well below the filter's own stopband
+constexpr float kResponseThreshold = 1e-5f;
+
+}  // namespace
+
+// \param lowpass_coeffs Prototype low-pass filter, as for FIRDecimator
+// \param ratio Decimation ratio
+// \param frequencies Center frequency of each band, in radians per sample
+void FFTFrontEnd::init(const std::vector<float>& lowpass_coeffs, std::uint32_t ratio,
+                       const std::vector<float>& frequencies) {
+  assert(frequencies.size() <= kMaxNumBands && !lowpass_coeffs.empty());
+
+  ratio_     = ratio;
+  overlap_   = divideRoundingUp(lowpass_coeffs.size() - 1, std::size_t{ratio}) * ratio;
+  num_bands_ = frequencies.size();
+
+  const std::size_t fft_size = kInverseFFTSize * ratio;
+  assert(overlap_ < fft_size);
+  max_block_outputs_ = (fft_size - overlap_) / ratio;
+
+  forward_.init(fft_size, false);
+  inverse_.init(kInverseFFTSize, true);
+
+  for (std::size_t i_band = 0; i_band < num_bands_; i_band++) {
+    Band& band     = bands_[i_band];
+    band.frequency = frequencies[i_band];
+
+    // The low-pass filter shifted up to the band
+    std::fill(forward_.input(), forward_.input() + fft_size, 0.f);
+    for (std::size_t i = 0; i < lowpass_coeffs.size(); i++) {
+      const double angle  = static_cast<double>(band.frequency) * static_cast<double>(i);
+      forward_.input()[i] = lowpass_coeffs[i] * std::complex<float>(std::polar(1.0, angle));
+    }
+    forward_.execute();
+
+    const std::complex<float>* response = forward_.output();
+    float peak{};
+    for (std::size_t i = 0; i < fft_size; i++) peak = std::max(peak, std::abs(response[i]));
+
+    // The band doesn't wrap around, since it's not at DC or at Nyquist
+    std::size_t first_bin = fft_size;
+    std::size_t last_bin  = 0;
+    for (std::size_t i = 0; i < fft_size; i++) {
+      if (std::abs(response[i]) >= kResponseThreshold * peak) {
+        first_bin = std::min(first_bin, i);
+        last_bin  = i;
+      }
+    }
+
+    band.first_bin = first_bin;
+    band.response.assign(response + first_bin, response + last_bin + 1);
+    for (auto& bin : band.response) bin /= static_cast<float>(fft_size);
+  }
+
+  pending_.assign(overlap_, 0.f);
+  reset();
+}
+
+// \brief Filter, decimate and mix down the first num_bands bands of a block of input.
+// \param outputs One buffer per band, each with room for num_input / ratio + 1 samples
+// \return Number of output samples written to each band
+// \note Like FIRDecimator, the output sample at index n corresponds to the input sample at
+//       index getNextOutputIndex() + n * ratio, as seen before the call.
+std::size_t FFTFrontEnd::execute(const float* input, std::size_t num_input, std::size_t num_bands,
+                                 std::complex<float>* const* outputs) {
+  assert(num_bands <= num_bands_);
+
+  pending_.insert(pending_.end(), input, input + num_input);
+
+  const std::size_t fft_size   = kInverseFFTSize * ratio_;
+  const std::size_t first_kept = overlap_ / ratio_;
+
+  std::size_t num_output{};
+  while (pending_.size() > overlap_) {
+    const std::size_t num_block_outputs =
+        std::min(max_block_outputs_, (pending_.size() - overlap_ - 1) / ratio_ + 1);
+
+    // Zeros past the end of the input only reach outputs that aren't used
+    const std::size_t num_block_input = std::min(fft_size, pending_.size());
+    std::copy_n(pending_.cbegin(), num_block_input, forward_.input());
+    std::fill(forward_.input() + num_block_input, forward_.input() + fft_size, 0.f);
+    forward_.execute();
+
+    for (std::size_t i_band = 0; i_band < num_bands; i_band++) {
+      const Band& band = bands_[i_band];
+
+      // Decimation in time is aliasing in frequency: fold the band's bins onto the small FFT
+      std::complex<float>* folded = inverse_.input();
+      std::fill(folded, folded + kInverseFFTSize, 0.f);
+      const std::complex<float>* spectrum = forward_.output() + band.first_bin;
+      std::size_t i_folded                = band.first_bin % kInverseFFTSize;
+      for (std::size_t i = 0; i < band.response.size(); i++) {
+        folded[i_folded] += spectrum[i] * band.response[i];
+        if (++i_folded == kInverseFFTSize)
+          i_folded = 0;
+      }
+      inverse_.execute();
+
+      // Mix down to baseband; the phasor only needs to step once per output
+      std::complex<float> phasor = std::polar(1.f, static_cast<float>(-band.phase));
+      const std::complex<float> step =
+          std::polar(1.f, -band.frequency * static_cast<float>(ratio_));
+      std::complex<float>* output = outputs[i_band] + num_output;
+      for (std::size_t i = 0; i < num_block_outputs; i++) {
+        output[i] = inverse_.output()[first_kept + i] * phasor;
+        phasor *= step;
+      }
+    }
+
+    // Bands that weren't asked for keep their phase too
+    for (std::size_t i_band = 0; i_band < num_bands_; i_band++) {
+      Band& band = bands_[i_band];
+      band.phase = std::remainder(
+          band.phase + static_cast<double>(band.frequency) *
+                           static_cast<double>(ratio_ * num_block_outputs),
+          k2PiDouble);
+    }
+
+    num_output += num_block_outputs;
+    pending_.erase(pending_.begin(),
+                   pending_.begin() + static_cast<std::ptrdiff_t>(num_block_outputs * ratio_));
+  }
+
+  return num_output;
+}
+
+// \brief Restart the mixers from zero phase at the beginning of the next input block, like
+//        Oscillator::reset().
+void FFTFrontEnd::reset() {
+  for (std::size_t i_band = 0; i_band < num_bands_; i_band++) {
+    bands_[i_band].phase = std::remainder(
+        static_cast<double>(bands_[i_band].frequency) * static_cast<double>(getNextOutputIndex()),
+        k2PiDouble);
+  }
+}
+
+// \return Index of the input sample (in the next block) that will produce the next output
+std::size_t FFTFrontEnd::getNextOutputIndex() const {
+  return overlap_ - pending_.size();
+}
+
+}  // namespace redsea
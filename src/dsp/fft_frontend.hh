@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_FFT_FRONTEND_H_
+#define DSP_FFT_FRONTEND_H_
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/liquid_wrappers.hh"
+
+namespace redsea {
+
+// \brief Extracts several subcarriers from the same real signal with one FFT per block.
+//
+// Fast convolution (overlap-save): each block of input is transformed once, and every band is
+// filtered by multiplying the spectrum with its own band-pass response, the low-pass filter
+// shifted up to the subcarrier. Decimation happens in the frequency domain too, by folding the
+// few bins of the band into a small inverse FFT. The band is mixed down to baseband only at the
+// decimated rate. The output equals Oscillator followed by FIRDecimator with the same filter,
+// including the decimation phase and the output index convention; only for one filter length
+// after reset() it differs, since the samples already in the filter aren't mixed again.
+class FFTFrontEnd {
+ public:
+  static constexpr std::size_t kMaxNumBands = 4;
+
+  FFTFrontEnd() = default;
+  void init(const std::vector<float>& lowpass_coeffs, std::uint32_t ratio,
+            const std::vector<float>& frequencies);
+
+  std::size_t execute(const float* input, std::size_t num_input, std::size_t num_bands,
+                      std::complex<float>* const* outputs);
+  void reset();
+  [[nodiscard]] std::size_t getNextOutputIndex() const;
+
+ private:
+  struct Band {
+    // Radians per input sample
+    float frequency{};
+    // Phase of the mixer at the next output sample, in radians
+    double phase{};
+    // The significant part of the band-pass response, from bin first_bin on; pre-scaled by
+    // 1/fft_size
+    std::vector<std::complex<float>> response;
+    std::size_t first_bin{};
+  };
+
+  std::uint32_t ratio_{1};
+  // Input samples before the first output of a block; covers the filter's history
+  std::size_t overlap_{};
+  std::size_t max_block_outputs_{};
+  liquid::FFT forward_;
+  // One output sample per `ratio_` input samples
+  liquid::FFT inverse_;
+  std::array<Band, kMaxNumBands> bands_;
+  std::size_t num_bands_{};
+  // Input not consumed yet; the next output is at index overlap_
+  std::vector<float> pending_;
+};
+
+}  // namespace redsea
+
+#endif  // DSP_FFT_FRONTEND_H_
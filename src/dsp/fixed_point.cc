@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/fixed_point.hh"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "src/dsp/liquid_wrappers.hh"
+#include "src/dsp/simd.hh"
+#include "src/util/util.hh"
+
+namespace redsea {
+
+namespace {
+
+constexpr int kQ15Shift        = 15;
+constexpr float kQ15Scale      = 32768.f;
+constexpr std::int32_t kQ15Max = 32767;
+
+// The sine table is indexed by the top bits of the phase accumulator. 4096 entries keep the
+// phase truncation spurs below -66 dBc.
+constexpr int kSineTableBits         = 12;
+constexpr std::size_t kSineTableSize = std::size_t{1} << kSineTableBits;
+
+// Complex samples per iteration of the dot product. The independent accumulators let the
+// compiler vectorize the loop.
+constexpr std::size_t kDotProductUnroll = 8;
+
+const std::array<std::int16_t, kSineTableSize>& getSineTable() {
+  static const auto table = [] {
+    std::array<std::int16_t, kSineTableSize> t{};
+    for (std::size_t i = 0; i < t.size(); i++) {
+      t[i] = static_cast<std::int16_t>(std::lround(
+          kQ15Max * std::sin(k2PiDouble * static_cast<double>(i) / kSineTableSize)));
+    }
+    return t;
+  }();
+  return table;
+}
+
+// Q15 * Q15 -> Q15, rounded
+std::int16_t multiplyQ15(std::int16_t a, std::int16_t b) {
+  const std::int32_t product = static_cast<std::int32_t>(a) * b;
+  return static_cast<std::int16_t>((product + (1 << (kQ15Shift - 1))) >> kQ15Shift);
+}
+
+// \param samples Interleaved I/Q, 2 * length values
+// \param coeffs Duplicated coefficients, 2 * length values
+// \param length Must be a multiple of kDotProductUnroll
+// \return Q30 result
+REDSEA_SIMD_INLINE
+std::array<std::int32_t, 2> dotProduct(const std::int16_t* samples, const std::int16_t* coeffs,
+                                       std::size_t length) {
+  std::array<std::int32_t, 2 * kDotProductUnroll> acc{};
+
+  for (std::size_t i = 0; i < 2 * length; i += acc.size()) {
+    for (std::size_t j = 0; j < acc.size(); j++) {
+      acc[j] += static_cast<std::int32_t>(coeffs[i + j]) * samples[i + j];
+    }
+  }
+
+  std::array<std::int32_t, 2> result{};
+  for (std::size_t j = 0; j < acc.size(); j += 2) {
+    result[0] += acc[j];
+    result[1] += acc[j + 1];
+  }
+  return result;
+}
+
+// \brief One output for every ratio inputs, starting from input first_input.
+// \param samples Interleaved I/Q; the window for input i ends at sample i
+// \return Number of output samples written
+REDSEA_SIMD_CLONES
+std::size_t decimate(const std::int16_t* samples, const std::int16_t* coeffs,
+                     std::size_t padded_length, std::size_t first_input, std::size_t num_input,
+                     std::uint32_t ratio, std::complex<float>* output) {
+  // Q30 to float
+  constexpr float kOutputScale = 1.f / (kQ15Scale * kQ15Scale);
+
+  std::size_t num_output{};
+  for (std::size_t i_input = first_input; i_input < num_input; i_input += ratio) {
+    const auto sum     = dotProduct(&samples[2 * i_input], coeffs, padded_length);
+    output[num_output] = {static_cast<float>(sum[0]) * kOutputScale,
+                          static_cast<float>(sum[1]) * kOutputScale};
+    num_output++;
+  }
+  return num_output;
+}
+
+}  // namespace
+
+// \param frequency Radians per sample
+void OscillatorQ15::init(float frequency) {
+  const double cycles_per_sample = static_cast<double>(frequency) / k2PiDouble;
+  phase_increment_ = static_cast<std::uint32_t>(
+      std::llround((cycles_per_sample - std::floor(cycles_per_sample)) * 4294967296.0));
+  phase_ = 0;
+}
+
+void OscillatorQ15::reset() {
+  phase_ = 0;
+}
+
+// \brief Multiply a real signal by exp(-j * phase) to move the oscillator frequency to 0 Hz.
+// \param output Interleaved I/Q, room for 2 * num_samples values
+void OscillatorQ15::mixDown(const std::int16_t* input, std::size_t num_samples,
+                            std::int16_t* output) {
+  const auto& sine = getSineTable();
+
+  constexpr int kIndexShift            = 32 - kSineTableBits;
+  constexpr std::uint32_t kIndexMask   = kSineTableSize - 1;
+  constexpr std::uint32_t kQuarterTurn = kSineTableSize / 4;
+
+  for (std::size_t i = 0; i < num_samples; i++) {
+    const std::uint32_t index     = phase_ >> kIndexShift;
+    const std::int16_t sine_value = sine[index];
+    const std::int16_t cos_value  = sine[(index + kQuarterTurn) & kIndexMask];
+
+    output[2 * i]     = multiplyQ15(input[i], cos_value);
+    output[2 * i + 1] = multiplyQ15(input[i], static_cast<std::int16_t>(-sine_value));
+
+    // Wraps around at 2 pi
+    phase_ += phase_increment_;
+  }
+}
+
+// \param coeffs Filter coefficients (impulse response) in natural order. The sum of their
+//        absolute values must be below 2, so that the accumulators can't overflow.
+// \param ratio Decimation ratio; one output is computed for every `ratio` inputs
+void FIRDecimatorQ15::init(const std::vector<float>& coeffs, std::uint32_t ratio) {
+  assert(!coeffs.empty() && ratio >= 1);
+
+  filter_length_ = coeffs.size();
+  ratio_         = ratio;
+  next_output_   = 0;
+
+  const std::size_t padded_length = divideRoundingUp(filter_length_, kDotProductUnroll) *
+                                    kDotProductUnroll;
+
+  std::vector<std::int16_t> prepared(2 * padded_length, 0);
+  std::int64_t sum_of_magnitudes{};
+  for (std::size_t i = 0; i < filter_length_; i++) {
+    const auto coeff = static_cast<std::int16_t>(
+        std::clamp<long>(std::lround(coeffs[i] * kQ15Scale), -kQ15Max, kQ15Max));
+    sum_of_magnitudes += std::abs(coeff);
+
+    const std::size_t i_reversed = padded_length - 1 - i;
+    prepared[2 * i_reversed]     = coeff;
+    prepared[2 * i_reversed + 1] = coeff;
+  }
+  coeffs_ = shareCoeffs(std::move(prepared));
+  // Worst case: every input sample at full scale with the sign of its coefficient
+  assert(sum_of_magnitudes * (kQ15Max + 1) <= std::numeric_limits<std::int32_t>::max());
+  static_cast<void>(sum_of_magnitudes);
+
+  history_.assign(2 * (padded_length - 1), 0);
+}
+
+// \brief Filter and decimate a block of samples.
+// \param input Interleaved I/Q, 2 * num_input values
+// \param output Must have room for getOutputSize(num_input) samples
+// \return Number of output samples written
+// \note The output sample at index n corresponds to the input sample at index
+//       getNextOutputIndex() + n * ratio, as seen before the call.
+std::size_t FIRDecimatorQ15::execute(const std::int16_t* input, std::size_t num_input,
+                                     std::complex<float>* output) {
+  const std::size_t padded_length = coeffs_->size() / 2;
+  const std::size_t num_history   = padded_length - 1;
+  assert(history_.size() == 2 * num_history);
+
+  history_.insert(history_.end(), input, input + 2 * num_input);
+
+  // Input sample i is at history_[2 * (num_history + i)]; the window ends there
+  const std::size_t num_output = decimate(history_.data(), coeffs_->data(), padded_length,
+                                          next_output_, num_input, ratio_, output);
+  next_output_ = next_output_ + num_output * ratio_ - num_input;
+
+  history_.erase(history_.begin(),
+                 history_.end() - static_cast<std::ptrdiff_t>(2 * num_history));
+
+  return num_output;
+}
+
+// \return Index of the input sample (in the next block) that will produce the next output
+std::size_t FIRDecimatorQ15::getNextOutputIndex() const {
+  return next_output_;
+}
+
+// \return Number of output samples that execute() would produce for num_input samples
+std::size_t FIRDecimatorQ15::getOutputSize(std::size_t num_input) const {
+  return next_output_ < num_input ? (num_input - next_output_ - 1) / ratio_ + 1 : 0;
+}
+
+// \return Group delay in input samples (the filter is assumed to be linear-phase)
+float FIRDecimatorQ15::getGroupDelay() const {
+  return static_cast<float>(filter_length_ - 1) * 0.5f;
+}
+
+}  // namespace redsea
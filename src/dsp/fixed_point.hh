@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_FIXED_POINT_H_
+#define DSP_FIXED_POINT_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+
+// Integer versions of the subcarrier front end (mixer and decimating low-pass filter). They
+// give bit-exact results on any platform and are cheaper than floats on small CPUs.
+//
+// Samples are Q15: signed 16-bit, with 15 fractional bits, i.e. [-1, 1). Complex samples are
+// interleaved I/Q.
+
+namespace redsea {
+
+// \brief Mixes a real Q15 signal down to complex baseband using a phase accumulator and a
+//        sine table.
+class OscillatorQ15 {
+ public:
+  OscillatorQ15() = default;
+  void init(float frequency);
+  void mixDown(const std::int16_t* input, std::size_t num_samples, std::int16_t* output);
+  void reset();
+
+ private:
+  // Full circle is 2^32
+  std::uint32_t phase_{};
+  std::uint32_t phase_increment_{};
+};
+
+// \brief Decimating FIR filter for complex Q15 samples, with Q15 coefficients and 32-bit
+//        accumulators.
+//
+// Only the output samples that are kept get computed. The output is converted to floating point.
+class FIRDecimatorQ15 {
+ public:
+  FIRDecimatorQ15() = default;
+  void init(const std::vector<float>& coeffs, std::uint32_t ratio);
+
+  std::size_t execute(const std::int16_t* input, std::size_t num_input,
+                      std::complex<float>* output);
+  [[nodiscard]] std::size_t getNextOutputIndex() const;
+  [[nodiscard]] std::size_t getOutputSize(std::size_t num_input) const;
+  [[nodiscard]] float getGroupDelay() const;
+
+ private:
+  // Coefficients in reverse order, each one duplicated to line up with interleaved I/Q, and
+  // zero-padded in the front to a multiple of the dot product's unroll factor. Shared by all
+  // decimators with the same filter.
+  SharedCoeffs<std::int16_t> coeffs_;
+  std::size_t filter_length_{};
+  std::uint32_t ratio_{1};
+  // The last (padded length - 1) input samples, followed by the current input block; I/Q
+  // interleaved
+  std::vector<std::int16_t> history_;
+  // Index of the next output sample, relative to the beginning of the next input block
+  std::size_t next_output_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_FIXED_POINT_H_
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/fm_channelizer.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "src/constants.hh"
+#include "src/dsp/liquid_wrappers.hh"
+
+namespace redsea {
+
+namespace {
+
+constexpr float kChannelSpacing_Hz = 200'000.f;
+// A station's signal is about 200 kHz wide; the filters start to cut at 120 kHz from the center
+constexpr float kChannelCutoff_Hz = 120'000.f;
+// Prototype filter semi-length, in channel output samples
+constexpr std::uint32_t kFilterDelay = 8;
+constexpr float kStopbandAttenuation_dB = 60.f;
+
+}  // namespace
+
+// \param iq_samplerate Complex sample rate of the input, in Hz
+// \throws std::runtime_error if the band can't be split into an even number of channels, or
+//         into more than kMaxNumChannels
+void FMChannelizer::init(float iq_samplerate) {
+  const float num_channels = iq_samplerate / kChannelSpacing_Hz;
+  if (num_channels < 2.f || std::fmod(num_channels, 2.f) != 0.f) {
+    throw std::runtime_error("IQ sample rate must be a multiple of " +
+                             std::to_string(static_cast<int>(2 * kChannelSpacing_Hz)) +
+                             " Hz to be channelized");
+  }
+  // Each channel gets a decoder of its own
+  if (num_channels > static_cast<float>(kMaxNumChannels)) {
+    throw std::runtime_error(
+        "IQ sample rate must be no higher than " +
+        std::to_string(static_cast<int>(kMaxNumChannels * kChannelSpacing_Hz)) +
+        " Hz to be channelized (at most " + std::to_string(kMaxNumChannels) + " channels)");
+  }
+  num_channels_ = static_cast<std::uint32_t>(num_channels);
+
+  auto prototype = liquid::designKaiserLowpass(2 * num_channels_ * kFilterDelay + 1,
+                                               kChannelCutoff_Hz / iq_samplerate,
+                                               kStopbandAttenuation_dB);
+  // The filter bank divides by the number of channels; this gives unity gain in the passband
+  const float sum = std::accumulate(prototype.cbegin(), prototype.cend(), 0.f);
+  for (auto& coeff : prototype) coeff *= static_cast<float>(num_channels_) / sum;
+  filter_bank_.init(num_channels_, kFilterDelay, prototype);
+
+  discriminators_ = std::vector<FMDiscriminator>(num_channels_);
+  for (auto& discriminator : discriminators_) discriminator.init(getOutputSamplerate());
+
+  block_.assign(getBlockSize(), 0.f);
+  block_fill_ = 0;
+  bank_output_.resize(num_channels_);
+  channel_i_.resize(num_channels_);
+  channel_q_.resize(num_channels_);
+}
+
+// Filter one block of input and append each channel's new sample to its own array
+void FMChannelizer::executeBlock() {
+  filter_bank_.execute(block_.data(), bank_output_.data());
+
+  // FFT bins above the middle are the negative frequencies
+  const std::uint32_t half = num_channels_ / 2;
+  for (std::uint32_t channel = 0; channel < num_channels_; channel++) {
+    const std::complex<float> sample = bank_output_[(channel + half) % num_channels_];
+    channel_i_[channel][num_channel_samples_] = sample.real();
+    channel_q_[channel][num_channel_samples_] = sample.imag();
+  }
+  num_channel_samples_++;
+}
+
+// \param num_input Number of complex samples; a partial block is kept for the next call
+// \param outputs One MPX buffer per channel, with room for num_input / getBlockSize() + 1 samples
+// \return Number of MPX samples written to each output
+std::size_t FMChannelizer::execute(const std::complex<float>* input, std::size_t num_input,
+                                   float* const* outputs) {
+  const std::size_t max_channel_samples = num_input / block_.size() + 1;
+  for (std::uint32_t channel = 0; channel < num_channels_; channel++) {
+    channel_i_[channel].resize(max_channel_samples);
+    channel_q_[channel].resize(max_channel_samples);
+  }
+  num_channel_samples_ = 0;
+
+  std::size_t position{};
+  while (position < num_input) {
+    const std::size_t to_copy = std::min(block_.size() - block_fill_, num_input - position);
+    std::copy_n(input + position, to_copy,
+                block_.begin() + static_cast<std::ptrdiff_t>(block_fill_));
+    position += to_copy;
+    block_fill_ += to_copy;
+
+    if (block_fill_ == block_.size()) {
+      executeBlock();
+      block_fill_ = 0;
+    }
+  }
+
+  std::size_t num_output{};
+  for (std::uint32_t channel = 0; channel < num_channels_; channel++) {
+    num_output = discriminators_[channel].execute(channel_i_[channel].data(),
+                                                  channel_q_[channel].data(),
+                                                  num_channel_samples_, outputs[channel]);
+  }
+  return num_output;
+}
+
+std::uint32_t FMChannelizer::getNumChannels() const {
+  return num_channels_;
+}
+
+// \return Number of input samples per filter bank step; half the number of channels
+std::size_t FMChannelizer::getBlockSize() const {
+  return num_channels_ / 2;
+}
+
+// \return MPX sample rate of every channel, in Hz
+float FMChannelizer::getOutputSamplerate() const {
+  return 2.f * kChannelSpacing_Hz;
+}
+
+// \return Center frequency of the channel relative to the center of the IQ band, in Hz
+float FMChannelizer::getChannelOffset(std::uint32_t channel) const {
+  return (static_cast<float>(channel) - static_cast<float>(num_channels_ / 2)) *
+         kChannelSpacing_Hz;
+}
+
+}  // namespace redsea
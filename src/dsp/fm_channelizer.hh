@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_FM_CHANNELIZER_H_
+#define DSP_FM_CHANNELIZER_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/fm_discriminator.hh"
+#include "src/dsp/liquid_wrappers.hh"
+
+namespace redsea {
+
+// \brief Splits wideband complex baseband into 200 kHz FM channels and demodulates them all.
+//
+// A polyphase filter bank does the splitting with one FFT per block of getBlockSize() input
+// samples. Every channel comes out at twice the channel spacing, so a station's whole signal
+// fits with room for the filter skirts, and goes to an FMDiscriminator of its own. Channels are
+// numbered from the lowest frequency up; the one in the middle is at the center of the band.
+class FMChannelizer {
+ public:
+  FMChannelizer() = default;
+  void init(float iq_samplerate);
+
+  std::size_t execute(const std::complex<float>* input, std::size_t num_input,
+                      float* const* outputs);
+  [[nodiscard]] std::uint32_t getNumChannels() const;
+  [[nodiscard]] std::size_t getBlockSize() const;
+  [[nodiscard]] float getOutputSamplerate() const;
+  [[nodiscard]] float getChannelOffset(std::uint32_t channel) const;
+
+ private:
+  void executeBlock();
+
+  liquid::Channelizer filter_bank_;
+  std::uint32_t num_channels_{};
+  std::vector<FMDiscriminator> discriminators_;
+  // Input samples waiting for a full block
+  std::vector<std::complex<float>> block_;
+  std::size_t block_fill_{};
+  // Filter bank output, one sample per channel, in FFT order
+  std::vector<std::complex<float>> bank_output_;
+  // Each channel's samples from this call, for the discriminators
+  std::vector<std::vector<float>> channel_i_;
+  std::vector<std::vector<float>> channel_q_;
+  std::size_t num_channel_samples_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_FM_CHANNELIZER_H_
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/fm_discriminator.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "src/dsp/halfband.hh"
+
+namespace redsea {
+
+namespace {
+
+// Nominal peak deviation of FM broadcast
+constexpr float kMaxDeviation_Hz = 75'000.f;
+// The station's signal (75 kHz deviation, MPX up to 60 kHz) kept by the half-band stages
+constexpr float kChannelPassband_Hz = 100'000.f;
+// Stop halving before the output rate drops below this; the MPX needs at least 171 kHz and
+// the wider the better for the discriminator
+constexpr float kMinDecimatedRate_Hz = 250'000.f;
+
+// Phase difference of each sample from the previous one, i.e. the argument of x[n] * conj(x[n-1])
+void discriminate(const float* in_i, const float* in_q, std::size_t num_samples, float gain,
+                  float* output) {
+  for (std::size_t n = 1; n < num_samples; n++) {
+    const float re = in_i[n] * in_i[n - 1] + in_q[n] * in_q[n - 1];
+    const float im = in_q[n] * in_i[n - 1] - in_i[n] * in_q[n - 1];
+    output[n]      = gain * fastAtan2(im, re);
+  }
+}
+
+}  // namespace
+
+// \param iq_samplerate Complex sample rate of the input, in Hz
+void FMDiscriminator::init(float iq_samplerate) {
+  stages_i_.clear();
+  stages_q_.clear();
+
+  float rate = iq_samplerate;
+  while (rate / 2.f >= kMinDecimatedRate_Hz) {
+    stages_i_.emplace_back();
+    stages_q_.emplace_back();
+    stages_i_.back().init(kChannelPassband_Hz / rate);
+    stages_q_.back().init(kChannelPassband_Hz / rate);
+    rate /= 2.f;
+  }
+
+  output_samplerate_ = rate;
+  // Phase step per sample at full deviation
+  gain_ = output_samplerate_ / (k2Pi * kMaxDeviation_Hz);
+}
+
+// \param num_input Number of complex samples
+// \return Number of MPX samples written to output; at most num_input
+std::size_t FMDiscriminator::execute(const float* in_i, const float* in_q, std::size_t num_input,
+                                     float* output) {
+  const float* samples_i = in_i;
+  const float* samples_q = in_q;
+  std::size_t num_samples = num_input;
+
+  if (!stages_i_.empty()) {
+    decimated_i_.resize(num_input);
+    decimated_q_.resize(num_input);
+    for (std::size_t i_stage = 0; i_stage < stages_i_.size(); i_stage++) {
+      const std::size_t num_decimated =
+          stages_i_[i_stage].execute(samples_i, num_samples, decimated_i_.data());
+      stages_q_[i_stage].execute(samples_q, num_samples, decimated_q_.data());
+      samples_i   = decimated_i_.data();
+      samples_q   = decimated_q_.data();
+      num_samples = num_decimated;
+    }
+  }
+
+  if (num_samples == 0)
+    return 0;
+
+  output[0] = gain_ * fastAtan2(samples_q[0] * previous_i_ - samples_i[0] * previous_q_,
+                                samples_i[0] * previous_i_ + samples_q[0] * previous_q_);
+  discriminate(samples_i, samples_q, num_samples, gain_, output);
+
+  previous_i_ = samples_i[num_samples - 1];
+  previous_q_ = samples_q[num_samples - 1];
+
+  return num_samples;
+}
+
+float FMDiscriminator::getOutputSamplerate() const {
+  return output_samplerate_;
+}
+
+}  // namespace redsea
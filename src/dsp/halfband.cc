@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/halfband.hh"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+#include "src/dsp/simd.hh"
+#include "src/util/util.hh"
+
+namespace redsea {
+
+namespace {
+
+constexpr float kStopbandAttenuation_dB = 60.0f;
+
+// Coefficient pairs per iteration of the dot product. The independent accumulators let the
+// compiler vectorize the loop without reordering floating-point additions.
+constexpr std::size_t kDotProductUnroll = 4;
+
+// \param center Pointer to the input sample at the center tap
+// \param num_pairs Must be a multiple of kDotProductUnroll
+REDSEA_SIMD_INLINE
+float foldedDotProduct(const float* center, const float* coeffs, std::size_t num_pairs) {
+  std::array<float, kDotProductUnroll> acc{};
+
+  for (std::size_t i = 0; i < num_pairs; i += acc.size()) {
+    for (std::size_t j = 0; j < acc.size(); j++) {
+      const auto offset = static_cast<std::ptrdiff_t>(2 * (i + j) + 1);
+      acc[j] += coeffs[i + j] * (center[-offset] + center[offset]);
+    }
+  }
+
+  return std::accumulate(acc.cbegin(), acc.cend(), 0.0f);
+}
+
+// \brief One output for every other input, starting from input first_input.
+// \param samples The window for input i ends at sample i
+// \return Number of output samples written
+REDSEA_SIMD_CLONES
+std::size_t decimateByTwo(const float* samples, float center_coeff, const float* coeffs,
+                          std::size_t num_pairs, std::size_t first_input, std::size_t num_input,
+                          float* output) {
+  std::size_t num_output{};
+  for (std::size_t i_input = first_input; i_input < num_input; i_input += 2) {
+    const float* center = &samples[i_input + 2 * num_pairs - 1];
+    output[num_output]  = center_coeff * center[0] + foldedDotProduct(center, coeffs, num_pairs);
+    num_output++;
+  }
+  return num_output;
+}
+
+}  // namespace
+
+// \param passband_edge Highest frequency to keep, relative to the input sample rate (< 0.25).
+//        The filter is made just long enough to keep aliases out of the passband.
+void HalfbandDecimator::init(float passband_edge) {
+  assert(passband_edge > 0.f && passband_edge < 0.25f);
+
+  // Kaiser's estimate for the filter length; the transition band is centered at 0.25
+  const float transition_width = 0.5f - 2.f * passband_edge;
+  const float required_length  = (kStopbandAttenuation_dB - 7.95f) / (14.36f * transition_width) +
+                                1.f;
+
+  // Filter length is 4 * num_pairs - 1, with the center tap in the middle and the non-zero
+  // taps at odd distances from it
+  const std::size_t min_num_pairs =
+      divideRoundingUp(static_cast<std::size_t>(required_length) + 1, std::size_t{4});
+  const std::size_t num_pairs =
+      divideRoundingUp(min_num_pairs, kDotProductUnroll) * kDotProductUnroll;
+  const std::size_t length = 4 * num_pairs - 1;
+  const std::size_t center = 2 * num_pairs - 1;
+
+  const auto prototype =
+      getKaiserLowpass(static_cast<std::uint32_t>(length), 0.25f, kStopbandAttenuation_dB);
+
+  center_coeff_ = (*prototype)[center];
+  std::vector<float> coeffs(num_pairs);
+  for (std::size_t i = 0; i < num_pairs; i++) {
+    coeffs[i] = (*prototype)[center + 2 * i + 1];
+  }
+  coeffs_ = shareCoeffs(std::move(coeffs));
+
+  history_.assign(length - 1, 0.f);
+  next_output_ = 0;
+}
+
+// \brief Filter and decimate a block of samples.
+// \param output Must have room for getMaxOutputSize(num_input) samples. May be the same
+//        buffer as input.
+// \return Number of output samples written
+std::size_t HalfbandDecimator::execute(const float* input, std::size_t num_input, float* output) {
+  const std::size_t num_pairs   = coeffs_->size();
+  const std::size_t num_history = 4 * num_pairs - 2;
+  assert(history_.size() == num_history);
+
+  history_.insert(history_.end(), input, input + num_input);
+
+  // Input sample i is at history_[num_history + i]; the window ends there
+  const std::size_t num_output = decimateByTwo(history_.data(), center_coeff_, coeffs_->data(),
+                                               num_pairs, next_output_, num_input, output);
+  next_output_ = next_output_ + 2 * num_output - num_input;
+
+  history_.erase(history_.begin(), history_.end() - static_cast<std::ptrdiff_t>(num_history));
+
+  return num_output;
+}
+
+std::size_t HalfbandDecimator::getMaxOutputSize(std::size_t num_input) const {
+  return divideRoundingUp<std::size_t>(num_input, 2);
+}
+
+// \return Group delay in input samples
+float HalfbandDecimator::getGroupDelay() const {
+  return static_cast<float>(2 * coeffs_->size() - 1);
+}
+
+}  // namespace redsea
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_HALFBAND_H_
+#define DSP_HALFBAND_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+
+namespace redsea {
+
+// \brief Half-band low-pass filter that decimates by 2.
+//
+// Every other coefficient of a half-band filter is zero and the rest are symmetric, so an
+// output sample costs about a quarter of the multiplications of a general FIR of the same
+// length. Used in cascade to bring high input sample rates down before the fine resampler.
+class HalfbandDecimator {
+ public:
+  HalfbandDecimator() = default;
+  void init(float passband_edge);
+
+  std::size_t execute(const float* input, std::size_t num_input, float* output);
+  [[nodiscard]] std::size_t getMaxOutputSize(std::size_t num_input) const;
+  [[nodiscard]] float getGroupDelay() const;
+
+ private:
+  // Non-zero coefficients on one side of the center tap, nearest first (zero-padded). Shared by
+  // all decimators with the same filter.
+  SharedCoeffs<float> coeffs_;
+  float center_coeff_{};
+  // The last (filter length - 1) input samples, followed by the current input block
+  std::vector<float> history_;
+  // Index of the next output sample (0 or 1), relative to the beginning of the next input block
+  std::size_t next_output_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_HALFBAND_H_
@@ -18,10 +18,12 @@
 
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <complex>
 #include <cstddef>
 #include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -34,18 +36,6 @@ extern "C" {
 
 namespace liquid {
 
-namespace {
-
-float unwrap(float phase) {
-  if (phase > kPi)
-    return phase - k2Pi;
-  if (phase < -kPi)
-    return phase + k2Pi;
-  return phase;
-}
-
-}  // namespace
-
 void AGC::init(float bw, float initial_gain) {
   if (object_ != nullptr)
     agc_crcf_destroy(object_);
@@ -59,92 +49,22 @@ AGC::~AGC() {
     agc_crcf_destroy(object_);
 }
 
-std::complex<float> AGC::execute(std::complex<float> s) {
-  std::complex<float> result;
-  agc_crcf_execute(object_, s, &result);
-  return result;
-}
-
-void FIRFilter::init(std::uint32_t len, float fc, float As, float mu) {
-  if (object_ != nullptr)
-    firfilt_crcf_destroy(object_);
-  object_ = firfilt_crcf_create_kaiser(len, fc, As, mu);
-  firfilt_crcf_set_scale(object_, 2.0f * fc);
-}
-
-FIRFilter::~FIRFilter() {
-  if (object_ != nullptr)
-    firfilt_crcf_destroy(object_);
-}
-
-void FIRFilter::push(std::complex<float> s) {
-  firfilt_crcf_push(object_, s);
-}
-
-std::complex<float> FIRFilter::execute() {
-  std::complex<float> result;
-  firfilt_crcf_execute(object_, &result);
-  return result;
-}
-
-std::size_t FIRFilter::length() const {
-  return firfilt_crcf_get_length(object_);
+// \brief Run a block of samples through the AGC. Can be done in place.
+void AGC::execute(const std::complex<float>* input, std::size_t num_samples,
+                  std::complex<float>* output) {
+  // liquid-dsp doesn't modify the input, it just isn't declared const
+  agc_crcf_execute_block(object_, const_cast<std::complex<float>*>(input),
+                         static_cast<unsigned>(num_samples), output);
 }
 
-float FIRFilter::getGroupDelay() {
-  return firfilt_crcf_groupdelay(object_, 0.f);
-}
-
-NCO::NCO(liquid_ncotype type, float freq)
-    : object_(nco_crcf_create(type)), initial_frequency_(freq) {
-  nco_crcf_set_frequency(object_, freq);
-}
-
-NCO::~NCO() {
-  if (object_ != nullptr)
-    nco_crcf_destroy(object_);
-}
-
-void NCO::init(liquid_ncotype type, float freq) {
-  if (object_ != nullptr)
-    nco_crcf_destroy(object_);
-  object_            = nco_crcf_create(type);
-  initial_frequency_ = freq;
-  nco_crcf_set_frequency(object_, freq);
-}
-
-void NCO::reset() {
-  nco_crcf_reset(object_);
-  nco_crcf_set_frequency(object_, initial_frequency_);
-}
-
-std::complex<float> NCO::mixDown(std::complex<float> s, int n_stream) {
-  assert(n_stream >= 0 && n_stream < 4);
-  return s * std::polar(1.f, -phases_[n_stream]);
-}
-
-void NCO::step() {
-  nco_crcf_step(object_);
-
-  // Calculate (unwrapped) phase difference
-  const float phase_now = nco_crcf_get_phase(object_);
-  const float delta     = unwrap(phase_now - prev_f0_phase_);
-
-  prev_f0_phase_ = phase_now;
-
-  constexpr std::array<float, 4> subcarrier_frequencies{57000.f, 66500.f, 71250.f, 76000.f};
-
-  for (size_t i = 0; i < 4; i++) {
-    phases_[i] = unwrap(phases_[i] + delta * subcarrier_frequencies[i] / 57000.f);
-  }
-}
-
-void NCO::setPLLBandwidth(float bw) {
-  nco_crcf_pll_set_bandwidth(object_, bw);
-}
-
-void NCO::stepPLL(float dphi) {
-  nco_crcf_pll_step(object_, dphi);
+// \brief Kaiser-windowed sinc low-pass filter
+// \param fc Cutoff frequency, relative to the sample rate
+// \return Filter coefficients, scaled by 2*fc for roughly unity gain at DC
+std::vector<float> designKaiserLowpass(std::uint32_t len, float fc, float As, float mu) {
+  std::vector<float> coeffs(len);
+  liquid_firdes_kaiser(len, fc, As, mu, coeffs.data());
+  for (auto& coeff : coeffs) coeff *= 2.0f * fc;
+  return coeffs;
 }
 
 void SymSync::init(liquid_firfilt_type ftype, std::uint32_t k, std::uint32_t m, float beta,
@@ -152,7 +72,6 @@ void SymSync::init(liquid_firfilt_type ftype, std::uint32_t k, std::uint32_t m,
   if (object_ != nullptr)
     symsync_crcf_destroy(object_);
   object_ = symsync_crcf_create_rnyquist(ftype, k, m, beta, num_filters);
-  out_.resize(8);
 }
 
 SymSync::~SymSync() {
@@ -172,12 +91,32 @@ void SymSync::setOutputRate(std::uint32_t r) {
   symsync_crcf_set_output_rate(object_, r);
 }
 
-redsea::Maybe<std::complex<float>> SymSync::execute(std::complex<float>& in) {
-  // To be set by liquid-dsp, no need to initialize
-  // NOLINTNEXTLINE(cppcoreguidelines-init-variables)
-  unsigned n_out;
-  symsync_crcf_execute(object_, &in, 1, out_.data(), &n_out);
-  return redsea::Maybe<std::complex<float>>{out_[0], n_out == 1};
+// \brief Recover symbols from a block of samples.
+// \param symbols Gets the symbols appended to it
+// \param positions Gets the index of the input sample that completed each symbol
+void SymSync::execute(const std::complex<float>* input, std::size_t num_samples,
+                      std::vector<std::complex<float>>& symbols,
+                      std::vector<std::size_t>& positions) {
+  // At most 2 symbols per sample, even at the fastest timing adjustment
+  constexpr std::size_t kMaxSymbolsPerSample = 2;
+  std::array<std::complex<float>, kMaxSymbolsPerSample> out{};
+
+  // liquid-dsp can take the whole block at once, but then it doesn't tell which sample each
+  // symbol came from; the PLL and the timestamps need that. Feeding it one sample at a time
+  // is the same thing that symsync_crcf_execute() does internally.
+  for (std::size_t i = 0; i < num_samples; i++) {
+    // To be set by liquid-dsp, no need to initialize
+    // NOLINTNEXTLINE(cppcoreguidelines-init-variables)
+    unsigned num_out;
+    // liquid-dsp doesn't modify the input, it just isn't declared const
+    symsync_crcf_execute(object_, const_cast<std::complex<float>*>(&input[i]), 1, out.data(),
+                         &num_out);
+    assert(num_out <= out.size());
+    for (unsigned i_out = 0; i_out < num_out; i_out++) {
+      symbols.push_back(out[i_out]);
+      positions.push_back(i);
+    }
+  }
 }
 
 Modem::Modem(modulation_scheme scheme)
@@ -220,6 +159,52 @@ float Modem::getPhaseError() {
 #endif
 }
 
+void FFT::init(std::size_t size, bool is_inverse) {
+  if (plan_ != nullptr)
+    fft_destroy_plan(plan_);
+  input_.assign(size, 0.f);
+  output_.assign(size, 0.f);
+  plan_ = fft_create_plan(static_cast<unsigned>(size), input_.data(), output_.data(),
+                          is_inverse ? LIQUID_FFT_BACKWARD : LIQUID_FFT_FORWARD, 0);
+}
+
+FFT::~FFT() {
+  if (plan_ != nullptr)
+    fft_destroy_plan(plan_);
+}
+
+void FFT::execute() {
+  fft_execute(plan_);
+}
+
+// \param filter_delay Semi-length of the prototype filter in samples of the output
+// \param prototype 2 * num_channels * filter_delay + 1 low-pass coefficients
+// \throws std::runtime_error if num_channels is odd
+void Channelizer::init(std::uint32_t num_channels, std::uint32_t filter_delay,
+                       std::vector<float> prototype) {
+  assert(prototype.size() == 2 * num_channels * filter_delay + 1);
+  if (num_channels % 2 != 0) {
+    throw std::runtime_error("error: Channelizer needs an even number of channels");
+  }
+  if (object_ != nullptr)
+    firpfbch2_crcf_destroy(object_);
+  object_ = firpfbch2_crcf_create(LIQUID_ANALYZER, num_channels, filter_delay, prototype.data());
+  if (object_ == nullptr) {
+    throw std::runtime_error("error: Can't initialize channelizer");
+  }
+}
+
+Channelizer::~Channelizer() {
+  if (object_ != nullptr)
+    firpfbch2_crcf_destroy(object_);
+}
+
+// \param in num_channels / 2 new input samples
+// \param out One output sample for each channel
+void Channelizer::execute(std::complex<float>* in, std::complex<float>* out) {
+  firpfbch2_crcf_execute(object_, in, out);
+}
+
 Resampler::Resampler(std::uint32_t half_length)
     : object_(resamp_rrrf_create(1.f, half_length, 0.47f, 60.0f, 32)) {
   if (object_ == nullptr) {
@@ -228,11 +213,12 @@ Resampler::Resampler(std::uint32_t half_length)
 }
 
 void Resampler::setRatio(float ratio) {
-  // Liquid can't take < 0.004, and we only reserved kOutputArraySize in the output buffer.
-  if (ratio < 0.005f || ratio > static_cast<float>(kOutputArraySize)) {
+  // Liquid can't take < 0.004
+  if (ratio < 0.005f || ratio > kMaxRatio) {
     throw std::runtime_error("error: Can't support this sample rate");
   }
   resamp_rrrf_set_rate(object_, ratio);
+  ratio_ = ratio;
 }
 
 Resampler::~Resampler() {
@@ -240,14 +226,23 @@ Resampler::~Resampler() {
     resamp_rrrf_destroy(object_);
 }
 
-std::uint32_t Resampler::execute(float in, std::array<float, kOutputArraySize>& out) {
+// \param output Room for getMaxOutputSize(num_input) samples
+// \return Number of samples written to output
+std::size_t Resampler::execute(const float* input, std::size_t num_input, float* output) {
   // To be set by liquid-dsp, no need to initialize
   // NOLINTNEXTLINE(cppcoreguidelines-init-variables)
   unsigned num_written;
-  resamp_rrrf_execute(object_, in, out.data(), &num_written);
-  assert(num_written <= kOutputArraySize);
+  // liquid-dsp doesn't modify the input, it just isn't declared const
+  resamp_rrrf_execute_block(object_, const_cast<float*>(input), static_cast<unsigned>(num_input),
+                            output, &num_written);
+  assert(num_written <= getMaxOutputSize(num_input));
+
+  return num_written;
+}
 
-  return static_cast<std::uint32_t>(num_written);
+// The resampler's phase may carry over one extra sample from the previous block
+std::size_t Resampler::getMaxOutputSize(std::size_t num_input) const {
+  return static_cast<std::size_t>(std::ceil(static_cast<float>(num_input) * ratio_)) + 1;
 }
 
 }  // namespace liquid
@@ -25,6 +25,7 @@
 
 constexpr float kPi{3.14159265358979323846f};
 constexpr float k2Pi{2.f * kPi};
+constexpr double k2PiDouble{6.283185307179586476925};
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -35,8 +36,6 @@ extern "C" {
 }
 #pragma clang diagnostic pop
 
-#include "src/util/maybe.hh"
-
 namespace redsea {
 
 // Hertz to radians per sample
@@ -58,58 +57,15 @@ class AGC {
   AGC& operator=(AGC&& other) = delete;
 
   ~AGC();
-  std::complex<float> execute(std::complex<float> s);
+  void execute(const std::complex<float>* input, std::size_t num_samples,
+               std::complex<float>* output);
 
  private:
   agc_crcf object_{nullptr};
 };
 
-class FIRFilter {
- public:
-  FIRFilter()                             = default;
-  FIRFilter(const FIRFilter&)             = delete;
-  FIRFilter& operator=(const FIRFilter&)  = delete;
-  FIRFilter(FIRFilter&& other)            = delete;
-  FIRFilter& operator=(FIRFilter&& other) = delete;
-
-  ~FIRFilter();
-  void init(std::uint32_t len, float fc, float As = 60.0f, float mu = 0.0f);
-
-  void push(std::complex<float> s);
-  std::complex<float> execute();
-  std::size_t length() const;
-  float getGroupDelay();
-
- private:
-  firfilt_crcf object_{nullptr};
-};
-
-// A quad NCO, for up to 4 streams
-class NCO {
- public:
-  NCO() = default;
-  NCO(liquid_ncotype type, float freq);
-  NCO(const NCO&)             = delete;
-  NCO& operator=(const NCO&)  = delete;
-  NCO(NCO&& other)            = delete;
-  NCO& operator=(NCO&& other) = delete;
-  ~NCO();
-  void init(liquid_ncotype type, float freq);
-  std::complex<float> mixDown(std::complex<float> s, int n_stream = 0);
-  void step();
-  void setPLLBandwidth(float);
-  void stepPLL(float dphi);
-  void reset();
-  std::complex<float> get(int n_stream) const {
-    return std::polar(1.f, -phases_[n_stream]);
-  }
-
- private:
-  nco_crcf object_{nullptr};
-  float initial_frequency_{};
-  float prev_f0_phase_{};
-  std::array<float, 4> phases_{};
-};
+std::vector<float> designKaiserLowpass(std::uint32_t len, float fc, float As = 60.0f,
+                                       float mu = 0.0f);
 
 class SymSync {
  public:
@@ -124,11 +80,11 @@ class SymSync {
   void reset();
   void setBandwidth(float);
   void setOutputRate(std::uint32_t);
-  redsea::Maybe<std::complex<float>> execute(std::complex<float>& in);
+  void execute(const std::complex<float>* input, std::size_t num_samples,
+               std::vector<std::complex<float>>& symbols, std::vector<std::size_t>& positions);
 
  private:
   symsync_crcf object_{nullptr};
-  std::vector<std::complex<float>> out_;
 };
 
 class Modem {
@@ -150,9 +106,52 @@ class Modem {
 #endif
 };
 
+// \brief Complex FFT of a fixed size, in or out of place between its own buffers. Neither
+//        direction is normalized.
+class FFT {
+ public:
+  FFT() = default;
+  void init(std::size_t size, bool is_inverse);
+  FFT(const FFT&)             = delete;
+  FFT& operator=(const FFT&)  = delete;
+  FFT(FFT&& other)            = delete;
+  FFT& operator=(FFT&& other) = delete;
+  ~FFT();
+  void execute();
+  std::complex<float>* input() {
+    return input_.data();
+  }
+  [[nodiscard]] const std::complex<float>* output() const {
+    return output_.data();
+  }
+
+ private:
+  std::vector<std::complex<float>> input_;
+  std::vector<std::complex<float>> output_;
+  fftplan plan_{nullptr};
+};
+
+// \brief Polyphase filter bank that splits a signal into evenly spaced channels, each at twice
+//        the channel spacing (firpfbch2). Channel k is centered at k/num_channels of the input
+//        sample rate.
+class Channelizer {
+ public:
+  Channelizer() = default;
+  void init(std::uint32_t num_channels, std::uint32_t filter_delay, std::vector<float> prototype);
+  Channelizer(const Channelizer&)             = delete;
+  Channelizer& operator=(const Channelizer&)  = delete;
+  Channelizer(Channelizer&& other)            = delete;
+  Channelizer& operator=(Channelizer&& other) = delete;
+  ~Channelizer();
+  void execute(std::complex<float>* in, std::complex<float>* out);
+
+ private:
+  firpfbch2_crcf object_{nullptr};
+};
+
 class Resampler {
  public:
-  static constexpr std::size_t kOutputArraySize{2ULL};
+  static constexpr float kMaxRatio{2.f};
 
   explicit Resampler(std::uint32_t half_length);
   Resampler(const Resampler&)             = delete;
@@ -162,10 +161,12 @@ class Resampler {
   ~Resampler();
   void setRatio(float ratio);
 
-  std::uint32_t execute(float in, std::array<float, kOutputArraySize>& out);
+  std::size_t execute(const float* input, std::size_t num_input, float* output);
+  [[nodiscard]] std::size_t getMaxOutputSize(std::size_t num_input) const;
 
  private:
   resamp_rrrf object_;
+  float ratio_{1.f};
 };
 
 }  // namespace liquid
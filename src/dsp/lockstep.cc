@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/lockstep.hh"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/liquid_wrappers.hh"
+#include "src/dsp/simd.hh"
+#include "src/util/util.hh"
+
+namespace redsea {
+
+namespace {
+
+constexpr std::size_t kNumLanes = LockstepFrontEnd::kNumLanes;
+
+using Lanes = std::array<float, kNumLanes>;
+
+// Re-seed the rotators from the exact phase this often (in samples), as in Oscillator
+constexpr std::size_t kReseedInterval = 1024;
+
+// Consecutive samples whose phasors are rotated in parallel in each lane, so that a rotation
+// doesn't have to wait for the one before it. Divides kReseedInterval.
+constexpr std::size_t kNumRotators = 4;
+
+using Rotators = std::array<float, kNumRotators * kNumLanes>;
+
+// Filter taps per iteration of the dot product. Each has its own accumulators, so the additions
+// don't all wait for each other.
+constexpr std::size_t kDotProductUnroll = 4;
+
+// Same limits as in NativeAGC
+constexpr float kAGCMinEnergy = 1e-6f;
+constexpr float kAGCMaxGain   = 1e6f;
+
+// \brief Multiply a transposed block by the rotating phasors, kNumRotators samples at a time.
+// \param phasor_re, phasor_im Element i * kNumLanes + j holds the phasor for sample i of lane j
+// \param step_re, step_im Rotation by kNumRotators samples, in the same layout
+REDSEA_SIMD_CLONES
+void mixDownLanes(const float* input, std::size_t num_samples, Rotators phasor_re,
+                  Rotators phasor_im, const Rotators& step_re, const Rotators& step_im,
+                  float* output_re, float* output_im) {
+  std::size_t i = 0;
+  for (; i + kNumRotators <= num_samples; i += kNumRotators) {
+    for (std::size_t j = 0; j < phasor_re.size(); j++) {
+      output_re[i * kNumLanes + j] = input[i * kNumLanes + j] * phasor_re[j];
+      output_im[i * kNumLanes + j] = input[i * kNumLanes + j] * phasor_im[j];
+    }
+    for (std::size_t j = 0; j < phasor_re.size(); j++) {
+      const float re = phasor_re[j] * step_re[j] - phasor_im[j] * step_im[j];
+      const float im = phasor_re[j] * step_im[j] + phasor_im[j] * step_re[j];
+      phasor_re[j]   = re;
+      phasor_im[j]   = im;
+    }
+  }
+  for (std::size_t j = 0; i * kNumLanes + j < num_samples * kNumLanes; j++) {
+    output_re[i * kNumLanes + j] = input[i * kNumLanes + j] * phasor_re[j];
+    output_im[i * kNumLanes + j] = input[i * kNumLanes + j] * phasor_im[j];
+  }
+}
+
+// \brief One output for every ratio inputs, starting from input first_input.
+// \param samples_re, samples_im The window for input i ends at sample i
+// \param coeffs Each coefficient repeated for every lane, so that a tap is a plain element-wise
+//        multiply-add over the lanes
+// \param length Number of taps; must be a multiple of kDotProductUnroll
+// \return Number of output samples written
+REDSEA_SIMD_CLONES
+std::size_t decimateLanes(const float* samples_re, const float* samples_im, const float* coeffs,
+                          std::size_t length, std::size_t first_input, std::size_t num_input,
+                          std::uint32_t ratio, float* output_re, float* output_im) {
+  std::size_t num_output{};
+  for (std::size_t i_input = first_input; i_input < num_input; i_input += ratio) {
+    const float* window_re = samples_re + i_input * kNumLanes;
+    const float* window_im = samples_im + i_input * kNumLanes;
+
+    std::array<float, kDotProductUnroll * kNumLanes> acc_re{};
+    std::array<float, kDotProductUnroll * kNumLanes> acc_im{};
+    for (std::size_t i = 0; i < length * kNumLanes; i += acc_re.size()) {
+      for (std::size_t j = 0; j < acc_re.size(); j++) {
+        acc_re[j] += coeffs[i + j] * window_re[i + j];
+        acc_im[j] += coeffs[i + j] * window_im[i + j];
+      }
+    }
+
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      float sum_re{};
+      float sum_im{};
+      for (std::size_t k = 0; k < kDotProductUnroll; k++) {
+        sum_re += acc_re[k * kNumLanes + j];
+        sum_im += acc_im[k * kNumLanes + j];
+      }
+      output_re[num_output * kNumLanes + j] = sum_re;
+      output_im[num_output * kNumLanes + j] = sum_im;
+    }
+    num_output++;
+  }
+  return num_output;
+}
+
+// \brief The loop of NativeAGC, for all lanes in step. In place.
+void gainControlLanes(float* samples_re, float* samples_im, std::size_t num_samples,
+                      float bandwidth, Lanes& gain, Lanes& energy) {
+  for (std::size_t i = 0; i < num_samples; i++) {
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      const float re = samples_re[i * kNumLanes + j] * gain[j];
+      const float im = samples_im[i * kNumLanes + j] * gain[j];
+      energy[j]      = (1.f - bandwidth) * energy[j] + bandwidth * (re * re + im * im);
+      if (energy[j] > kAGCMinEnergy)
+        gain[j] *= std::exp(-0.5f * bandwidth * std::log(energy[j]));
+      gain[j]                        = std::min(gain[j], kAGCMaxGain);
+      samples_re[i * kNumLanes + j] = re;
+      samples_im[i * kNumLanes + j] = im;
+    }
+  }
+}
+
+}  // namespace
+
+// \param lowpass_coeffs Filter coefficients (impulse response) in natural order
+// \param ratio Decimation ratio; one output is computed for every `ratio` inputs
+// \param frequencies Subcarrier frequency of each lane, in radians per input sample
+// \param agc_bandwidth Relative to the output sample rate
+void LockstepFrontEnd::init(const std::vector<float>& lowpass_coeffs, std::uint32_t ratio,
+                            const std::vector<float>& frequencies, float agc_bandwidth,
+                            float agc_initial_gain) {
+  assert(!lowpass_coeffs.empty() && ratio >= 1 && !frequencies.empty());
+
+  num_lanes_     = frequencies.size();
+  ratio_         = ratio;
+  agc_bandwidth_ = agc_bandwidth;
+  next_output_   = 0;
+
+  padded_length_ = divideRoundingUp(lowpass_coeffs.size(), kDotProductUnroll) * kDotProductUnroll;
+  coeffs_.assign(padded_length_ * kNumLanes, 0.f);
+  for (std::size_t i = 0; i < lowpass_coeffs.size(); i++) {
+    const std::size_t i_reversed = padded_length_ - 1 - i;
+    std::fill_n(&coeffs_[i_reversed * kNumLanes], kNumLanes, lowpass_coeffs[i]);
+  }
+
+  groups_.assign(divideRoundingUp(num_lanes_, kNumLanes), LaneGroup{});
+  for (std::size_t i_lane = 0; i_lane < num_lanes_; i_lane++) {
+    LaneGroup& group = groups_[i_lane / kNumLanes];
+    group.frequency[i_lane % kNumLanes] = frequencies[i_lane];
+  }
+  for (auto& group : groups_) {
+    group.agc_gain.fill(agc_initial_gain);
+    group.agc_energy.fill(1.f);
+    group.history_re.assign((padded_length_ - 1) * kNumLanes, 0.f);
+    group.history_im.assign((padded_length_ - 1) * kNumLanes, 0.f);
+  }
+}
+
+// \brief Mix down, filter, decimate and gain-control a block of every lane.
+// \param inputs One pointer per lane, to num_input samples each
+// \param outputs One pointer per lane, each with room for getOutputSize(num_input) samples
+// \return Number of output samples written to each lane
+// \note The output sample at index n corresponds to the input sample at index
+//       getNextOutputIndex() + n * ratio, as seen before the call.
+std::size_t LockstepFrontEnd::execute(const float* const* inputs, std::size_t num_input,
+                                      std::complex<float>* const* outputs) {
+  const std::size_t num_history = padded_length_ - 1;
+  const std::size_t num_output  = getOutputSize(num_input);
+
+  for (std::size_t i_group = 0; i_group < groups_.size(); i_group++) {
+    LaneGroup& group             = groups_[i_group];
+    const std::size_t first_lane = i_group * kNumLanes;
+    const std::size_t num_active = std::min(kNumLanes, num_lanes_ - first_lane);
+
+    // Transpose. Unused lanes of the last group are never written to, so they stay silent.
+    if (group.input.size() < num_input * kNumLanes)
+      group.input.resize(num_input * kNumLanes);
+    for (std::size_t i = 0; i < num_input; i++) {
+      for (std::size_t j = 0; j < num_active; j++)
+        group.input[i * kNumLanes + j] = inputs[first_lane + j][i];
+    }
+
+    mixDown(group, num_input);
+
+    // Input sample i is at history[num_history + i]; the window ends there
+    group.output_re.resize(num_output * kNumLanes);
+    group.output_im.resize(num_output * kNumLanes);
+    const std::size_t num_decimated =
+        decimateLanes(group.history_re.data(), group.history_im.data(), coeffs_.data(),
+                      padded_length_, next_output_, num_input, ratio_, group.output_re.data(),
+                      group.output_im.data());
+    assert(num_decimated == num_output);
+    static_cast<void>(num_decimated);
+
+    gainControlLanes(group.output_re.data(), group.output_im.data(), num_output, agc_bandwidth_,
+                     group.agc_gain, group.agc_energy);
+
+    for (std::size_t j = 0; j < num_active; j++) {
+      std::complex<float>* output = outputs[first_lane + j];
+      for (std::size_t i = 0; i < num_output; i++) {
+        output[i] = {group.output_re[i * kNumLanes + j], group.output_im[i * kNumLanes + j]};
+      }
+    }
+
+    // Keep the end of the block as history for the next one
+    const auto first_kept = static_cast<std::ptrdiff_t>(num_input * kNumLanes);
+    const auto num_kept   = static_cast<std::ptrdiff_t>(num_history * kNumLanes);
+    std::copy_n(group.history_re.begin() + first_kept, num_kept, group.history_re.begin());
+    std::copy_n(group.history_im.begin() + first_kept, num_kept, group.history_im.begin());
+  }
+
+  next_output_ = next_output_ + num_output * ratio_ - num_input;
+
+  return num_output;
+}
+
+// \brief Multiply the group's transposed input by exp(-j * phase) of each lane and append the
+//        result to the filter history.
+void LockstepFrontEnd::mixDown(LaneGroup& group, std::size_t num_input) {
+  const std::size_t num_history = padded_length_ - 1;
+  if (group.history_re.size() < (num_history + num_input) * kNumLanes) {
+    group.history_re.resize((num_history + num_input) * kNumLanes);
+    group.history_im.resize((num_history + num_input) * kNumLanes);
+  }
+
+  std::array<std::complex<float>, kNumLanes> sample_step{};
+  Rotators step_re{};
+  Rotators step_im{};
+  for (std::size_t j = 0; j < kNumLanes; j++) {
+    sample_step[j] = std::polar(1.f, static_cast<float>(-group.frequency[j]));
+    const auto step =
+        std::polar(1.0, -group.frequency[j] * static_cast<double>(kNumRotators));
+    for (std::size_t i = 0; i < kNumRotators; i++) {
+      step_re[i * kNumLanes + j] = static_cast<float>(step.real());
+      step_im[i * kNumLanes + j] = static_cast<float>(step.imag());
+    }
+  }
+
+  for (std::size_t i_start = 0; i_start < num_input; i_start += kReseedInterval) {
+    const std::size_t length = std::min(kReseedInterval, num_input - i_start);
+
+    // The first phasor of each lane is exact; the rest are a few steps away from it
+    Rotators phasor_re{};
+    Rotators phasor_im{};
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      auto phasor = static_cast<std::complex<float>>(std::polar(1.0, -group.phase[j]));
+      for (std::size_t i = 0; i < kNumRotators; i++) {
+        phasor_re[i * kNumLanes + j] = phasor.real();
+        phasor_im[i * kNumLanes + j] = phasor.imag();
+        phasor *= sample_step[j];
+      }
+    }
+
+    const std::size_t i_output = (num_history + i_start) * kNumLanes;
+    mixDownLanes(&group.input[i_start * kNumLanes], length, phasor_re, phasor_im, step_re,
+                 step_im, &group.history_re[i_output], &group.history_im[i_output]);
+
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      group.phase[j] = std::remainder(
+          group.phase[j] + group.frequency[j] * static_cast<double>(length), k2PiDouble);
+    }
+  }
+}
+
+void LockstepFrontEnd::resetOscillator(std::size_t i_lane) {
+  assert(i_lane < num_lanes_);
+  groups_[i_lane / kNumLanes].phase[i_lane % kNumLanes] = 0.0;
+}
+
+std::size_t LockstepFrontEnd::getNumLanes() const {
+  return num_lanes_;
+}
+
+// \return Index of the input sample (in the next block) that will produce the next output
+std::size_t LockstepFrontEnd::getNextOutputIndex() const {
+  return next_output_;
+}
+
+// \return Number of output samples that execute() would produce for num_input samples
+std::size_t LockstepFrontEnd::getOutputSize(std::size_t num_input) const {
+  return next_output_ < num_input ? (num_input - next_output_ - 1) / ratio_ + 1 : 0;
+}
+
+}  // namespace redsea
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_LOCKSTEP_H_
+#define DSP_LOCKSTEP_H_
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace redsea {
+
+// \brief Mixes down, filters and gain-controls the subcarriers of many signals at once.
+//
+// Each lane is one subcarrier of one signal, and all lanes are fed blocks of the same size. The
+// state of kNumLanes lanes is kept in structure-of-arrays form (one array per quantity, indexed
+// by lane), so every step of the oscillator, the decimating FIR and the AGC does the same
+// arithmetic on all lanes of a group with one vector instruction. The output is that of
+// Oscillator, FIRDecimator and NativeAGC in series, apart from rounding.
+class LockstepFrontEnd {
+ public:
+  // Lanes processed together; 8 floats fill an AVX register
+  static constexpr std::size_t kNumLanes = 8;
+
+  LockstepFrontEnd() = default;
+  void init(const std::vector<float>& lowpass_coeffs, std::uint32_t ratio,
+            const std::vector<float>& frequencies, float agc_bandwidth, float agc_initial_gain);
+
+  std::size_t execute(const float* const* inputs, std::size_t num_input,
+                      std::complex<float>* const* outputs);
+  void resetOscillator(std::size_t i_lane);
+  [[nodiscard]] std::size_t getNumLanes() const;
+  [[nodiscard]] std::size_t getNextOutputIndex() const;
+  [[nodiscard]] std::size_t getOutputSize(std::size_t num_input) const;
+
+ private:
+  using Lanes = std::array<float, kNumLanes>;
+
+  struct LaneGroup {
+    // Radians
+    std::array<double, kNumLanes> phase{};
+    // Radians per sample
+    std::array<double, kNumLanes> frequency{};
+    Lanes agc_gain{};
+    // Smoothed output energy
+    Lanes agc_energy{};
+    // Input block, transposed: kNumLanes values per sample
+    std::vector<float> input;
+    // The last (padded length - 1) mixed-down samples, followed by the current block;
+    // kNumLanes values per sample
+    std::vector<float> history_re;
+    std::vector<float> history_im;
+    // Decimated samples, kNumLanes values per sample
+    std::vector<float> output_re;
+    std::vector<float> output_im;
+  };
+
+  void mixDown(LaneGroup& group, std::size_t num_input);
+
+  std::size_t num_lanes_{};
+  // Coefficients in reverse order, zero-padded in the front to a multiple of the unroll factor;
+  // each one repeated kNumLanes times
+  std::vector<float> coeffs_;
+  std::size_t padded_length_{};
+  std::uint32_t ratio_{1};
+  float agc_bandwidth_{};
+  std::vector<LaneGroup> groups_;
+  // Index of the next output sample, relative to the beginning of the next input block; the
+  // same for all lanes
+  std::size_t next_output_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_LOCKSTEP_H_
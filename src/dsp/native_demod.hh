@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_NATIVE_DEMOD_H_
+#define DSP_NATIVE_DEMOD_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+#include "src/dsp/liquid_wrappers.hh"
+
+// Our own versions of the parts of the demodulation chain that run at the decimated rate. They
+// are defined here in the header, so that the compiler sees the whole chain at once.
+
+namespace redsea {
+
+// \brief Automatic gain control. Same loop as liquid-dsp's agc_crcf: the gain follows the
+//        smoothed output energy on a logarithmic scale.
+class NativeAGC {
+ public:
+  NativeAGC() = default;
+
+  // \param bandwidth Relative to the sample rate
+  void init(float bandwidth, float initial_gain) {
+    alpha_  = bandwidth;
+    gain_   = initial_gain;
+    energy_ = 1.f;
+  }
+
+  // \brief Can be done in place
+  void execute(const std::complex<float>* input, std::size_t num_samples,
+               std::complex<float>* output) {
+    for (std::size_t i = 0; i < num_samples; i++) {
+      const std::complex<float> sample = input[i] * gain_;
+      energy_ = (1.f - alpha_) * energy_ + alpha_ * std::norm(sample);
+      if (energy_ > kMinEnergy)
+        gain_ *= std::exp(-0.5f * alpha_ * std::log(energy_));
+      gain_     = std::min(gain_, kMaxGain);
+      output[i] = sample;
+    }
+  }
+
+ private:
+  static constexpr float kMinEnergy = 1e-6f;
+  // 120 dB
+  static constexpr float kMaxGain   = 1e6f;
+
+  float alpha_{};
+  float gain_{1.f};
+  // Smoothed output energy
+  float energy_{1.f};
+};
+
+// \brief Phase error of a BPSK symbol, relative to the closest constellation point (+1 or -1).
+//        Same as what liquid-dsp's PSK2 modem reports after demodulating the symbol.
+inline float bpskPhaseError(std::complex<float> symbol) {
+  return symbol.real() >= 0.f ? symbol.imag() : -symbol.imag();
+}
+
+// \brief Symbol timing recovery for a signal at a fixed, integer number of samples per symbol.
+//
+// The samples go through a root-raised-cosine matched filter. A Gardner timing error detector
+// compares the symbols with the samples halfway between them, and steers a cubic interpolator
+// that picks the symbols out of the filtered signal. Unlike liquid-dsp's symsync there's no
+// bank of polyphase filters; the filter runs at the input rate, one block at a time.
+template <int kSamplesPerSymbol>
+class GardnerSync {
+  static_assert(kSamplesPerSymbol >= 2, "Gardner needs at least 2 samples per symbol");
+
+ public:
+  GardnerSync() = default;
+
+  // \param filter_delay Semi-length of the matched filter, in symbols
+  // \param beta Excess bandwidth of the matched filter
+  // \param bandwidth Loop noise bandwidth, relative to the symbol rate
+  void init(std::uint32_t filter_delay, float beta, float bandwidth) {
+    const std::size_t length = 2 * filter_delay * kSamplesPerSymbol + 1;
+    std::vector<float> coeffs(length);
+    float sum{};
+    for (std::size_t i = 0; i < length; i++) {
+      const float t = (static_cast<float>(i) - static_cast<float>(length - 1) / 2.f) /
+                      static_cast<float>(kSamplesPerSymbol);
+      coeffs[i]     = rootRaisedCosine(t, beta);
+      sum += coeffs[i];
+    }
+    // Unity gain at DC
+    for (auto& coeff : coeffs) coeff /= sum;
+    coeffs_ = shareCoeffs(std::move(coeffs));
+
+    // Second-order loop, damping factor 1/sqrt(2) (Rice, Digital Communications, appendix C)
+    constexpr float kDamping = 0.70710678f;
+    const float theta        = bandwidth / (kDamping + 0.25f / kDamping);
+    const float denominator  = (1.f + 2.f * kDamping * theta + theta * theta) * kDetectorGain;
+    proportional_gain_       = 4.f * kDamping * theta / denominator;
+    integral_gain_           = 4.f * theta * theta / denominator;
+
+    reset();
+  }
+
+  void reset() {
+    history_.assign(coeffs_->size() - 1, 0.f);
+    filtered_.assign(kNumKeptFiltered, 0.f);
+    next_symbol_   = kNumKeptFiltered;
+    prev_symbol_   = 0.f;
+    loop_integral_ = 0.f;
+  }
+
+  // \brief Recover symbols from a block of samples.
+  // \param symbols Gets the symbols appended to it
+  // \param positions Gets the index of the input sample that completed each symbol
+  void execute(const std::complex<float>* input, std::size_t num_samples,
+               std::vector<std::complex<float>>& symbols, std::vector<std::size_t>& positions) {
+    // Matched filter over the whole block; the coefficients are symmetric
+    const float* coeffs      = coeffs_->data();
+    const std::size_t length = coeffs_->size();
+    history_.insert(history_.end(), input, input + num_samples);
+    const std::size_t num_kept = filtered_.size();
+    filtered_.resize(num_kept + num_samples);
+    for (std::size_t i = 0; i < num_samples; i++) {
+      std::complex<float> sum{};
+      for (std::size_t j = 0; j < length; j++) sum += history_[i + j] * coeffs[j];
+      filtered_[num_kept + i] = sum;
+    }
+    history_.erase(history_.begin(), history_.end() - static_cast<std::ptrdiff_t>(length - 1));
+
+    // The interpolator needs one sample before and two after the symbol's position
+    while (next_symbol_ + 2.0 < static_cast<double>(filtered_.size())) {
+      const std::complex<float> symbol = interpolate(next_symbol_);
+      const std::complex<float> middle =
+          interpolate(next_symbol_ - 0.5 * static_cast<double>(kSamplesPerSymbol));
+
+      // Positive when the symbols are being sampled too early
+      const float timing_error = std::real((prev_symbol_ - symbol) * std::conj(middle));
+      loop_integral_ += integral_gain_ * timing_error;
+      const float adjustment =
+          std::clamp(proportional_gain_ * timing_error + loop_integral_, -kMaxAdjustment,
+                     kMaxAdjustment);
+
+      symbols.push_back(symbol);
+      positions.push_back(static_cast<std::size_t>(next_symbol_) + 2 - num_kept);
+
+      prev_symbol_ = symbol;
+      next_symbol_ += static_cast<double>(kSamplesPerSymbol) + adjustment;
+    }
+
+    // Keep the end for interpolating across the block boundary
+    const std::size_t num_dropped = filtered_.size() - kNumKeptFiltered;
+    filtered_.erase(filtered_.begin(),
+                    filtered_.begin() + static_cast<std::ptrdiff_t>(num_dropped));
+    next_symbol_ -= static_cast<double>(num_dropped);
+    assert(next_symbol_ >= 0.5 * kSamplesPerSymbol + 1.0);
+  }
+
+  // \return Delay from a symbol's center to the sample that completes it, in samples
+  [[nodiscard]] float getDelay() const {
+    return static_cast<float>(coeffs_->size() - 1) / 2.f + 2.f;
+  }
+
+ private:
+  // Filtered samples carried over to the next block; enough for the middle sample's interpolator
+  static constexpr std::size_t kNumKeptFiltered = 2 * kSamplesPerSymbol + 2;
+  // Slope of the detector's S-curve around zero, per sample of timing error; measured for
+  // biphase-coded symbols of unit amplitude after the subcarrier's 2.4 kHz low-pass filter
+  static constexpr float kDetectorGain = 1.15f;
+  // Fraction of a sample per symbol
+  static constexpr float kMaxAdjustment = 0.5f;
+
+  static float rootRaisedCosine(float t, float beta) {
+    if (std::abs(t) < 1e-6f)
+      return 1.f - beta + 4.f * beta / kPi;
+    if (std::abs(std::abs(4.f * beta * t) - 1.f) < 1e-6f)
+      return beta / std::sqrt(2.f) *
+             ((1.f + 2.f / kPi) * std::sin(kPi / (4.f * beta)) +
+              (1.f - 2.f / kPi) * std::cos(kPi / (4.f * beta)));
+    return (std::sin(kPi * t * (1.f - beta)) + 4.f * beta * t * std::cos(kPi * t * (1.f + beta))) /
+           (kPi * t * (1.f - (4.f * beta * t) * (4.f * beta * t)));
+  }
+
+  // Cubic Lagrange interpolation between filtered samples
+  [[nodiscard]] std::complex<float> interpolate(double position) const {
+    const auto i  = static_cast<std::size_t>(position);
+    const auto mu = static_cast<float>(position - static_cast<double>(i));
+    assert(i >= 1 && i + 2 < filtered_.size());
+
+    const std::array<float, 4> weights{-mu * (mu - 1.f) * (mu - 2.f) / 6.f,
+                                       (mu + 1.f) * (mu - 1.f) * (mu - 2.f) / 2.f,
+                                       -(mu + 1.f) * mu * (mu - 2.f) / 2.f,
+                                       (mu + 1.f) * mu * (mu - 1.f) / 6.f};
+    return filtered_[i - 1] * weights[0] + filtered_[i] * weights[1] +
+           filtered_[i + 1] * weights[2] + filtered_[i + 2] * weights[3];
+  }
+
+  // Matched filter, shared by all symbol synchronizers with the same parameters
+  SharedCoeffs<float> coeffs_;
+  // The last (filter length - 1) input samples
+  std::vector<std::complex<float>> history_;
+  // Matched filter output: kNumKeptFiltered samples from the previous block, then this block
+  std::vector<std::complex<float>> filtered_;
+  // Position of the next symbol in filtered_, in samples
+  double next_symbol_{};
+  std::complex<float> prev_symbol_{};
+  float proportional_gain_{};
+  float integral_gain_{};
+  float loop_integral_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_NATIVE_DEMOD_H_
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/oscillator.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+
+#include "src/dsp/liquid_wrappers.hh"
+#include "src/dsp/simd.hh"
+
+namespace redsea {
+
+namespace {
+
+// Number of phasors rotated in parallel; 8 floats fill an AVX register
+constexpr std::size_t kNumLanes = 8;
+
+// Re-seed the rotators from the exact phase this often (in samples). Single-precision rotation
+// drifts by roughly 1e-7 radians per step, so the error stays well below 1e-4.
+constexpr std::size_t kReseedInterval = 1024;
+
+using Lanes = std::array<float, kNumLanes>;
+
+// \brief Mix a block with the rotating phasors, kNumLanes samples at a time.
+// \param phasor_re, phasor_im Lane j holds the phasor for sample j
+REDSEA_SIMD_CLONES
+void mixDownBlock(const float* in, std::size_t length, Lanes phasor_re, Lanes phasor_im,
+                  float step_re, float step_im, std::complex<float>* out) {
+  std::size_t i = 0;
+  for (; i + kNumLanes <= length; i += kNumLanes) {
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      out[i + j] = {in[i + j] * phasor_re[j], in[i + j] * phasor_im[j]};
+    }
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      const float re = phasor_re[j] * step_re - phasor_im[j] * step_im;
+      const float im = phasor_re[j] * step_im + phasor_im[j] * step_re;
+      phasor_re[j]   = re;
+      phasor_im[j]   = im;
+    }
+  }
+  for (std::size_t j = 0; i < length; i++, j++) {
+    out[i] = {in[i] * phasor_re[j], in[i] * phasor_im[j]};
+  }
+}
+
+}  // namespace
+
+// \param frequency Radians per sample
+void Oscillator::init(float frequency) {
+  frequency_ = frequency;
+  phase_     = 0.0;
+}
+
+// \brief Multiply the input by exp(-j * phase), advancing the phase by one step per sample.
+// \param output Must have room for num_samples samples (may not alias input)
+void Oscillator::mixDown(const float* input, std::size_t num_samples,
+                         std::complex<float>* output) {
+  const double step_angle = -frequency_ * static_cast<double>(kNumLanes);
+  const auto step_re      = static_cast<float>(std::cos(step_angle));
+  const auto step_im      = static_cast<float>(std::sin(step_angle));
+
+  for (std::size_t i_start = 0; i_start < num_samples; i_start += kReseedInterval) {
+    const std::size_t length = std::min(kReseedInterval, num_samples - i_start);
+
+    // Lane j holds the phasor for sample j of the block
+    Lanes phasor_re{};
+    Lanes phasor_im{};
+    for (std::size_t j = 0; j < kNumLanes; j++) {
+      const double angle = -(phase_ + frequency_ * static_cast<double>(j));
+      phasor_re[j]       = static_cast<float>(std::cos(angle));
+      phasor_im[j]       = static_cast<float>(std::sin(angle));
+    }
+
+    mixDownBlock(input + i_start, length, phasor_re, phasor_im, step_re, step_im,
+                 output + i_start);
+
+    phase_ = std::remainder(phase_ + frequency_ * static_cast<double>(length), k2PiDouble);
+  }
+}
+
+void Oscillator::reset() {
+  phase_ = 0.0;
+}
+
+}  // namespace redsea
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_OSCILLATOR_H_
+#define DSP_OSCILLATOR_H_
+
+#include <complex>
+#include <cstddef>
+
+namespace redsea {
+
+// \brief Fixed-frequency complex oscillator for mixing a real signal down to baseband.
+//
+// The mixing phasors are generated by recursive rotation in parallel lanes, so the inner loop
+// has no sincos calls and can be vectorized. The rotators are re-seeded from a double-precision
+// phase accumulator at regular intervals, so rounding errors don't build up.
+class Oscillator {
+ public:
+  Oscillator() = default;
+  void init(float frequency);
+  void mixDown(const float* input, std::size_t num_samples, std::complex<float>* output);
+  void reset();
+
+ private:
+  // Radians
+  double phase_{};
+  // Radians per sample
+  double frequency_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_OSCILLATOR_H_
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/resampler.hh"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+#include "src/dsp/simd.hh"
+#include "src/util/maybe.hh"
+#include "src/util/util.hh"
+
+namespace redsea {
+
+namespace {
+
+// More polyphase branches than this and we'd rather use liquid's arbitrary-ratio resampler
+constexpr std::uint32_t kMaxInterpolation = 256;
+
+constexpr float kStopbandAttenuation_dB = 60.0f;
+
+// Samples per iteration of the dot product. The independent accumulators let the compiler
+// vectorize the loop without reordering floating-point additions.
+constexpr std::size_t kDotProductUnroll = 8;
+
+// \param length Must be a multiple of kDotProductUnroll
+float dotProduct(const float* samples, const float* coeffs, std::size_t length) {
+  std::array<float, kDotProductUnroll> acc{};
+
+  for (std::size_t i = 0; i < length; i += acc.size()) {
+    for (std::size_t j = 0; j < acc.size(); j++) {
+      acc[j] += coeffs[i + j] * samples[i + j];
+    }
+  }
+
+  return std::accumulate(acc.cbegin(), acc.cend(), 0.0f);
+}
+
+// \brief Compute the outputs whose windows end before num_input.
+// \param samples The window for input i ends at sample i
+// \param next_input, branch Position of the next output; updated
+// \return Number of output samples written
+REDSEA_SIMD_CLONES
+std::size_t resample(const float* samples, const float* coeffs, std::size_t num_taps,
+                     const std::uint32_t* input_step, const std::uint32_t* next_branch,
+                     std::size_t num_input, std::size_t& next_input, std::uint32_t& branch,
+                     float* output) {
+  std::size_t num_output{};
+  while (next_input < num_input) {
+    output[num_output] = dotProduct(&samples[next_input], &coeffs[branch * num_taps], num_taps);
+    num_output++;
+
+    next_input += input_step[branch];
+    branch = next_branch[branch];
+  }
+  return num_output;
+}
+
+}  // namespace
+
+// \brief Find the exact resampling ratio between two integer sample rates.
+// \return Nothing if the rates are not integers or the ratio needs too many polyphase branches
+Maybe<RationalRatio> findRationalRatio(float input_rate, float output_rate) {
+  if (input_rate < 1.f || output_rate < 1.f || std::floor(input_rate) != input_rate ||
+      std::floor(output_rate) != output_rate) {
+    return {};
+  }
+
+  const auto input_rate_int  = static_cast<std::uint32_t>(input_rate);
+  const auto output_rate_int = static_cast<std::uint32_t>(output_rate);
+  const auto divisor         = std::gcd(input_rate_int, output_rate_int);
+
+  RationalRatio ratio;
+  ratio.interpolation = output_rate_int / divisor;
+  ratio.decimation    = input_rate_int / divisor;
+
+  return {ratio, ratio.interpolation <= kMaxInterpolation};
+}
+
+// \param cutoff_Hz Cutoff frequency of the anti-aliasing/anti-imaging filter
+// \param transition_width_Hz Width of the filter's transition band; determines the filter length
+void RationalResampler::init(RationalRatio ratio, float input_rate, float cutoff_Hz,
+                             float transition_width_Hz) {
+  assert(ratio.interpolation >= 1 && ratio.decimation >= 1);
+  ratio_ = ratio;
+
+  const float upsampled_rate = input_rate * static_cast<float>(ratio_.interpolation);
+
+  // Kaiser's estimate for the filter length
+  const float required_length = (kStopbandAttenuation_dB - 7.95f) /
+                                    (14.36f * transition_width_Hz / upsampled_rate) +
+                                1.f;
+  num_taps_ = divideRoundingUp(static_cast<std::size_t>(required_length) / ratio_.interpolation + 1,
+                               kDotProductUnroll) *
+              kDotProductUnroll;
+
+  const std::size_t prototype_length = num_taps_ * ratio_.interpolation;
+  const auto prototype = getKaiserLowpass(static_cast<std::uint32_t>(prototype_length),
+                                          cutoff_Hz / upsampled_rate, kStopbandAttenuation_dB);
+
+  // Interpolation by zero-stuffing loses gain by a factor of L
+  std::vector<float> coeffs(prototype_length);
+  for (std::uint32_t branch = 0; branch < ratio_.interpolation; branch++) {
+    for (std::size_t k = 0; k < num_taps_; k++) {
+      coeffs[branch * num_taps_ + (num_taps_ - 1 - k)] =
+          (*prototype)[branch + k * ratio_.interpolation] *
+          static_cast<float>(ratio_.interpolation);
+    }
+  }
+  coeffs_ = shareCoeffs(std::move(coeffs));
+
+  next_branch_.resize(ratio_.interpolation);
+  input_step_.resize(ratio_.interpolation);
+  for (std::uint32_t branch = 0; branch < ratio_.interpolation; branch++) {
+    next_branch_[branch] = (branch + ratio_.decimation) % ratio_.interpolation;
+    input_step_[branch]  = (branch + ratio_.decimation) / ratio_.interpolation;
+  }
+
+  history_.assign(num_taps_ - 1, 0.f);
+  next_input_ = 0;
+  branch_     = 0;
+
+  // Group delay of the linear-phase prototype, converted to output samples
+  delay_ = static_cast<float>(prototype_length - 1) * 0.5f / static_cast<float>(ratio_.decimation);
+}
+
+// \param output Must have room for getMaxOutputSize(num_input) samples
+// \return Number of output samples written
+std::size_t RationalResampler::execute(const float* input, std::size_t num_input, float* output) {
+  assert(history_.size() == num_taps_ - 1);
+
+  history_.insert(history_.end(), input, input + num_input);
+
+  // Input sample n is at history_[num_taps_ - 1 + n]; the window ends there
+  const std::size_t num_output =
+      resample(history_.data(), coeffs_->data(), num_taps_, input_step_.data(),
+               next_branch_.data(), num_input, next_input_, branch_, output);
+  next_input_ -= num_input;
+
+  history_.erase(history_.begin(), history_.end() - static_cast<std::ptrdiff_t>(num_taps_ - 1));
+
+  return num_output;
+}
+
+std::size_t RationalResampler::getMaxOutputSize(std::size_t num_input) const {
+  return divideRoundingUp<std::size_t>(num_input * ratio_.interpolation, ratio_.decimation);
+}
+
+// \return Delay through the resampler, in output samples
+float RationalResampler::getDelay() const {
+  return delay_;
+}
+
+}  // namespace redsea
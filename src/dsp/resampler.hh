@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_RESAMPLER_H_
+#define DSP_RESAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/dsp/coeff_cache.hh"
+#include "src/util/maybe.hh"
+
+namespace redsea {
+
+// Output rate = input rate * interpolation / decimation
+struct RationalRatio {
+  std::uint32_t interpolation{1};
+  std::uint32_t decimation{1};
+};
+
+Maybe<RationalRatio> findRationalRatio(float input_rate, float output_rate);
+
+// \brief Polyphase resampler for an exact rational ratio L/M.
+//
+// Conceptually the input is upsampled by L, low-pass filtered, and downsampled by M; only the
+// output samples are computed, each from one of the L polyphase branches. Input can be fed in
+// blocks of any size.
+class RationalResampler {
+ public:
+  RationalResampler() = default;
+  void init(RationalRatio ratio, float input_rate, float cutoff_Hz, float transition_width_Hz);
+
+  std::size_t execute(const float* input, std::size_t num_input, float* output);
+  [[nodiscard]] std::size_t getMaxOutputSize(std::size_t num_input) const;
+  [[nodiscard]] float getDelay() const;
+
+ private:
+  RationalRatio ratio_;
+  // Taps per polyphase branch (padded)
+  std::size_t num_taps_{};
+  // Branch p occupies num_taps_ floats starting at p * num_taps_, in reverse order. Shared by
+  // all resamplers with the same filter.
+  SharedCoeffs<float> coeffs_;
+  // For each branch: which branch comes next, and how many input samples to advance
+  std::vector<std::uint32_t> next_branch_;
+  std::vector<std::uint32_t> input_step_;
+  // The last (num_taps_ - 1) input samples, followed by the current input block
+  std::vector<float> history_;
+  // Position of the next output: input sample index relative to the next block, and branch
+  std::size_t next_input_{};
+  std::uint32_t branch_{};
+  float delay_{};
+};
+
+}  // namespace redsea
+
+#endif  // DSP_RESAMPLER_H_
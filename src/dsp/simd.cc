@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/dsp/simd.hh"
+
+// What the compiler was allowed to use everywhere, e.g. with -march
+#if defined(__AVX512F__)
+#define REDSEA_SIMD_BASELINE "AVX-512"
+#elif defined(__AVX2__)
+#define REDSEA_SIMD_BASELINE "AVX2"
+#elif defined(__SSE2__)
+#define REDSEA_SIMD_BASELINE "SSE2"
+#elif defined(__ARM_NEON)
+#define REDSEA_SIMD_BASELINE "NEON"
+#else
+#define REDSEA_SIMD_BASELINE "none"
+#endif
+
+namespace redsea {
+
+// \return Name of the instruction set the DSP loops run with on this CPU
+const char* getSIMDInstructionSet() {
+#ifdef HAVE_TARGET_CLONES
+  // Same order of preference as the ifunc resolvers
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return "AVX2";
+  // The default clone is built for the baseline
+  return "default (" REDSEA_SIMD_BASELINE ")";
+#else
+  return REDSEA_SIMD_BASELINE;
+#endif
+}
+
+}  // namespace redsea
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef DSP_SIMD_H_
+#define DSP_SIMD_H_
+
+// The hot DSP loops are compiled for both SSE2 and AVX2, and the dynamic linker
+// picks the best one for the CPU once at startup (function multi-versioning). This needs ifunc
+// support from the toolchain and the C library; meson checks for it. Elsewhere the loops are
+// built for the compiler's target only.
+//
+// There's no AVX-512 variant: GCC contracts multiply-adds into FMA with it, which changes the
+// results in the last bits, and the 512-bit decimator loops ran slower than the AVX2 ones. The
+// AVX2 variant doesn't enable FMA, so both variants give the same results.
+#ifdef HAVE_TARGET_CLONES
+#define REDSEA_SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define REDSEA_SIMD_CLONES
+#endif
+
+// Helpers called from a multi-versioned loop must be inlined into it; otherwise every variant
+// calls the same generic copy.
+#if defined(__GNUC__)
+#define REDSEA_SIMD_INLINE __attribute__((always_inline)) inline
+#else
+#define REDSEA_SIMD_INLINE inline
+#endif
+
+namespace redsea {
+
+const char* getSIMDInstructionSet();
+
+}  // namespace redsea
+
+#endif  // DSP_SIMD_H_
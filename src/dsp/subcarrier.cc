@@ -18,13 +18,18 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cassert>
 #include <cmath>
 #include <complex>
 #include <cstdint>
 #include <cstdio>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 #include "src/constants.hh"
+#include "src/dsp/coeff_cache.hh"
 #include "src/dsp/liquid_wrappers.hh"
 #include "src/io/bitbuffer.hh"
 #include "src/io/input.hh"
@@ -37,23 +42,49 @@ namespace {
 constexpr float kAGCBandwidth_Hz     = 500.0f;
 constexpr float kAGCInitialGain      = 0.08f;
 constexpr float kLowpassCutoff_Hz    = 2400.0f;
+constexpr std::uint32_t kLowpassLength = 255;
 constexpr float kSymsyncBandwidth_Hz = 2200.0f;
 constexpr int kSymsyncDelay          = 3;
 constexpr int kResamplerDelay        = 13;
+// Anti-aliasing filter of the rational resampler. Its length grows with the input rate, so
+// above kMaxRationalResamplerRate_Hz we use liquid's resampler instead.
+constexpr float kResamplerTransitionWidth_Hz = 14000.0f;
+constexpr float kMaxRationalResamplerRate_Hz = 1'000'000.f;
+// Highest frequency used by any data stream (76 kHz + 2.4 kHz), with some margin
+constexpr float kHalfbandPassband_Hz         = 80'000.f;
 constexpr float kSymsyncBeta         = 0.8f;
+// Noise bandwidth of the native timing recovery loop, relative to the PSK symbol rate
+constexpr float kGardnerBandwidth    = 0.01f;
 constexpr float kPLLBandwidth_Hz     = 0.03f;
 constexpr float kPLLMultiplier       = 12.0f;
 
+constexpr std::array<float, 4> kSubcarrierFrequencies_Hz{57000.f, 66500.f, 71250.f, 76000.f};
+
+// A clean biphase symbol has a magnitude of ~1 after the AGC; scale that to half of the range, so
+// that stronger-than-usual symbols don't all saturate
+constexpr float kReliabilityScale = 128.f;
+
+// Designed once, for all channels and data streams
+SharedCoeffs<float> getSubcarrierLowpass() {
+  return getKaiserLowpass(kLowpassLength, kLowpassCutoff_Hz / kTargetSampleRate_Hz);
+}
+
+std::uint8_t quantizeReliability(float reliability) {
+  return static_cast<std::uint8_t>(
+      std::min(reliability * kReliabilityScale, static_cast<float>(kMaxBitReliability)));
+}
+
 }  // namespace
 
-// Returns a bit when available
-Maybe<bool> BiphaseDecoder::push(std::complex<float> psk_symbol) {
-  Maybe<bool> result{};
+// Returns a soft bit when available: the sign is the bit value (positive = 1), and the magnitude
+// tells how reliable it is (~1 for a clean signal)
+Maybe<float> BiphaseDecoder::push(std::complex<float> psk_symbol) {
+  Maybe<float> result{};
 
   // A biphase symbol consists of two PSK symbols with opposite phase.
   // (The PSK symbol rate is twice the biphase symbol rate.)
   const auto biphase_symbol = (psk_symbol - prev_psk_symbol_) * 0.5f;
-  result.value              = biphase_symbol.real() >= 0.0f;
+  result.value              = biphase_symbol.real();
   result.has_value          = (clock_ % 2 == clock_polarity_);
   prev_psk_symbol_          = psk_symbol;
 
@@ -86,32 +117,137 @@ Maybe<bool> BiphaseDecoder::push(std::complex<float> psk_symbol) {
   return result;
 }
 
-bool DeltaDecoder::decode(bool input_bit) {
-  const bool output_bit = (input_bit != prev_input_);
-  prev_input_           = input_bit;
-  return output_bit;
+// \param soft_input Sign is the bit value (positive = 1), magnitude its reliability
+SoftBit DeltaDecoder::decode(float soft_input) {
+  const bool input_bit = soft_input >= 0.f;
+
+  // The output depends on two input bits, so it's only as reliable as the weaker of them
+  const SoftBit output{input_bit != prev_input_,
+                       std::min(std::abs(soft_input), prev_input_reliability_)};
+  prev_input_             = input_bit;
+  prev_input_reliability_ = std::abs(soft_input);
+  return output;
+}
+
+// \param bandwidth Loop bandwidth, relative to the sample rate (171 kHz)
+// \param frequency_ratio Subcarrier frequency / 57 kHz
+void CarrierPLL::init(float bandwidth, float frequency_ratio) {
+  alpha_           = bandwidth;
+  beta_            = std::sqrt(bandwidth);
+  frequency_ratio_ = frequency_ratio;
+  reset();
+}
+
+void CarrierPLL::step(float phase_error) {
+  frequency_ += phase_error * alpha_ * frequency_ratio_;
+  phase_ = std::remainder(phase_ + phase_error * beta_ * frequency_ratio_, k2Pi);
+}
+
+// Let the phase run for this many samples (at 171 kHz)
+void CarrierPLL::advance(int num_samples) {
+  phase_ = std::remainder(phase_ + frequency_ * static_cast<float>(num_samples), k2Pi);
+}
+
+void CarrierPLL::reset() {
+  phase_     = 0.f;
+  frequency_ = 0.f;
 }
 
 SubcarrierSet::SubcarrierSet(float samplerate)
-    : resample_ratio_(kTargetSampleRate_Hz / samplerate), resampler_(kResamplerDelay) {
+    : resample_ratio_(kTargetSampleRate_Hz / samplerate) {
   assert(samplerate >= kMinimumSampleRate_Hz && samplerate <= kMaximumSampleRate_Hz);
-  for (auto& demod : datastream_demods_) {
+
+  // Cascade of half-band decimators for high input rates. Each stage keeps everything up to
+  // kHalfbandPassband_Hz free of aliases.
+  float resampler_input_rate = samplerate;
+  while (resampler_input_rate / 2.f >= kTargetSampleRate_Hz) {
+    halfband_stages_.emplace_back();
+    halfband_stages_.back().init(kHalfbandPassband_Hz / resampler_input_rate);
+    resampler_delay_ +=
+        halfband_stages_.back().getGroupDelay() * kTargetSampleRate_Hz / resampler_input_rate;
+    resampler_input_rate /= 2.f;
+  }
+
+  if (resampler_input_rate != kTargetSampleRate_Hz) {
+    const auto rational_ratio = findRationalRatio(resampler_input_rate, kTargetSampleRate_Hz);
+    if (rational_ratio.has_value && resampler_input_rate <= kMaxRationalResamplerRate_Hz) {
+      rational_resampler_.init(rational_ratio.value, resampler_input_rate,
+                               0.5f * std::min(resampler_input_rate, kTargetSampleRate_Hz),
+                               kResamplerTransitionWidth_Hz);
+      use_rational_resampler_ = true;
+      resampler_delay_ += rational_resampler_.getDelay();
+    } else {
+      const float fine_ratio = kTargetSampleRate_Hz / resampler_input_rate;
+      arbitrary_resampler_   = std::make_unique<liquid::Resampler>(kResamplerDelay);
+      arbitrary_resampler_->setRatio(fine_ratio);
+      resampler_delay_ += kResamplerDelay * fine_ratio;
+    }
+  }
+
+  const auto lowpass = getSubcarrierLowpass();
+
+  for (std::size_t n_stream{0}; n_stream < datastream_demods_.size(); n_stream++) {
+    auto& demod = datastream_demods_[n_stream];
     demod.agc.init(kAGCBandwidth_Hz / kTargetSampleRate_Hz, kAGCInitialGain);
-    demod.fir_lpf.init(255, kLowpassCutoff_Hz / kTargetSampleRate_Hz);
+    demod.decimator.init(*lowpass, kDecimateRatio);
+    // Unlike our own filters, each liquid-dsp symsync designs and keeps its own filter bank
     demod.symsync.init(LIQUID_FIRFILT_RRC, kSamplesPerSymbol, kSymsyncDelay, kSymsyncBeta, 32);
     demod.symsync.setBandwidth(kSymsyncBandwidth_Hz / kTargetSampleRate_Hz);
     demod.symsync.setOutputRate(1);
-    demod.oscillator.init(LIQUID_NCO, angularFreq(57000.f, kTargetSampleRate_Hz));
-    demod.oscillator.setPLLBandwidth(kPLLBandwidth_Hz / kTargetSampleRate_Hz);
+    demod.oscillator.init(angularFreq(kSubcarrierFrequencies_Hz[n_stream], kTargetSampleRate_Hz));
+    demod.oscillator_q15.init(
+        angularFreq(kSubcarrierFrequencies_Hz[n_stream], kTargetSampleRate_Hz));
+    demod.decimator_q15.init(*lowpass, kDecimateRatio);
+    demod.pll.init(kPLLBandwidth_Hz / kTargetSampleRate_Hz,
+                   kSubcarrierFrequencies_Hz[n_stream] / kSubcarrierFrequencies_Hz[0]);
+
+    demod.baseband.resize(kBufferSize);
+    demod.baseband_q15.resize(2 * kInputChunkSize);
+    demod.decimated.resize(kBufferSize / kDecimateRatio + 1);
+    demod.symbols.reserve(demod.decimated.size());
+    demod.symbol_positions.reserve(demod.decimated.size());
   }
-  resampler_.setRatio(resample_ratio_);
+}
+
+// \brief Demodulate RDS2 data streams 1..3 on the workers of a pool.
+// \param pool Must outlive this SubcarrierSet. It can be shared with other SubcarrierSets as long
+//             as they aren't demodulated at the same time, since chunkToBits() waits for the
+//             whole pool.
+void SubcarrierSet::enableParallelStreams(ThreadPool& pool) {
+  stream_pool_ = &pool;
+}
+
+// \brief Extract the subcarriers with one FFT per block for all data streams (overlap-save),
+//        instead of mixing and filtering each one separately. Not used for 16-bit input.
+void SubcarrierSet::enableFFTFrontEnd() {
+  std::vector<float> frequencies;
+  for (const float frequency : kSubcarrierFrequencies_Hz)
+    frequencies.push_back(angularFreq(frequency, kTargetSampleRate_Hz));
+  fft_front_end_.init(*getSubcarrierLowpass(), kDecimateRatio, frequencies);
+  use_fft_front_end_ = true;
+}
+
+// \brief Use our own inlined AGC, BPSK phase detector and Gardner symbol timing recovery for all
+//        data streams, instead of liquid-dsp's agc, modem and polyphase symsync.
+void SubcarrierSet::enableNativeDemod() {
+  for (auto& demod : datastream_demods_) {
+    demod.native_agc.init(kAGCBandwidth_Hz / kTargetSampleRate_Hz, kAGCInitialGain);
+    demod.gardner_sync.init(kSymsyncDelay, kSymsyncBeta, kGardnerBandwidth);
+  }
+  use_native_demod_ = true;
 }
 
 void SubcarrierSet::reset() {
   for (auto& demod : datastream_demods_) {
     demod.symsync.reset();
+    if (use_native_demod_)
+      demod.gardner_sync.reset();
     demod.oscillator.reset();
+    demod.oscillator_q15.reset();
+    demod.pll.reset();
   }
+  if (use_fft_front_end_)
+    fft_front_end_.reset();
   sample_num_since_reset_ = 0;
 }
 
@@ -121,29 +257,43 @@ const MPXBuffer& SubcarrierSet::resampleChunk(const MPXBuffer& input_chunk) {
     return input_chunk;
   }
 
-  // ceil(resample_ratio) is enough, as per liquid-dsp's API, but std::ceil is not constexpr in
-  // C++17
-  constexpr std::size_t kMaxResamplerOutputSize = static_cast<std::size_t>(kMaxResampleRatio) + 1;
-  std::array<float, kMaxResamplerOutputSize> resamp_output{};
+  const MPXBuffer* chunk = &input_chunk;
 
-  std::size_t i_resampled{};
-  for (std::size_t i_input{}; i_input < input_chunk.used_size; i_input++) {
-    const auto num_resampled = resampler_.execute(input_chunk.data[i_input], resamp_output);
+  if (!halfband_stages_.empty()) {
+    // The first stage reads from the input chunk, the rest work in place
+    halfband_chunk_.used_size = input_chunk.used_size;
+    const float* stage_input  = input_chunk.data.data();
+    for (auto& stage : halfband_stages_) {
+      halfband_chunk_.used_size =
+          stage.execute(stage_input, halfband_chunk_.used_size, halfband_chunk_.data.data());
+      stage_input = halfband_chunk_.data.data();
+    }
+    chunk = &halfband_chunk_;
+  }
 
-    // Always true as per liquid-dsp API
-    assert(num_resampled <= resamp_output.size());
+  if (use_rational_resampler_) {
+    // Must always be true due to our selection of maximum resampler ratio and extra room in
+    // the chunk
+    assert(rational_resampler_.getMaxOutputSize(chunk->used_size) <=
+           resampled_chunk_.data.size());
 
-    for (std::uint32_t i_buf{}; i_buf < num_resampled; i_buf++) {
-      // Must always be true due to our selection of maximum resampler ratio and extra room in
-      // the chunk
-      assert(i_resampled < resampled_chunk_.data.size());
+    resampled_chunk_.used_size = rational_resampler_.execute(
+        chunk->data.data(), chunk->used_size, resampled_chunk_.data.data());
+    return resampled_chunk_;
+  }
 
-      resampled_chunk_.data[i_resampled] = resamp_output[i_buf];
-      i_resampled++;
-    }
+  if (arbitrary_resampler_ == nullptr) {
+    // The half-band stages brought us to exactly 171 kHz
+    return *chunk;
   }
-  resampled_chunk_.used_size = i_resampled;
-  assert(resampled_chunk_.used_size <= resampled_chunk_.data.size());
+
+  // Must always be true due to our selection of maximum resampler ratio and extra room in the
+  // chunk
+  assert(arbitrary_resampler_->getMaxOutputSize(chunk->used_size) <=
+         resampled_chunk_.data.size());
+
+  resampled_chunk_.used_size = arbitrary_resampler_->execute(chunk->data.data(), chunk->used_size,
+                                                             resampled_chunk_.data.data());
 
   return resampled_chunk_;
 }
@@ -151,92 +301,250 @@ const MPXBuffer& SubcarrierSet::resampleChunk(const MPXBuffer& input_chunk) {
 // \brief Process a chunk of MPX into bits
 // \param input_chunk MPX data (any sample rate)
 // \param num_data_streams Number of RDS data streams to process (1 to 4)
-// \return Raw bits without any block synchronization
-BitBuffer SubcarrierSet::chunkToBits(const MPXBuffer& input_chunk, int num_data_streams) {
+// \param bitbuffer Gets filled with raw bits without any block synchronization
+void SubcarrierSet::chunkToBits(const MPXBuffer& input_chunk, int num_data_streams,
+                                BitBuffer& bitbuffer) {
   assert(num_data_streams >= 1 && num_data_streams <= 4);
   assert(input_chunk.used_size <= input_chunk.data.size());
 
   const MPXBuffer& chunk = resampleChunk(input_chunk);
 
-  BitBuffer bitbuffer;
-  bitbuffer.time_received         = input_chunk.time_received;
+  prepareBitBuffer(input_chunk.time_received, chunk.used_size, num_data_streams, bitbuffer);
+
+  demodulateStreams(chunk, num_data_streams, bitbuffer);
+
+  countSamples(chunk.used_size);
+}
+
+// \brief Process a chunk of 16-bit MPX into bits, using the fixed-point front end
+// \param input_chunk MPX data at 171 kHz
+// \param num_data_streams Number of RDS data streams to process (1 to 4)
+// \param bitbuffer Gets filled with raw bits without any block synchronization
+void SubcarrierSet::chunkToBits(const MPXBufferS16& input_chunk, int num_data_streams,
+                                BitBuffer& bitbuffer) {
+  assert(num_data_streams >= 1 && num_data_streams <= 4);
+  assert(input_chunk.used_size <= input_chunk.data.size());
+  assert(resample_ratio_ == 1.0f);
+
+  prepareBitBuffer(input_chunk.time_received, input_chunk.used_size, num_data_streams,
+                   bitbuffer);
+
+  demodulateStreams(input_chunk, num_data_streams, bitbuffer);
+
+  countSamples(input_chunk.used_size);
+}
+
+// \brief Demodulate a chunk whose subcarriers were already mixed down, filtered, decimated and
+//        gain-controlled into the buffers from getDecimatedBuffer().
+// \param num_samples Size of the chunk at 171 kHz
+// \param first_output_index Index of the first decimated sample in the chunk at 171 kHz
+// \param bitbuffer Gets filled with raw bits without any block synchronization
+void SubcarrierSet::decimatedToBits(
+    std::chrono::time_point<std::chrono::system_clock> time_received, std::size_t num_samples,
+    std::size_t first_output_index, std::size_t num_decimated, int num_data_streams,
+    BitBuffer& bitbuffer) {
+  assert(num_data_streams >= 1 && num_data_streams <= 4);
+  assert(num_decimated <= datastream_demods_[0].decimated.size());
+
+  prepareBitBuffer(time_received, num_samples, num_data_streams, bitbuffer);
+
+  for (int n_stream{0}; n_stream < num_data_streams; n_stream++) {
+    demodulateDecimated(n_stream, first_output_index, num_decimated, true,
+                        bitbuffer.bits[n_stream]);
+  }
+
+  countSamples(num_samples);
+}
+
+// \return Room for the decimated samples of a chunk of up to kBufferSize samples at 171 kHz
+std::complex<float>* SubcarrierSet::getDecimatedBuffer(int n_stream) {
+  return datastream_demods_[n_stream].decimated.data();
+}
+
+// \brief Empty the caller's bit buffer for a new chunk. Its storage is kept.
+// \param num_samples Size of the chunk at 171 kHz
+void SubcarrierSet::prepareBitBuffer(
+    std::chrono::time_point<std::chrono::system_clock> time_received, std::size_t num_samples,
+    int num_data_streams, BitBuffer& bitbuffer) const {
+  bitbuffer.time_received         = time_received;
   bitbuffer.chunk_time_from_start = static_cast<double>(sample_num_) / kTargetSampleRate_Hz;
   bitbuffer.n_streams             = num_data_streams;
 
-  // Pre-allocate the bit buffers
+  // Only allocates the first time, or if the chunks grow
   constexpr float over_reserve = 1.1f;
   const auto expected_num_bits = static_cast<std::size_t>(
-      static_cast<float>(chunk.used_size) * kBitsPerSecond / kTargetSampleRate_Hz * over_reserve);
-  for (int n_stream{0}; n_stream < num_data_streams; n_stream++) {
-    bitbuffer.bits[n_stream].reserve(expected_num_bits);
+      static_cast<float>(num_samples) * kBitsPerSecond / kTargetSampleRate_Hz * over_reserve);
+  for (auto& bits : bitbuffer.bits) {
+    bits.clear();
+    bits.reserve(expected_num_bits);
   }
+}
 
-  // This is for timestamping bits (groups); the whole processing delay at 171 kHz
-  const auto processing_delay_in_samples = std::lround(
-      kResamplerDelay * resample_ratio_ + datastream_demods_[0].fir_lpf.getGroupDelay() +
-      1.5 * kSymsyncDelay * kDecimateRatio);
+// \param num_samples Size of the processed chunk at 171 kHz
+void SubcarrierSet::countSamples(std::size_t num_samples) {
+  // Overflows every 7 hours* which resets the time_from_start to zero.
+  //   *) (2^32) / (171000 Hz) ≈ 6 h 58 min
+  sample_num_ += static_cast<std::uint32_t>(num_samples);
+
+  // Overflows every 7 hours. There's a 5-second interval where we'll have to wait a little longer
+  // for a reset if one is needed at that exact time (unlikely and inconsequential)
+  sample_num_since_reset_ += static_cast<std::uint32_t>(num_samples);
+}
+
+// \brief Demodulate all data streams from a chunk. The streams only share the (read-only) chunk, so
+//        they can run in parallel.
+template <typename Chunk>
+void SubcarrierSet::demodulateStreams(const Chunk& chunk, int num_data_streams,
+                                      BitBuffer& bitbuffer) {
+  // The FFT front end extracts all subcarriers at once; the rest of each chain is per stream
+  bool is_decimated{false};
+  std::size_t first_output_index{};
+  std::size_t num_decimated{};
+  if constexpr (std::is_same_v<Chunk, MPXBuffer>) {
+    if (use_fft_front_end_) {
+      std::array<std::complex<float>*, FFTFrontEnd::kMaxNumBands> outputs{};
+      for (std::size_t n_stream = 0; n_stream < outputs.size(); n_stream++)
+        outputs[n_stream] = datastream_demods_[n_stream].decimated.data();
+
+      first_output_index = fft_front_end_.getNextOutputIndex();
+      num_decimated      = fft_front_end_.execute(chunk.data.data(), chunk.used_size,
+                                                  static_cast<std::size_t>(num_data_streams),
+                                                  outputs.data());
+      assert(num_decimated <= datastream_demods_[0].decimated.size());
+      is_decimated = true;
+    }
+  }
 
-  for (std::size_t i_sample = 0; i_sample < chunk.used_size; i_sample++) {
+  auto demodulate = [&](int n_stream) {
+    if (is_decimated)
+      demodulateDecimated(n_stream, first_output_index, num_decimated, false,
+                          bitbuffer.bits[n_stream]);
+    else
+      demodulateStream(chunk, n_stream, bitbuffer.bits[n_stream]);
+  };
+
+  if (stream_pool_ == nullptr || num_data_streams == 1) {
     for (int n_stream{0}; n_stream < num_data_streams; n_stream++) {
-      // Running at 171 kHz (according to the local clock)
+      demodulate(n_stream);
+    }
+    return;
+  }
 
-      auto& subcarrier_context = datastream_demods_[n_stream];
+  for (int n_stream{1}; n_stream < num_data_streams; n_stream++) {
+    stream_pool_->submit([&demodulate, n_stream] { demodulate(n_stream); });
+  }
+  demodulate(0);
+  stream_pool_->wait();
+}
+
+// \brief Demodulate one data stream from a chunk, one processing stage at a time.
+// \param chunk MPX data at 171 kHz
+// \param bits Demodulated bits are appended here
+void SubcarrierSet::demodulateStream(const MPXBuffer& chunk, int n_stream,
+                                     PackedBits& bits) {
+  auto& demod = datastream_demods_[n_stream];
 
-      // Mix down to baseband
-      const std::complex<float> sample_baseband = subcarrier_context.oscillator.mixDown(
-          std::complex<float>(chunk.data[i_sample]), n_stream);
+  // Mix down to baseband; running at 171 kHz (according to the local clock)
+  demod.oscillator.mixDown(chunk.data.data(), chunk.used_size, demod.baseband.data());
 
-      datastream_demods_[n_stream].fir_lpf.push(sample_baseband);
+  // Low-pass filter; only the samples we keep after decimation get computed
+  const std::size_t first_output_index = demod.decimator.getNextOutputIndex();
+  const std::size_t num_decimated =
+      demod.decimator.execute(demod.baseband.data(), chunk.used_size, demod.decimated.data());
+  assert(num_decimated <= demod.decimated.size());
 
-      if (sample_num_since_reset_ % kDecimateRatio == 0) {
-        // Running at 7.125 kHz (according to the local clock)
+  demodulateDecimated(n_stream, first_output_index, num_decimated, false, bits);
+}
 
-        std::complex<float> sample_lopass = datastream_demods_[n_stream].agc.execute(
-            datastream_demods_[n_stream].fir_lpf.execute());
+// \brief Same as above, but mixing and filtering are done in fixed point.
+// \param chunk 16-bit MPX data at 171 kHz
+void SubcarrierSet::demodulateStream(const MPXBufferS16& chunk, int n_stream,
+                                     PackedBits& bits) {
+  auto& demod = datastream_demods_[n_stream];
 
-        // Synchronize to transmitter's biphase data clock
-        const auto symbol = subcarrier_context.symsync.execute(sample_lopass);
+  demod.oscillator_q15.mixDown(chunk.data.data(), chunk.used_size, demod.baseband_q15.data());
 
-        if (symbol.has_value) {
-          // Running at 2.375 kHz (according to transmitter's clock)
+  // Back to floating point after decimation
+  const std::size_t first_output_index = demod.decimator_q15.getNextOutputIndex();
+  const std::size_t num_decimated = demod.decimator_q15.execute(
+      demod.baseband_q15.data(), chunk.used_size, demod.decimated.data());
+  assert(num_decimated <= demod.decimated.size());
 
-          // The symbol from liquid's modem is ignored; we only need the phase error.
-          static_cast<void>(subcarrier_context.modem.demodulate(symbol.value));
+  demodulateDecimated(n_stream, first_output_index, num_decimated, false, bits);
+}
 
-          const float phase_error = std::clamp(subcarrier_context.modem.getPhaseError(), -kPi, kPi);
-          subcarrier_context.oscillator.stepPLL(phase_error * kPLLMultiplier);
+// \brief The rest of the demodulation chain, starting from the decimated baseband signal.
+// \param first_output_index Index of the first decimated sample in the chunk at 171 kHz
+// \param num_decimated Number of samples in the stream's decimated buffer
+// \param is_gain_controlled The AGC was already applied to the decimated samples
+void SubcarrierSet::demodulateDecimated(int n_stream, std::size_t first_output_index,
+                                        std::size_t num_decimated, bool is_gain_controlled,
+                                        PackedBits& bits) {
+  auto& demod = datastream_demods_[n_stream];
+
+  // Running at 7.125 kHz (according to the local clock)
+
+  // Synchronize to transmitter's biphase data clock. The carrier phase isn't corrected yet, but
+  // that doesn't affect timing recovery.
+  demod.symbols.clear();
+  demod.symbol_positions.clear();
+  if (use_native_demod_) {
+    if (!is_gain_controlled)
+      demod.native_agc.execute(demod.decimated.data(), num_decimated, demod.decimated.data());
+    demod.gardner_sync.execute(demod.decimated.data(), num_decimated, demod.symbols,
+                               demod.symbol_positions);
+  } else {
+    if (!is_gain_controlled)
+      demod.agc.execute(demod.decimated.data(), num_decimated, demod.decimated.data());
+    demod.symsync.execute(demod.decimated.data(), num_decimated, demod.symbols,
+                          demod.symbol_positions);
+  }
 
-          const auto biphase = subcarrier_context.biphase_decoder.push(symbol.value);
+  // Running at 2.375 kHz (according to transmitter's clock)
 
-          // One biphase symbol received for every 2 PSK symbols
-          if (biphase.has_value) {
-            // Running at 1.1875 kHz (according to transmitter's clock)
-            const bool bit = subcarrier_context.delta_decoder.decode(biphase.value);
-            bitbuffer.bits[n_stream].push_back(TimedBit{
-                bit, static_cast<float>(static_cast<int>(i_sample) - processing_delay_in_samples) /
-                         kTargetSampleRate_Hz});
-          }
-        }
-      }  // decimate
-      subcarrier_context.oscillator.step();
-    }  // for n_stream
+  // Carrier recovery; the PLL is kept in step with the decimated samples
+  std::size_t pll_position{0};
+  for (std::size_t i_symbol = 0; i_symbol < demod.symbols.size(); i_symbol++) {
+    demod.pll.advance(static_cast<int>(demod.symbol_positions[i_symbol] - pll_position) *
+                      kDecimateRatio);
+    pll_position = demod.symbol_positions[i_symbol];
 
-    // Overflows every 7 hours* which resets the time_from_start to zero.
-    sample_num_++;
+    demod.symbols[i_symbol] *= demod.pll.getDerotator();
 
-    // Overflows every 7 hours*. Two things will happen:
-    //   1) The symbol synchronizer sees a sudden 75° phase jump**.
-    //   2) There's a 5-second interval where we'll have to wait a little longer for a reset if
-    //      one is needed at that exact time (unlikely and inconsequential)
-    // Is it worth checking 171,000 times per second? We think not.
-    //
-    //   *) (2^32) / (171000 Hz) ≈ 6 h 58 min
-    //  **) ((2^32) % decimate_ratio) / (decimate_ratio * kSamplesPerSymbol) * 360° =
-    //      ((2^32) %        24     ) / (      24       *         3        ) * 360° = 75°
-    sample_num_since_reset_++;
+    float phase_error{};
+    if (use_native_demod_) {
+      phase_error = bpskPhaseError(demod.symbols[i_symbol]);
+    } else {
+      // The symbol from liquid's modem is ignored; we only need the phase error.
+      static_cast<void>(demod.modem.demodulate(demod.symbols[i_symbol]));
+      phase_error = demod.modem.getPhaseError();
+    }
+    demod.pll.step(std::clamp(phase_error, -kPi, kPi) * kPLLMultiplier);
   }
+  demod.pll.advance(static_cast<int>(num_decimated - pll_position) * kDecimateRatio);
+
+  // This is for timestamping bits (groups); the whole processing delay at 171 kHz
+  const float symsync_delay = use_native_demod_ ? demod.gardner_sync.getDelay()
+                                                : 1.5f * static_cast<float>(kSymsyncDelay);
+  const auto processing_delay_in_samples = std::lround(
+      resampler_delay_ + demod.decimator.getGroupDelay() + symsync_delay * kDecimateRatio);
+
+  for (std::size_t i_symbol = 0; i_symbol < demod.symbols.size(); i_symbol++) {
+    const auto biphase = demod.biphase_decoder.push(demod.symbols[i_symbol]);
+
+    // One biphase symbol received for every 2 PSK symbols
+    if (biphase.has_value) {
+      // Running at 1.1875 kHz (according to transmitter's clock)
+      const SoftBit bit = demod.delta_decoder.decode(biphase.value);
+
+      // Position of the symbol in the chunk at 171 kHz
+      const auto i_sample =
+          static_cast<long>(first_output_index + demod.symbol_positions[i_symbol] * kDecimateRatio);
 
-  return bitbuffer;
+      bits.push(bit.value, static_cast<std::int32_t>(i_sample - processing_delay_in_samples),
+                quantizeReliability(bit.reliability));
+    }
+  }
 }
 
 // Seconds of signal processed since last reset.
@@ -245,4 +553,66 @@ float SubcarrierSet::getSecondsSinceLastReset() const {
   return static_cast<float>(sample_num_since_reset_) / kTargetSampleRate_Hz;
 }
 
+// \param subcarriers One per channel, all at the same sample rate. Must outlive this object.
+// \param num_data_streams Number of RDS data streams to process (1 to 4)
+LockstepDemodulator::LockstepDemodulator(
+    const std::vector<std::unique_ptr<SubcarrierSet>>& subcarriers, int num_data_streams)
+    : subcarriers_(subcarriers), num_data_streams_(num_data_streams) {
+  assert(!subcarriers.empty() && num_data_streams >= 1 && num_data_streams <= 4);
+
+  std::vector<float> frequencies;
+  for (std::size_t ch = 0; ch < subcarriers_.size(); ch++) {
+    for (int n_stream{0}; n_stream < num_data_streams_; n_stream++) {
+      frequencies.push_back(angularFreq(kSubcarrierFrequencies_Hz[n_stream], kTargetSampleRate_Hz));
+      lane_outputs_.push_back(subcarriers_[ch]->getDecimatedBuffer(n_stream));
+    }
+  }
+  lane_inputs_.resize(frequencies.size());
+
+  front_end_.init(*getSubcarrierLowpass(), kDecimateRatio, frequencies,
+                  kAGCBandwidth_Hz / kTargetSampleRate_Hz, kAGCInitialGain);
+}
+
+// \brief Process one chunk of every channel into bits
+// \param input_chunks MPX data of each channel, all of the same size
+// \param bitbuffers One per channel; get filled with raw bits without any block synchronization
+void LockstepDemodulator::chunksToBits(const std::vector<const MPXBuffer*>& input_chunks,
+                                       std::vector<BitBuffer>& bitbuffers) {
+  assert(input_chunks.size() == subcarriers_.size() && bitbuffers.size() == subcarriers_.size());
+
+  std::size_t num_samples{};
+  for (std::size_t ch = 0; ch < subcarriers_.size(); ch++) {
+    const MPXBuffer& chunk = subcarriers_[ch]->resampleChunk(*input_chunks[ch]);
+    // The resamplers all have the same state, so they give the same number of samples
+    assert(ch == 0 || chunk.used_size == num_samples);
+    num_samples = chunk.used_size;
+
+    for (int n_stream{0}; n_stream < num_data_streams_; n_stream++)
+      lane_inputs_[getLane(ch, n_stream)] = chunk.data.data();
+  }
+
+  const std::size_t first_output_index = front_end_.getNextOutputIndex();
+  const std::size_t num_decimated =
+      front_end_.execute(lane_inputs_.data(), num_samples, lane_outputs_.data());
+
+  for (std::size_t ch = 0; ch < subcarriers_.size(); ch++) {
+    subcarriers_[ch]->decimatedToBits(input_chunks[ch]->time_received, num_samples,
+                                      first_output_index, num_decimated, num_data_streams_,
+                                      bitbuffers[ch]);
+  }
+}
+
+// Lanes are ordered by channel, then by data stream
+std::size_t LockstepDemodulator::getLane(std::size_t channel, int n_stream) const {
+  return channel * static_cast<std::size_t>(num_data_streams_) +
+         static_cast<std::size_t>(n_stream);
+}
+
+// \brief Reset the demodulator of one channel, e.g. after losing the carrier
+void LockstepDemodulator::reset(std::size_t channel) {
+  subcarriers_[channel]->reset();
+  for (int n_stream{0}; n_stream < num_data_streams_; n_stream++)
+    front_end_.resetOscillator(getLane(channel, n_stream));
+}
+
 }  // namespace redsea
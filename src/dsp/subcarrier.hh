@@ -18,21 +18,34 @@
 #define DSP_SUBCARRIER_H_
 
 #include <array>
+#include <chrono>
 #include <complex>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #include "src/constants.hh"
+#include "src/dsp/decimator.hh"
+#include "src/dsp/fft_frontend.hh"
+#include "src/dsp/fixed_point.hh"
+#include "src/dsp/halfband.hh"
 #include "src/dsp/liquid_wrappers.hh"
+#include "src/dsp/lockstep.hh"
+#include "src/dsp/native_demod.hh"
+#include "src/dsp/oscillator.hh"
+#include "src/dsp/resampler.hh"
 #include "src/io/bitbuffer.hh"
 #include "src/io/input.hh"
 #include "src/util/maybe.hh"
+#include "src/util/thread_pool.hh"
 
 namespace redsea {
 
 class BiphaseDecoder {
  public:
   BiphaseDecoder() = default;
-  Maybe<bool> push(std::complex<float> psk_symbol);
+  Maybe<float> push(std::complex<float> psk_symbol);
 
  private:
   std::complex<float> prev_psk_symbol_{0.0f, 0.0f};
@@ -44,53 +57,168 @@ class BiphaseDecoder {
   std::uint32_t clock_polarity_{};
 };
 
+// Hard bit decision plus how far the symbol was from the decision boundary
+struct SoftBit {
+  bool value{};
+  float reliability{};
+};
+
 class DeltaDecoder {
  public:
   DeltaDecoder() = default;
-  bool decode(bool input_bit);
+  SoftBit decode(float soft_input);
 
  private:
   bool prev_input_{};
+  float prev_input_reliability_{};
 };
 
+// \brief Phase-locked loop for the residual carrier phase of one subcarrier.
+//
+// The subcarrier is mixed down with a free-running oscillator, so that whole chunks can be mixed
+// and filtered at once. This loop tracks the phase correction on top of that and is only stepped
+// at the decimated rate. The loop filter is the same as in liquid-dsp's nco_crcf PLL.
+class CarrierPLL {
+ public:
+  CarrierPLL() = default;
+  void init(float bandwidth, float frequency_ratio);
+  void step(float phase_error);
+  void advance(int num_samples);
+  void reset();
+  [[nodiscard]] std::complex<float> getDerotator() const {
+    return std::polar(1.f, -phase_);
+  }
+
+ private:
+  float alpha_{};
+  float beta_{};
+  // The loop is tuned for 57 kHz; corrections are scaled by f / 57 kHz for the other subcarriers
+  float frequency_ratio_{1.f};
+  // Radians
+  float phase_{};
+  // Radians per sample (at 171 kHz)
+  float frequency_{};
+};
+
+// The subcarriers are decimated to this many samples per PSK symbol
+constexpr int kSamplesPerSymbol = 3;
+// Decimation ratio from 171 kHz to kSamplesPerSymbol samples per PSK symbol
+constexpr int kDecimateRatio =
+    static_cast<int>(kTargetSampleRate_Hz / kBitsPerSecond / 2 / kSamplesPerSymbol);
+
 // \brief Demodulation context for one subcarrier
 struct Demod {
   liquid::AGC agc;
-  liquid::FIRFilter fir_lpf;
+  FIRDecimator decimator;
+  CarrierPLL pll;
   liquid::SymSync symsync;
   DeltaDecoder delta_decoder;
   BiphaseDecoder biphase_decoder;
-  liquid::NCO oscillator;
+  Oscillator oscillator;
   liquid::Modem modem{LIQUID_MODEM_PSK2};
+  // Used instead of agc, symsync and modem if enabled
+  NativeAGC native_agc;
+  GardnerSync<kSamplesPerSymbol> gardner_sync;
+  // Integer front end, used instead of oscillator and decimator for 16-bit input
+  OscillatorQ15 oscillator_q15;
+  FIRDecimatorQ15 decimator_q15;
+
+  // Work buffers, reused for every chunk. Each data stream has its own, so that the streams can
+  // be demodulated in parallel.
+  std::vector<std::complex<float>> baseband;
+  // I/Q interleaved
+  std::vector<std::int16_t> baseband_q15;
+  std::vector<std::complex<float>> decimated;
+  std::vector<std::complex<float>> symbols;
+  // Index of each symbol in decimated
+  std::vector<std::size_t> symbol_positions;
 };
 
 // A set of 1 (RDS1) to 4 (RDS2) subcarriers
 class SubcarrierSet {
  public:
   explicit SubcarrierSet(float samplerate);
-  BitBuffer chunkToBits(const MPXBuffer& input_chunk, int num_data_streams);
+  void chunkToBits(const MPXBuffer& input_chunk, int num_data_streams, BitBuffer& bits);
+  void chunkToBits(const MPXBufferS16& input_chunk, int num_data_streams, BitBuffer& bits);
   void reset();
+  void enableParallelStreams(ThreadPool& pool);
+  void enableFFTFrontEnd();
+  void enableNativeDemod();
 
   [[nodiscard]] float getSecondsSinceLastReset() const;
 
- private:
+  // For LockstepDemodulator, which mixes, filters and gain-controls the subcarriers itself
   const MPXBuffer& resampleChunk(const MPXBuffer& input_chunk);
+  [[nodiscard]] std::complex<float>* getDecimatedBuffer(int n_stream);
+  void decimatedToBits(std::chrono::time_point<std::chrono::system_clock> time_received,
+                       std::size_t num_samples, std::size_t first_output_index,
+                       std::size_t num_decimated, int num_data_streams, BitBuffer& bitbuffer);
 
-  static constexpr int kSamplesPerSymbol = 3;
-  static constexpr int kDecimateRatio =
-      static_cast<int>(kTargetSampleRate_Hz / kBitsPerSecond / 2 / kSamplesPerSymbol);
+ private:
+  void prepareBitBuffer(std::chrono::time_point<std::chrono::system_clock> time_received,
+                        std::size_t num_samples, int num_data_streams,
+                        BitBuffer& bitbuffer) const;
+  void countSamples(std::size_t num_samples);
+  template <typename Chunk>
+  void demodulateStreams(const Chunk& chunk, int num_data_streams, BitBuffer& bitbuffer);
+  void demodulateStream(const MPXBuffer& chunk, int n_stream, PackedBits& bits);
+  void demodulateStream(const MPXBufferS16& chunk, int n_stream, PackedBits& bits);
+  void demodulateDecimated(int n_stream, std::size_t first_output_index,
+                           std::size_t num_decimated, bool is_gain_controlled, PackedBits& bits);
 
   // Samples since the beginning (at 171 kHz)
   std::uint32_t sample_num_{0};
   // Samples since the last reset (at 171 kHz)
   std::uint32_t sample_num_since_reset_{0};
   const float resample_ratio_;
+  // Delay through the resampler, in samples at 171 kHz
+  float resampler_delay_{};
 
-  liquid::Resampler resampler_;
+  // High input rates are first halved until they are below 2 * 171 kHz
+  std::vector<HalfbandDecimator> halfband_stages_;
+  // Exact polyphase resampler, for integer sample rates with a simple ratio to 171 kHz
+  RationalResampler rational_resampler_;
+  bool use_rational_resampler_{false};
+  // liquid's arbitrary-ratio resampler, for the rest
+  std::unique_ptr<liquid::Resampler> arbitrary_resampler_;
 
   std::array<Demod, 4> datastream_demods_;
+  // Extracts all subcarriers at once, instead of each Demod's oscillator and decimator
+  FFTFrontEnd fft_front_end_;
+  bool use_fft_front_end_{false};
+  // Our own AGC, phase detector and symbol timing recovery instead of liquid-dsp's
+  bool use_native_demod_{false};
 
+  MPXBuffer halfband_chunk_{};
   MPXBuffer resampled_chunk_{};
+
+  // Runs data streams 1..3 while the calling thread does stream 0; null if not enabled.
+  // Not owned: one pool is shared by all channels, which are demodulated one at a time.
+  ThreadPool* stream_pool_{nullptr};
+};
+
+// \brief Demodulates the same data streams from many channels at the same sample rate, with the
+//        channels' subcarriers side by side in the SIMD lanes of a LockstepFrontEnd.
+//
+// Each channel's SubcarrierSet still resamples its signal and runs the rest of the chain from
+// the decimated rate on, where the work per channel is small.
+class LockstepDemodulator {
+ public:
+  LockstepDemodulator(const std::vector<std::unique_ptr<SubcarrierSet>>& subcarriers,
+                      int num_data_streams);
+  void chunksToBits(const std::vector<const MPXBuffer*>& input_chunks,
+                    std::vector<BitBuffer>& bitbuffers);
+  void reset(std::size_t channel);
+
+ private:
+  [[nodiscard]] std::size_t getLane(std::size_t channel, int n_stream) const;
+
+  const std::vector<std::unique_ptr<SubcarrierSet>>& subcarriers_;
+  const int num_data_streams_;
+  LockstepFrontEnd front_end_;
+  // One per lane, i.e. per data stream of each channel
+  std::vector<const float*> lane_inputs_;
+  std::vector<std::complex<float>*> lane_outputs_;
 };
 
 }  // namespace redsea
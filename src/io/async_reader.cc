@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/io/async_reader.hh"
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace redsea {
+
+#ifdef HAVE_LIBURING
+
+struct AsyncReader::Ring {
+  io_uring ring{};
+};
+
+namespace {
+
+// Tells the completions of cancel requests apart from reads, which carry their buffer index
+constexpr std::uint64_t kCancelUserData = ~std::uint64_t{0};
+
+}  // namespace
+
+// Built in, and allowed by the kernel: io_uring may be turned off at run time, e.g. by the
+// kernel.io_uring_disabled sysctl or by seccomp in a container
+bool AsyncReader::isAvailable() {
+  static const bool is_available = [] {
+    io_uring ring{};
+    if (::io_uring_queue_init(1, &ring, 0) < 0)
+      return false;
+    ::io_uring_queue_exit(&ring);
+    return true;
+  }();
+  return is_available;
+}
+
+AsyncReader::AsyncReader(int fd, std::size_t buffer_size, std::size_t num_buffers)
+    : fd_(fd), buffers_(num_buffers), ring_(std::make_unique<Ring>()) {
+  assert(num_buffers > 0 && buffer_size > 0);
+
+  struct stat file_status {};
+  is_seekable_ = ::fstat(fd, &file_status) == 0 && S_ISREG(file_status.st_mode);
+  if (is_seekable_) {
+    // Stdin may have been redirected from a file that was already partly read
+    const off_t position = ::lseek(fd, 0, SEEK_CUR);
+    next_file_offset_    = position > 0 ? static_cast<std::uint64_t>(position) : 0;
+  }
+
+  const int error =
+      ::io_uring_queue_init(static_cast<unsigned>(num_buffers), &ring_->ring, 0);
+  if (error < 0)
+    throw std::runtime_error(std::string("can't set up io_uring: ") + std::strerror(-error));
+
+  std::vector<iovec> iovecs(num_buffers);
+  for (std::size_t i = 0; i < num_buffers; i++) {
+    buffers_[i].data.resize(buffer_size);
+    iovecs[i].iov_base = buffers_[i].data.data();
+    iovecs[i].iov_len  = buffer_size;
+  }
+
+  // Registered buffers save the kernel from mapping the pages in for every read. It's only an
+  // optimization, so carry on without if the memlock limit doesn't allow it.
+  is_registered_ = ::io_uring_register_buffers(&ring_->ring, iovecs.data(),
+                                               static_cast<unsigned>(num_buffers)) == 0;
+
+  // A pipe only gets one read at a time
+  for (std::size_t i = 0; i < (is_seekable_ ? num_buffers : 1); i++) submit(i);
+  ::io_uring_submit(&ring_->ring);
+}
+
+AsyncReader::~AsyncReader() {
+  // A read from a pipe whose writer stays open might never complete, e.g. when we're leaving
+  // early because of an error. Ask the kernel to cancel the reads still in flight.
+  std::size_t num_cancels{};
+  for (const std::size_t i_buffer : queue_) {
+    if (buffers_[i_buffer].is_complete)
+      continue;
+    io_uring_sqe* sqe = ::io_uring_get_sqe(&ring_->ring);
+    if (sqe == nullptr)
+      break;
+    ::io_uring_prep_cancel64(sqe, i_buffer, 0);
+    ::io_uring_sqe_set_data64(sqe, kCancelUserData);
+    num_cancels++;
+  }
+  if (num_cancels > 0)
+    ::io_uring_submit(&ring_->ring);
+
+  // The kernel may still be writing into our buffers until the reads (cancelled or not) complete
+  while (num_in_flight_ + num_cancels > 0) {
+    io_uring_cqe* cqe{};
+    if (::io_uring_wait_cqe(&ring_->ring, &cqe) < 0)
+      break;
+    if (::io_uring_cqe_get_data64(cqe) == kCancelUserData)
+      num_cancels--;
+    else
+      num_in_flight_--;
+    ::io_uring_cqe_seen(&ring_->ring, cqe);
+  }
+  ::io_uring_queue_exit(&ring_->ring);
+}
+
+// Queue a read into this buffer; io_uring_submit() sends it to the kernel
+void AsyncReader::submit(std::size_t i_buffer) {
+  Buffer& buffer      = buffers_[i_buffer];
+  buffer.result       = 0;
+  buffer.num_consumed = 0;
+  buffer.is_complete  = false;
+  buffer.file_offset  = next_file_offset_;
+
+  io_uring_sqe* sqe = ::io_uring_get_sqe(&ring_->ring);
+  assert(sqe != nullptr);
+
+  // Pipes have no offset: -1 means the current position
+  const std::uint64_t offset = is_seekable_ ? buffer.file_offset : static_cast<std::uint64_t>(-1);
+  const auto size            = static_cast<unsigned>(buffer.data.size());
+  if (is_registered_)
+    ::io_uring_prep_read_fixed(sqe, fd_, buffer.data.data(), size, offset,
+                               static_cast<int>(i_buffer));
+  else
+    ::io_uring_prep_read(sqe, fd_, buffer.data.data(), size, offset);
+  ::io_uring_sqe_set_data64(sqe, i_buffer);
+
+  if (is_seekable_)
+    next_file_offset_ += buffer.data.size();
+  queue_.push_back(i_buffer);
+  num_in_flight_++;
+}
+
+// Block until any read completes
+void AsyncReader::waitForCompletion() {
+  io_uring_cqe* cqe{};
+  const int error = ::io_uring_wait_cqe(&ring_->ring, &cqe);
+  if (error < 0)
+    throw std::runtime_error(std::string("io_uring: ") + std::strerror(-error));
+
+  Buffer& buffer     = buffers_[::io_uring_cqe_get_data64(cqe)];
+  buffer.result      = cqe->res;
+  buffer.is_complete = true;
+  num_in_flight_--;
+  ::io_uring_cqe_seen(&ring_->ring, cqe);
+}
+
+// A file read may come back short without being at the end of the file (e.g. interrupted).
+// Later buffers were already asked for the data after this one, so fill in the gap right away.
+void AsyncReader::completeShortRead(Buffer& buffer) {
+  auto length = static_cast<std::size_t>(buffer.result);
+  while (length < buffer.data.size()) {
+    const ssize_t num_read = ::pread(fd_, buffer.data.data() + length, buffer.data.size() - length,
+                                     static_cast<off_t>(buffer.file_offset + length));
+    if (num_read <= 0)
+      break;
+    length += static_cast<std::size_t>(num_read);
+  }
+  buffer.result = static_cast<std::int64_t>(length);
+}
+
+// @brief Read size bytes, or fewer at the end of the input.
+// @throws std::runtime_error for read errors
+std::size_t AsyncReader::read(std::uint8_t* destination, std::size_t size) {
+  std::size_t num_copied{};
+
+  while (num_copied < size && !queue_.empty()) {
+    const std::size_t i_buffer = queue_.front();
+    Buffer& buffer             = buffers_[i_buffer];
+
+    while (!buffer.is_complete) waitForCompletion();
+
+    if (buffer.result < 0)
+      throw std::runtime_error(std::string("read error: ") +
+                               std::strerror(static_cast<int>(-buffer.result)));
+
+    if (is_seekable_ && buffer.num_consumed == 0 && buffer.result > 0 &&
+        static_cast<std::size_t>(buffer.result) < buffer.data.size())
+      completeShortRead(buffer);
+
+    const auto length = static_cast<std::size_t>(buffer.result);
+    // A read of 0 bytes is the end of the input; a short one is for files
+    if (length == 0 || (is_seekable_ && length < buffer.data.size()))
+      is_end_seen_ = true;
+
+    const std::size_t to_copy = std::min(size - num_copied, length - buffer.num_consumed);
+    std::copy_n(buffer.data.cbegin() + static_cast<std::ptrdiff_t>(buffer.num_consumed), to_copy,
+                destination + num_copied);
+    buffer.num_consumed += to_copy;
+    num_copied += to_copy;
+
+    if (buffer.num_consumed == length) {
+      queue_.pop_front();
+      if (!is_end_seen_) {
+        submit(i_buffer);
+        ::io_uring_submit(&ring_->ring);
+      }
+    }
+  }
+
+  if (queue_.empty())
+    is_eof_ = true;
+
+  return num_copied;
+}
+
+#else
+
+struct AsyncReader::Ring {};
+
+bool AsyncReader::isAvailable() {
+  return false;
+}
+
+AsyncReader::AsyncReader(int /*fd*/, std::size_t /*buffer_size*/, std::size_t /*num_buffers*/) {
+  throw std::runtime_error("redsea was built without io_uring support");
+}
+
+AsyncReader::~AsyncReader() = default;
+
+std::size_t AsyncReader::read(std::uint8_t* /*destination*/, std::size_t /*size*/) {
+  return 0;
+}
+
+#endif
+
+bool AsyncReader::eof() const {
+  return is_eof_;
+}
+
+}  // namespace redsea
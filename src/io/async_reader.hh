@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef IO_ASYNC_READER_H_
+#define IO_ASYNC_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace redsea {
+
+// \brief Reads a file descriptor ahead of the caller using io_uring (Linux, with liburing).
+//
+// A fixed pool of buffers is registered with the kernel. For regular files, every free buffer
+// has a read in flight at its own offset; for pipes, one read at a time, since the order of
+// concurrent reads from a stream isn't defined. Either way the next chunk is being read while
+// the caller is busy processing the previous one.
+class AsyncReader {
+ public:
+  // @throws std::runtime_error if io_uring can't be set up (or redsea was built without it)
+  AsyncReader(int fd, std::size_t buffer_size, std::size_t num_buffers);
+  AsyncReader(const AsyncReader&)            = delete;
+  AsyncReader& operator=(const AsyncReader&) = delete;
+  AsyncReader(AsyncReader&&)                 = delete;
+  AsyncReader& operator=(AsyncReader&&)      = delete;
+  ~AsyncReader();
+
+  std::size_t read(std::uint8_t* destination, std::size_t size);
+  [[nodiscard]] bool eof() const;
+
+  // Whether io_uring can be used at all; probes the kernel the first time
+  static bool isAvailable();
+
+ private:
+  struct Buffer {
+    std::vector<std::uint8_t> data;
+    // Offset in the file, for regular files
+    std::uint64_t file_offset{};
+    // Bytes read; negative values are errors
+    std::int64_t result{};
+    std::size_t num_consumed{};
+    bool is_complete{};
+  };
+  struct Ring;
+
+  void submit(std::size_t i_buffer);
+  void waitForCompletion();
+  void completeShortRead(Buffer& buffer);
+
+  int fd_{-1};
+  bool is_seekable_{};
+  bool is_registered_{};
+  bool is_eof_{};
+  // No more reads are submitted after this
+  bool is_end_seen_{};
+  std::uint64_t next_file_offset_{};
+  std::size_t num_in_flight_{};
+  std::vector<Buffer> buffers_;
+  // Buffers with a read submitted or completed, in file order
+  std::deque<std::size_t> queue_;
+  std::unique_ptr<Ring> ring_;
+};
+
+}  // namespace redsea
+
+#endif  // IO_ASYNC_READER_H_
@@ -1,20 +1,108 @@
 #ifndef BITBUFFER_H
 #define BITBUFFER_H
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <vector>
 
+#include "src/constants.hh"
+
 namespace redsea {
 
-struct TimedBit {
-  // 1 / 0
-  bool value;
-  // Time offset of the bit, in seconds from the start of the input chunk
-  float time_from_chunk_start;
+// Nominal distance between two bits, in samples at 171 kHz
+constexpr int kSamplesPerBit = static_cast<int>(kTargetSampleRate_Hz / kBitsPerSecond);
+static_assert(kSamplesPerBit * kBitsPerSecond == kTargetSampleRate_Hz);
+
+// Reliability of a bit that is known to be correct, e.g. when reading hex or ASCII bits
+constexpr std::uint8_t kMaxBitReliability = 255;
+
+// \brief Demodulated bits of one data stream in one chunk, packed into 64-bit words.
+//
+// The bits are almost always exactly kSamplesPerBit apart. Instead of storing a time for every
+// bit, we only store the sample position of those bits that are not; the rest are counted from
+// the previous such anchor. Each bit also has a reliability (0 = coin toss, 255 = certain) for the
+// soft-decision error correction. The storage is kept between chunks, so clear() + push() don't
+// allocate once the buffers have grown to the size of a chunk.
+class PackedBits {
+ public:
+  PackedBits() = default;
+
+  void clear() {
+    words_.clear();
+    anchors_.clear();
+    reliabilities_.clear();
+    size_ = 0;
+  }
+  void reserve(std::size_t num_bits) {
+    words_.reserve((num_bits + 63) / 64);
+    reliabilities_.reserve(num_bits);
+  }
+
+  // \param sample_position Position of the bit, in samples at 171 kHz from the chunk start
+  void push(bool bit, std::int32_t sample_position,
+            std::uint8_t reliability = kMaxBitReliability) {
+    if (size_ % 64 == 0)
+      words_.push_back(0);
+    if (bit)
+      words_.back() |= std::uint64_t{1} << (size_ % 64);
+
+    if (size_ == 0 || sample_position != last_sample_position_ + kSamplesPerBit)
+      anchors_.push_back(Anchor{size_, sample_position});
+    last_sample_position_ = sample_position;
+    reliabilities_.push_back(reliability);
+
+    size_++;
+  }
+
+  [[nodiscard]] std::size_t size() const {
+    return size_;
+  }
+  [[nodiscard]] bool empty() const {
+    return size_ == 0;
+  }
+  [[nodiscard]] bool get(std::size_t i_bit) const {
+    assert(i_bit < size_);
+    return ((words_[i_bit / 64] >> (i_bit % 64)) & 1U) != 0;
+  }
+  [[nodiscard]] std::uint8_t getReliability(std::size_t i_bit) const {
+    assert(i_bit < size_);
+    return reliabilities_[i_bit];
+  }
+
+  // \return Position of the bit, in samples at 171 kHz from the chunk start
+  [[nodiscard]] std::int32_t getSamplePosition(std::size_t i_bit) const {
+    assert(i_bit < size_);
+    // Last anchor at or before the bit
+    const auto anchor = std::prev(
+        std::upper_bound(anchors_.cbegin(), anchors_.cend(), i_bit,
+                         [](std::size_t i, const Anchor& a) { return i < a.i_bit; }));
+    return anchor->sample_position +
+           static_cast<std::int32_t>(i_bit - anchor->i_bit) * kSamplesPerBit;
+  }
+  // \return Time offset of the bit, in seconds from the start of the input chunk
+  [[nodiscard]] float getTimeFromChunkStart(std::size_t i_bit) const {
+    return static_cast<float>(getSamplePosition(i_bit)) / kTargetSampleRate_Hz;
+  }
+
+ private:
+  struct Anchor {
+    std::size_t i_bit;
+    std::int32_t sample_position;
+  };
+
+  std::vector<std::uint64_t> words_;
+  std::vector<Anchor> anchors_;
+  std::vector<std::uint8_t> reliabilities_;
+  std::size_t size_{};
+  std::int32_t last_sample_position_{};
 };
 
-// Bits as demodulated from MPX
+// Bits as demodulated from MPX. Owned by the caller and refilled for every chunk.
 struct BitBuffer {
   // Timestamp for when the *last* bit of the group was received, in system time
   std::chrono::time_point<std::chrono::system_clock> time_received;
@@ -22,8 +110,8 @@ struct BitBuffer {
   double chunk_time_from_start{};
   // Number of data-streams (1 to 4)
   int n_streams{1};
-  // One vector for each data-stream
-  std::array<std::vector<TimedBit>, 4> bits;
+  // One for each data-stream
+  std::array<PackedBits, 4> bits;
 };
 
 }  // namespace redsea
@@ -16,65 +16,219 @@
  */
 #include "src/io/input.hh"
 
+#include <fcntl.h>
 // For fileno
 #include <stdio.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cerrno>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <sndfile.h>
 
 #include "src/constants.hh"
 #include "src/group.hh"
+#include "src/io/async_reader.hh"
+#include "src/io/mapped_file.hh"
+#include "src/io/raw_stream.hh"
 #include "src/options.hh"
 
 namespace redsea {
 
+namespace {
+
+// Frames are transposed this many at a time through a small local block, which stays in
+// registers or L1 while all the channels are written out
+constexpr std::size_t kDeinterleaveBlockSize = 16;
+
+// With the number of channels known at compile time, the compiler turns the transposition into
+// vector shuffles. NumChannels == 0 means it's only known at runtime.
+// \param load Returns the interleaved sample at the given index, already converted
+template <std::uint32_t NumChannels, typename Buffer, typename LoadSample>
+void deinterleaveBlocked(const LoadSample& load, std::size_t num_samples,
+                         std::uint32_t num_channels, std::vector<Buffer>& channels) {
+  if constexpr (NumChannels != 0)
+    num_channels = NumChannels;
+
+  using Sample                 = typename decltype(Buffer::data)::value_type;
+  const std::size_t num_frames = num_samples / num_channels;
+
+  std::size_t i_frame = 0;
+  for (; i_frame + kDeinterleaveBlockSize <= num_frames; i_frame += kDeinterleaveBlockSize) {
+    std::array<std::array<Sample, kDeinterleaveBlockSize>, kMaxNumChannels> block;
+    for (std::size_t i = 0; i < kDeinterleaveBlockSize; i++)
+      for (std::uint32_t ch = 0; ch < num_channels; ch++)
+        block[ch][i] = load((i_frame + i) * num_channels + ch);
+
+    for (std::uint32_t ch = 0; ch < num_channels; ch++)
+      std::copy(block[ch].cbegin(), block[ch].cend(), channels[ch].data.begin() + i_frame);
+  }
+
+  for (; i_frame < num_frames; i_frame++)
+    for (std::uint32_t ch = 0; ch < num_channels; ch++)
+      channels[ch].data[i_frame] = load(i_frame * num_channels + ch);
+
+  for (std::uint32_t ch = 0; ch < num_channels; ch++) channels[ch].used_size = num_frames;
+}
+
+template <typename Buffer, typename LoadSample>
+void deinterleaveAny(const LoadSample& load, std::size_t num_samples, std::uint32_t num_channels,
+                     std::vector<Buffer>& channels) {
+  assert(num_channels <= kMaxNumChannels && channels.size() >= num_channels);
+
+  switch (num_channels) {
+    case 2:  deinterleaveBlocked<2>(load, num_samples, num_channels, channels); break;
+    case 4:  deinterleaveBlocked<4>(load, num_samples, num_channels, channels); break;
+    case 8:  deinterleaveBlocked<8>(load, num_samples, num_channels, channels); break;
+    default: deinterleaveBlocked<0>(load, num_samples, num_channels, channels); break;
+  }
+}
+
+template <typename Buffer>
+void deinterleaveBuffer(const Buffer& interleaved, std::uint32_t num_channels,
+                        std::vector<Buffer>& channels) {
+  deinterleaveAny([&interleaved](std::size_t i) { return interleaved.data[i]; },
+                  interleaved.used_size, num_channels, channels);
+  for (std::uint32_t ch = 0; ch < num_channels; ch++)
+    channels[ch].time_received = interleaved.time_received;
+}
+
+// Convert samples from the mapped file and split them into channels, in one pass
+template <typename Buffer, typename LoadSample>
+void loadChannels(const LoadSample& load, std::size_t num_samples, std::uint32_t num_channels,
+                  Buffer& single_channel, std::vector<Buffer>& channels) {
+  if (num_channels == 1) {
+    for (std::size_t i = 0; i < num_samples; i++) single_channel.data[i] = load(i);
+    single_channel.used_size = num_samples;
+  } else {
+    deinterleaveAny(load, num_samples, num_channels, channels);
+  }
+}
+
+}  // namespace
+
+// @brief Split an interleaved chunk into all of its channels in a single pass.
+// @param channels At least num_channels buffers
+void deinterleave(const MPXBuffer& interleaved, std::uint32_t num_channels,
+                  std::vector<MPXBuffer>& channels) {
+  deinterleaveBuffer(interleaved, num_channels, channels);
+}
+
+void deinterleave(const MPXBufferS16& interleaved, std::uint32_t num_channels,
+                  std::vector<MPXBufferS16>& channels) {
+  deinterleaveBuffer(interleaved, num_channels, channels);
+}
+
 /**
  * An MPXReader deals with reading an FM multiplex signal from an audio file or
  * raw PCM via stdin, separating it into channels and converting to chunks of
- * floating-point samples.
+ * floating-point samples. Uncompressed WAV files and raw PCM files are mapped
+ * into memory and read directly, and raw PCM from stdin (or from a file that
+ * can't be mapped, like a named pipe) is read as bytes; everything else goes
+ * through libsndfile.
  * @throws BeyondEofError if there is nothing to read
  * @throws std::runtime_error for sndfile errors
  */
 void MPXReader::init(const Options& options) {
   num_channels_ = options.num_channels;
   feed_thru_    = options.feed_thru;
+  read_s16_     = options.fixed_point;
   filename_     = options.sndfilename;
   is_beginning_ = true;
 
   switch (options.input_type) {
     case InputType::MPX_raw_stdin: {
-      source_is_raw_pcm_ = true;
+      raw_format_ = options.input_format;
+
+      // IQ is demodulated into MPX, possibly at a lower rate
+      float mpx_samplerate = options.samplerate;
+      is_channelized_      = options.channelize;
+      if (is_channelized_) {
+        fm_channelizer_.init(options.samplerate);
+        iq_samples_.resize(kInputChunkSize);
+        num_channels_  = fm_channelizer_.getNumChannels();
+        mpx_samplerate = fm_channelizer_.getOutputSamplerate();
+      } else if (isComplex(raw_format_)) {
+        fm_discriminator_.init(options.samplerate);
+        iq_buffers_.resize(2);
+        mpx_samplerate = fm_discriminator_.getOutputSamplerate();
+      }
+
+      // Raw PCM from a file (--input mpx --file)
+      if (!filename_.empty()) {
+        if (mapped_file_.open(filename_)) {
+          mapped_layout_.format       = raw_format_;
+          mapped_layout_.num_channels = is_channelized_ ? 1 : num_channels_;
+          mapped_layout_.samplerate   = options.samplerate;
+          mapped_layout_.data_offset  = 0;
+          mapped_layout_.data_size    = mapped_file_.size();
+          sfinfo_.samplerate          = static_cast<int>(std::lround(mpx_samplerate));
+          sfinfo_.channels            = 1;
+          break;
+        }
+
+        // Named pipes, devices, empty files... are read like stdin
+        raw_file_fd_ = ::open(filename_.c_str(), O_RDONLY);
+        if (raw_file_fd_ < 0)
+          throw std::runtime_error("can't open " + filename_ + ": " + std::strerror(errno));
+      }
+      const int raw_fd = raw_file_fd_ >= 0 ? raw_file_fd_ : ::fileno(stdin);
+
+      if (options.io_uring && AsyncReader::isAvailable()) {
+        try {
+          async_reader_ = std::make_unique<AsyncReader>(
+              raw_fd, kInputChunkSize * getBytesPerSample(raw_format_), kNumAsyncReadBuffers);
+        } catch (const std::runtime_error& e) {
+          // Plain reads give the same result, just without reading ahead
+          std::cerr << "redsea: warning: " << e.what() << "; reading without io_uring"
+                    << std::endl;
+        }
+      }
+      if (async_reader_ == nullptr) {
+        // Feed-through passes the input bytes through as they are
+        raw_stream_reader_ =
+            std::make_unique<RawStreamReader>(raw_fd, feed_thru_ ? ::fileno(stdout) : -1);
+      }
+      raw_bytes_.resize(kInputChunkSize * getBytesPerSample(raw_format_));
 
       // We will split it into channels later, if needed
+      sfinfo_.samplerate = static_cast<int>(std::lround(mpx_samplerate));
       sfinfo_.channels   = 1;
-      sfinfo_.format     = SF_FORMAT_RAW | SF_FORMAT_PCM_16;
-      sfinfo_.samplerate = static_cast<int>(std::lround(options.samplerate));
-      sfinfo_.frames     = 0;
-      file_              = ::sf_open_fd(::fileno(stdin), SFM_READ, &sfinfo_, SF_TRUE);
-      if (feed_thru_)
-        outfile_ = ::sf_open_fd(::fileno(stdout), SFM_WRITE, &sfinfo_, SF_TRUE);
-
       break;
     }
     case InputType::MPX_container: {
-      source_is_raw_pcm_ = false;
-      file_              = ::sf_open(options.sndfilename.c_str(), SFM_READ, &sfinfo_);
+      if (mapped_file_.open(filename_)) {
+        const auto layout = parseWAVHeader(mapped_file_.data(), mapped_file_.size());
+        if (layout.has_value) {
+          mapped_layout_     = layout.value;
+          sfinfo_.samplerate = static_cast<int>(std::lround(layout.value.samplerate));
+          sfinfo_.channels   = static_cast<int>(layout.value.num_channels);
+          break;
+        }
+        mapped_file_.close();
+      }
+
+      file_ = ::sf_open(options.sndfilename.c_str(), SFM_READ, &sfinfo_);
       break;
     }
     default: return;
   }
 
   // Fatal errors opening the file
-  if (file_ == nullptr) {
-    if (::sf_error(file_) == 26 || options.input_type == InputType::MPX_raw_stdin) {
+  if (file_ == nullptr && !mapped_file_.isOpen() && async_reader_ == nullptr &&
+      raw_stream_reader_ == nullptr) {
+    if (::sf_error(file_) == 26) {
       std::cerr << "redsea: error: Unexpected end of input (error " << ::sf_strerror(file_) << ")"
                 << std::endl;
       throw BeyondEofError();
@@ -87,6 +241,8 @@ void MPXReader::init(const Options& options) {
         std::to_string(static_cast<int>(kMinimumSampleRate_Hz)) + " Hz or higher");
   } else if (options.streams && sfinfo_.samplerate < 171000) {
     throw std::runtime_error("RDS2 data streams require a sample rate of 171 kHz or higher");
+  } else if (options.fixed_point && sfinfo_.samplerate != 171000) {
+    throw std::runtime_error("--fixed-point requires a sample rate of 171 kHz");
   } else if (sfinfo_.samplerate > static_cast<int>(kMaximumSampleRate_Hz)) {
     throw std::runtime_error("sample rate is " + std::to_string(sfinfo_.samplerate) +
                              " Hz, must be " + "no higher than " +
@@ -112,15 +268,31 @@ void MPXReader::init(const Options& options) {
     }
   }
 
-  chunk_size_ = (static_cast<sf_count_t>(kInputChunkSize) / num_channels_) * num_channels_;
-  is_eof_     = (num_channels_ >= buffer_.data.size());
+  num_input_channels_ = is_channelized_ ? 1 : num_channels_;
+
+  // Channelized IQ is read in whole filter bank blocks
+  const auto frame_size = static_cast<sf_count_t>(
+      is_channelized_ ? fm_channelizer_.getBlockSize() : num_input_channels_);
+  chunk_size_ = (static_cast<sf_count_t>(kInputChunkSize) / frame_size) * frame_size;
+  is_eof_     = (num_input_channels_ >= buffer_.data.size());
+
+  if (num_channels_ > 1) {
+    channel_buffers_.resize(num_channels_);
+    if (is_channelized_) {
+      for (auto& channel_buffer : channel_buffers_)
+        channel_outputs_.push_back(channel_buffer.data.data());
+    } else {
+      channel_buffers_s16_.resize(num_channels_);
+    }
+  }
 }
 
 MPXReader::~MPXReader() {
   static_cast<void>(::sf_close(file_));
-
-  if (feed_thru_)
-    static_cast<void>(::sf_close(outfile_));
+  // The readers must be done with it first
+  async_reader_.reset();
+  if (raw_file_fd_ >= 0)
+    static_cast<void>(::close(raw_file_fd_));
 }
 
 bool MPXReader::eof() const {
@@ -129,40 +301,41 @@ bool MPXReader::eof() const {
 
 // @brief Fill the internal buffer with fresh samples.
 void MPXReader::fillBuffer() {
-  // Redsea's UX of choosing between WAV and raw PCM on stdin is arguably confusing.
-  // We are sacrificing the first 4 bytes of stdin for this helpful warning message.
-  if (is_beginning_ && source_is_raw_pcm_) {
-    std::array<std::int16_t, kMaxNumChannels> test_samples{};
-    // So we don't mess up the channel alignment
-    const auto to_read = std::max(num_channels_, 2U);
-    num_read_          = ::sf_read_short(file_, test_samples.data(), to_read);
-    // 'R' 'I' 'F' 'F' in little-endian
-    if (num_read_ >= 2 && test_samples[0] == 0x4952 && test_samples[1] == 0x4646) {
-      std::cerr << "redsea: warning: expected raw PCM via pipe, but the data looks like WAV. "
-                   "Did you mean to use the -f option?"
-                << std::endl;
-    }
-
-    // Note. We'll read it as raw PCM anyway.
+  if (mapped_file_.isOpen()) {
+    fillBufferFromMap();
+    return;
+  }
+  if (async_reader_ != nullptr || raw_stream_reader_ != nullptr) {
+    fillBufferFromStdin();
+    return;
   }
-  is_beginning_ = false;
 
-  num_read_ = ::sf_read_float(file_, buffer_.data.data(), chunk_size_);
+  if (read_s16_) {
+    num_read_ = ::sf_read_short(file_, buffer_s16_.data.data(), chunk_size_);
+  } else {
+    num_read_ = ::sf_read_float(file_, buffer_.data.data(), chunk_size_);
+  }
 
-  buffer_.time_received = std::chrono::system_clock::now();
+  buffer_.time_received     = std::chrono::system_clock::now();
+  buffer_s16_.time_received = buffer_.time_received;
 
   if (num_read_ < chunk_size_)
     is_eof_ = true;
 
-  buffer_.used_size = static_cast<size_t>(num_read_);
+  buffer_.used_size     = read_s16_ ? 0 : static_cast<size_t>(num_read_);
+  buffer_s16_.used_size = read_s16_ ? static_cast<size_t>(num_read_) : 0;
 
-  if (feed_thru_) {
-    static_cast<void>(::sf_write_float(outfile_, buffer_.data.data(), num_read_));
+  if (num_channels_ > 1) {
+    if (read_s16_)
+      deinterleave(buffer_s16_, num_channels_, channel_buffers_s16_);
+    else
+      deinterleave(buffer_, num_channels_, channel_buffers_);
   }
 }
 
 // @brief Read a chunk of samples on the specified PCM channel.
-// @note Channel 0 MUST be processed first; it will trigger the next buffer read.
+// @note Channel 0 MUST be processed first; it will trigger the next buffer read. The chunks of
+//       all channels stay valid until then, so they can be processed at the same time.
 // @throws logic_error if channel is out-of-bounds
 MPXBuffer& MPXReader::readChunk(std::uint32_t channel) {
   if (channel >= num_channels_) {
@@ -174,19 +347,140 @@ MPXBuffer& MPXReader::readChunk(std::uint32_t channel) {
     fillBuffer();
   }
 
-  if (is_eof_) {
-    return buffer_;
+  return num_channels_ == 1 ? buffer_ : channel_buffers_[channel];
+}
+
+// @brief Read a chunk of 16-bit samples on the specified PCM channel. Only for readers
+//        initialized with the fixed-point option.
+// @note Channel 0 MUST be processed first; it will trigger the next buffer read.
+// @throws logic_error if channel is out-of-bounds
+MPXBufferS16& MPXReader::readChunkS16(std::uint32_t channel) {
+  if (channel >= num_channels_) {
+    throw std::logic_error("Tried to access channel " + std::to_string(channel) + " of " +
+                           std::to_string(num_channels_) + "-channel signal");
+  }
+  assert(read_s16_);
+
+  if (channel == 0) {
+    fillBuffer();
+  }
+
+  return num_channels_ == 1 ? buffer_s16_ : channel_buffers_s16_[channel];
+}
+
+// @brief Take the next chunk straight from the mapped file. Samples are converted and split into
+//        channels on the way, so they are only touched once.
+void MPXReader::fillBufferFromMap() {
+  const std::size_t bytes_per_frame =
+      getBytesPerSample(mapped_layout_.format) * num_input_channels_;
+  const std::size_t num_frames =
+      std::min((mapped_layout_.data_size - mapped_position_) / bytes_per_frame,
+               static_cast<std::size_t>(chunk_size_) / num_input_channels_);
+  const std::uint8_t* bytes = mapped_file_.data() + mapped_layout_.data_offset + mapped_position_;
+  mapped_position_ += num_frames * bytes_per_frame;
+
+  // The raw bytes are already in the output format
+  if (feed_thru_)
+    static_cast<void>(std::fwrite(bytes, bytes_per_frame, num_frames, stdout));
+
+  loadRawSamples(bytes, mapped_layout_.format, num_frames);
+}
+
+// @brief Read the next chunk of raw samples from stdin, or from a raw file that couldn't be
+//        mapped. With --io-uring, the AsyncReader has
+//        already read it in while we were processing the previous one.
+void MPXReader::fillBufferFromStdin() {
+  const std::size_t size = static_cast<std::size_t>(chunk_size_) * getBytesPerSample(raw_format_);
+  std::size_t num_bytes{};
+  if (async_reader_ != nullptr) {
+    num_bytes = async_reader_->read(raw_bytes_.data(), size);
+    if (feed_thru_)
+      static_cast<void>(std::fwrite(raw_bytes_.data(), 1, num_bytes, stdout));
+  } else {
+    // Passes the bytes through for --feed-through on its own
+    num_bytes = raw_stream_reader_->read(raw_bytes_.data(), size);
+  }
+
+  // Redsea's UX of choosing between WAV and raw PCM on stdin is arguably confusing.
+  // We'll read it as raw PCM anyway.
+  if (is_beginning_ && num_bytes >= 4 && std::memcmp(raw_bytes_.data(), "RIFF", 4) == 0) {
+    std::cerr << "redsea: warning: expected raw PCM via pipe, but the data looks like WAV. "
+                 "Did you mean to use the -f option?"
+              << std::endl;
   }
+  is_beginning_ = false;
 
-  if (num_channels_ == 1) {
-    return buffer_;
+  loadRawSamples(raw_bytes_.data(), raw_format_,
+                 num_bytes / (getBytesPerSample(raw_format_) * num_input_channels_));
+}
+
+// Each format gets a conversion loop of its own, with the sample conversion inlined into it
+template <SampleFormat Format>
+void MPXReader::convertRawSamples(const std::uint8_t* bytes, std::size_t num_samples) {
+  constexpr std::size_t kBytesPerSample = getBytesPerSample(Format);
+  if (read_s16_) {
+    loadChannels(
+        [bytes](std::size_t i) { return loadSampleAsS16<Format>(bytes + kBytesPerSample * i); },
+        num_samples, num_channels_, buffer_s16_, channel_buffers_s16_);
   } else {
-    buffer_singlechan_.used_size = buffer_.used_size / num_channels_;
-    for (size_t i = 0; i < buffer_singlechan_.used_size; i++)
-      buffer_singlechan_.data[i] = buffer_.data[i * num_channels_ + channel];
+    loadChannels(
+        [bytes](std::size_t i) { return loadSampleAsFloat<Format>(bytes + kBytesPerSample * i); },
+        num_samples, num_channels_, buffer_, channel_buffers_);
+  }
+}
+
+// Split IQ into I and Q, converting the components on the way, and FM demodulate it into MPX.
+// Wideband IQ is split into channels first, each demodulated into a buffer of its own.
+template <SampleFormat ComponentFormat>
+void MPXReader::demodulateIQ(const std::uint8_t* bytes, std::size_t num_samples) {
+  constexpr std::size_t kBytesPerComponent = getBytesPerSample(ComponentFormat);
+  if (is_channelized_) {
+    for (std::size_t i = 0; i < num_samples; i++) {
+      const std::uint8_t* sample = bytes + 2 * kBytesPerComponent * i;
+      iq_samples_[i].real(loadSampleAsFloat<ComponentFormat>(sample));
+      iq_samples_[i].imag(loadSampleAsFloat<ComponentFormat>(sample + kBytesPerComponent));
+    }
+    const std::size_t num_output =
+        fm_channelizer_.execute(iq_samples_.data(), num_samples, channel_outputs_.data());
+    for (auto& channel_buffer : channel_buffers_) channel_buffer.used_size = num_output;
+    return;
+  }
+
+  deinterleaveAny(
+      [bytes](std::size_t i) {
+        return loadSampleAsFloat<ComponentFormat>(bytes + kBytesPerComponent * i);
+      },
+      2 * num_samples, 2, iq_buffers_);
+  buffer_.used_size = fm_discriminator_.execute(iq_buffers_[0].data.data(),
+                                                iq_buffers_[1].data.data(), num_samples,
+                                                buffer_.data.data());
+}
 
-    return buffer_singlechan_;
+// @brief Convert raw little-endian samples and split them into channels, in one pass.
+// @param num_frames Number of samples per channel
+void MPXReader::loadRawSamples(const std::uint8_t* bytes, SampleFormat format,
+                               std::size_t num_frames) {
+  num_read_ = static_cast<sf_count_t>(num_frames * num_input_channels_);
+  if (num_read_ < chunk_size_)
+    is_eof_ = true;
+
+  const auto num_samples = static_cast<std::size_t>(num_read_);
+  switch (format) {
+    case SampleFormat::S16LE: convertRawSamples<SampleFormat::S16LE>(bytes, num_samples); break;
+    case SampleFormat::S8:    convertRawSamples<SampleFormat::S8>(bytes, num_samples); break;
+    case SampleFormat::U8:    convertRawSamples<SampleFormat::U8>(bytes, num_samples); break;
+    case SampleFormat::F32LE: convertRawSamples<SampleFormat::F32LE>(bytes, num_samples); break;
+    case SampleFormat::CS16LE: demodulateIQ<SampleFormat::S16LE>(bytes, num_samples); break;
+    case SampleFormat::CU8:    demodulateIQ<SampleFormat::U8>(bytes, num_samples); break;
+    case SampleFormat::CF32LE: demodulateIQ<SampleFormat::F32LE>(bytes, num_samples); break;
   }
+
+  buffer_.time_received     = std::chrono::system_clock::now();
+  buffer_s16_.time_received = buffer_.time_received;
+  for (auto& channel_buffer : channel_buffers_)
+    channel_buffer.time_received = buffer_.time_received;
+  for (auto& channel_buffer : channel_buffers_s16_)
+    channel_buffer.time_received = buffer_.time_received;
 }
 
 float MPXReader::getSamplerate() const {
@@ -19,21 +19,33 @@
 
 #include <array>
 #include <chrono>
+#include <complex>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <sndfile.h>
 
 #include "src/constants.hh"
+#include "src/dsp/fm_channelizer.hh"
+#include "src/dsp/fm_discriminator.hh"
 #include "src/group.hh"
+#include "src/io/async_reader.hh"
+#include "src/io/mapped_file.hh"
+#include "src/io/sample_format.hh"
+#include "src/io/raw_stream.hh"
 
 namespace redsea {
 
 struct Options;
 
+// Reads that the AsyncReader keeps in flight
+constexpr std::size_t kNumAsyncReadBuffers = 4;
+
 // Read this many samples at a time
 constexpr std::size_t kInputChunkSize = 8192;
 
@@ -47,6 +59,19 @@ class MPXBuffer {
   std::chrono::time_point<std::chrono::system_clock> time_received;
 };
 
+// Integer samples for the fixed-point demodulator. It never resamples, so no extra room needed.
+class MPXBufferS16 {
+ public:
+  std::array<std::int16_t, kInputChunkSize> data{};
+  std::size_t used_size{};
+  std::chrono::time_point<std::chrono::system_clock> time_received;
+};
+
+void deinterleave(const MPXBuffer& interleaved, std::uint32_t num_channels,
+                  std::vector<MPXBuffer>& channels);
+void deinterleave(const MPXBufferS16& interleaved, std::uint32_t num_channels,
+                  std::vector<MPXBufferS16>& channels);
+
 class BeyondEofError : std::exception {
  public:
   BeyondEofError() = default;
@@ -63,27 +88,60 @@ class MPXReader {
   void init(const Options& options);
   [[nodiscard]] bool eof() const;
   [[nodiscard]] MPXBuffer& readChunk(std::uint32_t channel);
+  [[nodiscard]] MPXBufferS16& readChunkS16(std::uint32_t channel);
   [[nodiscard]] float getSamplerate() const;
   [[nodiscard]] std::uint32_t getNumChannels() const;
 
  private:
   void fillBuffer();
+  void fillBufferFromMap();
+  void fillBufferFromStdin();
+  void loadRawSamples(const std::uint8_t* bytes, SampleFormat format, std::size_t num_frames);
+  template <SampleFormat Format>
+  void convertRawSamples(const std::uint8_t* bytes, std::size_t num_samples);
+  template <SampleFormat ComponentFormat>
+  void demodulateIQ(const std::uint8_t* bytes, std::size_t num_samples);
 
   std::uint32_t num_channels_{};
+  // Channels interleaved in the input; differs from num_channels_ for channelized IQ
+  std::uint32_t num_input_channels_{};
   // How many samples to read at once (gets split into channels internally)
   sf_count_t chunk_size_{};
   bool is_eof_{true};
   bool feed_thru_{false};
   bool is_beginning_{true};
-  bool source_is_raw_pcm_{false};
+  // Read 16-bit integers instead of floats
+  bool read_s16_{false};
   std::string filename_;
   MPXBuffer buffer_{};
-  MPXBuffer buffer_singlechan_{};
+  MPXBufferS16 buffer_s16_{};
+  // Multi-channel input is split into these right after reading
+  std::vector<MPXBuffer> channel_buffers_;
+  std::vector<MPXBufferS16> channel_buffers_s16_;
   SF_INFO sfinfo_{0, 0, 0, 0, 0, 0};
   SNDFILE* file_{nullptr};
-  SNDFILE* outfile_{nullptr};
   // How many samples was read, before dividing into channels
   sf_count_t num_read_{};
+  // Used instead of libsndfile for uncompressed files
+  MappedFile mapped_file_;
+  PCMLayout mapped_layout_;
+  // Bytes already read from the sample data
+  std::size_t mapped_position_{};
+  // Raw stdin is read with one of these, instead of libsndfile; so is a raw file that can't be
+  // mapped, through this descriptor
+  int raw_file_fd_{-1};
+  std::unique_ptr<AsyncReader> async_reader_;
+  std::unique_ptr<RawStreamReader> raw_stream_reader_;
+  SampleFormat raw_format_{SampleFormat::S16LE};
+  // For IQ input
+  FMDiscriminator fm_discriminator_;
+  std::vector<MPXBuffer> iq_buffers_;
+  // For wideband IQ input that is split into channels (--channelize)
+  bool is_channelized_{false};
+  FMChannelizer fm_channelizer_;
+  std::vector<std::complex<float>> iq_samples_;
+  std::vector<float*> channel_outputs_;
+  std::vector<std::uint8_t> raw_bytes_;
 };
 
 class AsciiBitReader {
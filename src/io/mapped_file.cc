@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/io/mapped_file.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "src/util/maybe.hh"
+
+namespace redsea {
+
+namespace {
+
+constexpr std::uint16_t kWaveFormatPCM        = 0x0001;
+constexpr std::uint16_t kWaveFormatIEEEFloat  = 0x0003;
+constexpr std::uint16_t kWaveFormatExtensible = 0xFFFE;
+
+// RF64 puts this in the 32-bit size fields and the real size in the ds64 chunk
+constexpr std::uint32_t kRF64SizeInDS64 = 0xFFFF'FFFF;
+
+std::uint16_t loadU16LE(const std::uint8_t* bytes) {
+  return static_cast<std::uint16_t>(bytes[0] | (bytes[1] << 8U));
+}
+
+std::uint32_t loadU32LE(const std::uint8_t* bytes) {
+  return static_cast<std::uint32_t>(loadU16LE(bytes)) |
+         (static_cast<std::uint32_t>(loadU16LE(bytes + 2)) << 16U);
+}
+
+std::uint64_t loadU64LE(const std::uint8_t* bytes) {
+  return static_cast<std::uint64_t>(loadU32LE(bytes)) |
+         (static_cast<std::uint64_t>(loadU32LE(bytes + 4)) << 32U);
+}
+
+bool isFourCC(const std::uint8_t* bytes, const char* fourcc) {
+  return std::memcmp(bytes, fourcc, 4) == 0;
+}
+
+}  // namespace
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr)
+    static_cast<void>(::munmap(const_cast<std::uint8_t*>(data_), size_));
+  data_ = nullptr;
+  size_ = 0;
+}
+
+// @return false if the file can't be mapped (e.g. it's a pipe or stdin); then it should be read
+//         the normal way
+bool MappedFile::open(const std::string& filename) {
+  // Opening and closing a named pipe would be seen by the writer; it could get SIGPIPE before the
+  // file is opened again for reading the normal way
+  struct stat path_status {};
+  if (::stat(filename.c_str(), &path_status) != 0 || !S_ISREG(path_status.st_mode))
+    return false;
+
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat file_status {};
+  if (::fstat(fd, &file_status) != 0 || !S_ISREG(file_status.st_mode) ||
+      file_status.st_size <= 0) {
+    static_cast<void>(::close(fd));
+    return false;
+  }
+
+  const auto size = static_cast<std::size_t>(file_status.st_size);
+  void* mapping   = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file open
+  static_cast<void>(::close(fd));
+  if (mapping == MAP_FAILED)
+    return false;
+
+  // Only a hint; the kernel may read further ahead and drop pages behind us
+  static_cast<void>(::madvise(mapping, size, MADV_SEQUENTIAL));
+
+  data_ = static_cast<const std::uint8_t*>(mapping);
+  size_ = size;
+  return true;
+}
+
+// @brief Find the sample data in a WAV or RF64 (EBU Tech 3306) file.
+// @return Nothing if it's not a WAV file, or its samples aren't 8/16-bit integers or 32-bit floats
+Maybe<PCMLayout> parseWAVHeader(const std::uint8_t* data, std::size_t size) {
+  Maybe<PCMLayout> result;
+
+  if (size < 12 || !(isFourCC(data, "RIFF") || isFourCC(data, "RF64")) ||
+      !isFourCC(data + 8, "WAVE"))
+    return result;
+
+  bool has_format{};
+  std::uint64_t rf64_data_size{};
+  std::uint16_t format_tag{};
+  std::uint16_t bits_per_sample{};
+
+  std::size_t position = 12;
+  while (position + 8 <= size) {
+    const std::uint8_t* chunk = data + position;
+    const std::size_t payload_size =
+        std::min(static_cast<std::size_t>(loadU32LE(chunk + 4)), size - position - 8);
+    const std::uint8_t* payload = chunk + 8;
+
+    if (isFourCC(chunk, "ds64") && payload_size >= 16) {
+      rf64_data_size = loadU64LE(payload + 8);
+    } else if (isFourCC(chunk, "fmt ") && payload_size >= 16) {
+      format_tag                = loadU16LE(payload);
+      result.value.num_channels = loadU16LE(payload + 2);
+      result.value.samplerate   = static_cast<float>(loadU32LE(payload + 4));
+      bits_per_sample           = loadU16LE(payload + 14);
+      // The actual format is in the first two bytes of the sub-format GUID
+      if (format_tag == kWaveFormatExtensible && payload_size >= 26)
+        format_tag = loadU16LE(payload + 24);
+      has_format = true;
+    } else if (isFourCC(chunk, "data")) {
+      result.value.data_offset = position + 8;
+      result.value.data_size   = size - result.value.data_offset;
+      // Files that were still being recorded may have a zero or too large size here; then we
+      // read up to the end of the file
+      const std::uint32_t data_size = loadU32LE(chunk + 4);
+      if (data_size == kRF64SizeInDS64 && rf64_data_size > 0)
+        result.value.data_size =
+            std::min(result.value.data_size, static_cast<std::size_t>(rf64_data_size));
+      else if (data_size > 0)
+        result.value.data_size = std::min(result.value.data_size, std::size_t{data_size});
+      break;
+    }
+
+    // Chunks are padded to an even length
+    position += 8 + payload_size + (payload_size % 2);
+  }
+
+  if (!has_format || result.value.data_offset == 0 || result.value.num_channels == 0)
+    return result;
+
+  // 8-bit WAV is unsigned
+  if (format_tag == kWaveFormatPCM && bits_per_sample == 8)
+    result.value.format = SampleFormat::U8;
+  else if (format_tag == kWaveFormatPCM && bits_per_sample == 16)
+    result.value.format = SampleFormat::S16LE;
+  else if (format_tag == kWaveFormatIEEEFloat && bits_per_sample == 32)
+    result.value.format = SampleFormat::F32LE;
+  else
+    return result;
+
+  result.has_value = true;
+  return result;
+}
+
+}  // namespace redsea
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef IO_MAPPED_FILE_H_
+#define IO_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "src/io/sample_format.hh"
+#include "src/util/maybe.hh"
+
+namespace redsea {
+
+// Where the samples are in an uncompressed PCM file, and what they look like
+struct PCMLayout {
+  SampleFormat format{SampleFormat::S16LE};
+  std::uint32_t num_channels{1};
+  float samplerate{};
+  // In bytes from the start of the file
+  std::size_t data_offset{};
+  std::size_t data_size{};
+};
+
+// \brief A whole file mapped read-only into memory.
+//
+// The kernel reads the file in ahead of us as we go through it sequentially, and we read the
+// samples straight out of the page cache, without copying them into a read buffer first.
+class MappedFile {
+ public:
+  MappedFile()                             = default;
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&&)                 = delete;
+  MappedFile& operator=(MappedFile&&)      = delete;
+  ~MappedFile();
+
+  bool open(const std::string& filename);
+  void close();
+  [[nodiscard]] bool isOpen() const {
+    return data_ != nullptr;
+  }
+  [[nodiscard]] const std::uint8_t* data() const {
+    return data_;
+  }
+  [[nodiscard]] std::size_t size() const {
+    return size_;
+  }
+
+ private:
+  const std::uint8_t* data_{nullptr};
+  std::size_t size_{};
+};
+
+Maybe<PCMLayout> parseWAVHeader(const std::uint8_t* data, std::size_t size);
+
+}  // namespace redsea
+
+#endif  // IO_MAPPED_FILE_H_
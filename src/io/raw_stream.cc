@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/io/raw_stream.hh"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace redsea {
+
+namespace {
+
+#ifdef __linux__
+// Room for about 3 seconds of 171 kHz S16 in the output pipe, so that a consumer that is
+// briefly slow (e.g. an audio player starting up) doesn't stall decoding
+constexpr int kEchoPipeSize = 1024 * 1024;
+
+bool isPipe(int fd) {
+  struct stat file_status {};
+  return ::fstat(fd, &file_status) == 0 && S_ISFIFO(file_status.st_mode);
+}
+
+// Read exactly size bytes, unless the input ends
+std::size_t readFully(int fd, std::uint8_t* destination, std::size_t size) {
+  std::size_t num_read{};
+  while (num_read < size) {
+    const ssize_t result = ::read(fd, destination + num_read, size - num_read);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      throw std::runtime_error(std::string("read error: ") + std::strerror(errno));
+    if (result == 0)
+      break;
+    num_read += static_cast<std::size_t>(result);
+  }
+  return num_read;
+}
+#endif
+
+// @return false if the output failed, e.g. with EPIPE after the consumer of the echo went away.
+//         redsea ignores SIGPIPE with --feed-through, so this doesn't kill the process.
+bool writeFully(int fd, const std::uint8_t* bytes, std::size_t size) {
+  std::size_t num_written{};
+  while (num_written < size) {
+    const ssize_t result = ::write(fd, bytes + num_written, size - num_written);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false;
+    num_written += static_cast<std::size_t>(result);
+  }
+  return true;
+}
+
+}  // namespace
+
+RawStreamReader::RawStreamReader(int fd, int echo_fd) : fd_(fd), echo_fd_(echo_fd) {
+#ifdef __linux__
+  if (echo_fd_ >= 0 && isPipe(echo_fd_)) {
+    // Only a hint; the system may limit the size
+    static_cast<void>(::fcntl(echo_fd_, F_SETPIPE_SZ, kEchoPipeSize));
+    use_tee_ = isPipe(fd_);
+  }
+#endif
+}
+
+// @brief Read size bytes, or fewer at the end of the input.
+// @throws std::runtime_error for read errors
+std::size_t RawStreamReader::read(std::uint8_t* destination, std::size_t size) {
+  std::size_t num_read{};
+  while (num_read < size && !is_eof_) {
+    const std::size_t num_new = use_tee_ ? teeAndRead(destination + num_read, size - num_read)
+                                         : readAndEcho(destination + num_read, size - num_read);
+    if (num_new == 0)
+      is_eof_ = true;
+    num_read += num_new;
+  }
+  return num_read;
+}
+
+bool RawStreamReader::eof() const {
+  return is_eof_;
+}
+
+std::size_t RawStreamReader::readAndEcho(std::uint8_t* destination, std::size_t size) {
+  ssize_t num_read{};
+  do {
+    num_read = ::read(fd_, destination, size);
+  } while (num_read < 0 && errno == EINTR);
+  if (num_read < 0)
+    throw std::runtime_error(std::string("read error: ") + std::strerror(errno));
+
+  // Stop echoing if the output failed, but keep decoding
+  if (echo_fd_ >= 0 && !writeFully(echo_fd_, destination, static_cast<std::size_t>(num_read)))
+    echo_fd_ = -1;
+
+  return static_cast<std::size_t>(num_read);
+}
+
+// Duplicate what's in the input pipe into the output pipe, then consume the same bytes
+std::size_t RawStreamReader::teeAndRead(std::uint8_t* destination, std::size_t size) {
+#ifdef __linux__
+  ssize_t num_teed{};
+  do {
+    num_teed = ::tee(fd_, echo_fd_, size, 0);
+  } while (num_teed < 0 && errno == EINTR);
+
+  if (num_teed < 0) {
+    // E.g. the output stopped being a pipe that tee(2) supports; copy the rest instead. If the
+    // reader of the output went away (EPIPE), readAndEcho() stops echoing altogether.
+    use_tee_ = false;
+    return readAndEcho(destination, size);
+  }
+
+  // The duplicated bytes are waiting in the input pipe
+  return readFully(fd_, destination, static_cast<std::size_t>(num_teed));
+#else
+  return readAndEcho(destination, size);
+#endif
+}
+
+}  // namespace redsea
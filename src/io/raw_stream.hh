@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef IO_RAW_STREAM_H_
+#define IO_RAW_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace redsea {
+
+// \brief Reads raw bytes from a stream (e.g. stdin) and optionally passes the very same bytes
+// through to another one (e.g. stdout for --feed-through).
+//
+// When both are pipes, the input is duplicated into the output pipe in the kernel with tee(2)
+// (Linux only) and then read for decoding; the passed-through bytes are never copied into user
+// space. Otherwise, each chunk is written out as it was read. If the output fails (e.g. the pipe
+// was closed), the input is still read, just no longer passed through.
+class RawStreamReader {
+ public:
+  // @param echo_fd Where to pass the input through, or -1 for nowhere
+  RawStreamReader(int fd, int echo_fd);
+
+  std::size_t read(std::uint8_t* destination, std::size_t size);
+  [[nodiscard]] bool eof() const;
+
+ private:
+  std::size_t readAndEcho(std::uint8_t* destination, std::size_t size);
+  std::size_t teeAndRead(std::uint8_t* destination, std::size_t size);
+
+  int fd_{-1};
+  int echo_fd_{-1};
+  bool use_tee_{};
+  bool is_eof_{};
+};
+
+}  // namespace redsea
+
+#endif  // IO_RAW_STREAM_H_
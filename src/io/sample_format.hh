@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef IO_SAMPLE_FORMAT_H_
+#define IO_SAMPLE_FORMAT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace redsea {
+
+// Raw sample encodings that we convert ourselves, without libsndfile. The C formats are
+// complex (IQ), with I and Q interleaved.
+enum class SampleFormat : std::uint8_t { S16LE, S8, U8, F32LE, CS16LE, CU8, CF32LE };
+
+[[nodiscard]] constexpr bool isComplex(SampleFormat format) {
+  return format == SampleFormat::CS16LE || format == SampleFormat::CU8 ||
+         format == SampleFormat::CF32LE;
+}
+
+// Format of the I and Q components of a complex format
+[[nodiscard]] constexpr SampleFormat getComponentFormat(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::CS16LE: return SampleFormat::S16LE;
+    case SampleFormat::CU8:    return SampleFormat::U8;
+    case SampleFormat::CF32LE: return SampleFormat::F32LE;
+    default:                   return format;
+  }
+}
+
+// Complex samples are counted as one, with both components
+[[nodiscard]] constexpr std::size_t getBytesPerSample(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::S8:
+    case SampleFormat::U8:     return 1;
+    case SampleFormat::S16LE:  return 2;
+    case SampleFormat::F32LE:  return 4;
+    case SampleFormat::CU8:    return 2;
+    case SampleFormat::CS16LE: return 4;
+    case SampleFormat::CF32LE: return 8;
+  }
+  return 2;
+}
+
+// Samples are assembled byte by byte, so they can be unaligned and the host can be of any
+// endianness. Compilers turn these into plain loads on little-endian machines.
+inline std::int16_t loadS16LE(const std::uint8_t* bytes) {
+  return static_cast<std::int16_t>(bytes[0] | (bytes[1] << 8U));
+}
+
+inline float loadF32LE(const std::uint8_t* bytes) {
+  const std::uint32_t bits = bytes[0] | (bytes[1] << 8U) | (bytes[2] << 16U) |
+                             (static_cast<std::uint32_t>(bytes[3]) << 24U);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// \brief Conversion of one raw sample into the demodulator's float or integer input. Integers
+// are scaled to [-1, 1) the same way as libsndfile does it.
+template <SampleFormat Format>
+float loadSampleAsFloat(const std::uint8_t* bytes) {
+  if constexpr (Format == SampleFormat::S16LE)
+    return static_cast<float>(loadS16LE(bytes)) * (1.f / 32768.f);
+  else if constexpr (Format == SampleFormat::S8)
+    return static_cast<float>(static_cast<std::int8_t>(bytes[0])) * (1.f / 128.f);
+  else if constexpr (Format == SampleFormat::U8)
+    return static_cast<float>(static_cast<int>(bytes[0]) - 128) * (1.f / 128.f);
+  else
+    return loadF32LE(bytes);
+}
+
+template <SampleFormat Format>
+std::int16_t loadSampleAsS16(const std::uint8_t* bytes) {
+  if constexpr (Format == SampleFormat::S16LE) {
+    return loadS16LE(bytes);
+  } else if constexpr (Format == SampleFormat::S8) {
+    return static_cast<std::int16_t>(static_cast<std::int8_t>(bytes[0]) * 256);
+  } else if constexpr (Format == SampleFormat::U8) {
+    return static_cast<std::int16_t>((static_cast<int>(bytes[0]) - 128) * 256);
+  } else {
+    // Clipped, unlike libsndfile's default
+    return static_cast<std::int16_t>(
+        std::clamp(std::lrint(loadF32LE(bytes) * 32767.f), -32768L, 32767L));
+  }
+}
+
+}  // namespace redsea
+
+#endif  // IO_SAMPLE_FORMAT_H_
@@ -28,6 +28,8 @@
 #include <string>
 
 #include "src/constants.hh"
+#include "src/io/async_reader.hh"
+#include "src/io/sample_format.hh"
 #include "src/util/maybe.hh"
 
 namespace redsea {
@@ -88,30 +90,55 @@ Options getOptions(int argc, char** argv) {
   Options options;
   int fec_flag{1};
   int time_offset_flag{0};
+  int fixed_point_flag{0};
+  int pipeline_flag{0};
+  int pipeline_stats_flag{0};
+  int parallel_streams_flag{0};
+  int fft_front_end_flag{0};
+  int native_demod_flag{0};
+  int lockstep_flag{0};
+  int soft_fec_flag{0};
+  int io_uring_flag{0};
+  int channelize_flag{0};
   int help_flag{0};
   bool has_custom_input_type{};
+  bool is_raw_mpx_requested{};
+  bool has_custom_input_format{};
 
   // clang-format off
-  const std::array<option, 21> long_options{{
+  const std::array<option, 34> long_options{{
       {"input-bits",   no_argument,       nullptr,   'b'},
       {"channels",     required_argument, nullptr,   'c'},
       {"feed-through", no_argument,       nullptr,   'e'},
       {"bler",         no_argument,       nullptr,   'E'},
+      {"max-burst-length", required_argument, nullptr, 'B'},
       {"file",         required_argument, nullptr,   'f'},
       {"input-hex",    no_argument,       nullptr,   'h'},
       {"input",        required_argument, nullptr,   'i'},
+      {"input-format", required_argument, nullptr,   'F'},
       {"loctable",     required_argument, nullptr,   'l'},
       {"output",       required_argument, nullptr,   'o'},
       {"show-partial", no_argument,       nullptr,   'p'},
       {"samplerate",   required_argument, nullptr,   'r'},
       {"show-raw",     no_argument,       nullptr,   'R'},
       {"timestamp",    required_argument, nullptr,   't'},
+      {"threads",      required_argument, nullptr,   'T'},
       {"rbds",         no_argument,       nullptr,   'u'},
       {"streams",      no_argument,       nullptr,   's'},
       {"version",      no_argument,       nullptr,   'v'},
       {"output-hex",   no_argument,       nullptr,   'x'},
       {"no-fec",       no_argument,       &fec_flag, 0  },
+      {"soft-fec",     no_argument,       &soft_fec_flag, 1},
+      {"io-uring",     no_argument,       &io_uring_flag, 1},
+      {"channelize",   no_argument,       &channelize_flag, 1},
       {"time-from-start", no_argument,    &time_offset_flag,   1},
+      {"fixed-point",  no_argument,       &fixed_point_flag, 1},
+      {"parallel-streams", no_argument,   &parallel_streams_flag, 1},
+      {"fft-frontend", no_argument,       &fft_front_end_flag, 1},
+      {"native-demod", no_argument,       &native_demod_flag, 1},
+      {"lockstep",     no_argument,       &lockstep_flag, 1},
+      {"pipeline",     no_argument,       &pipeline_flag, 1},
+      {"pipeline-stats", no_argument,     &pipeline_stats_flag, 1},
       {"help",         no_argument,       &help_flag,   1},
       {nullptr,        0,                 nullptr,   0  }
   }};
@@ -128,6 +155,7 @@ Options getOptions(int argc, char** argv) {
       case 'b':  // For backwards compatibility
         options.input_type    = InputType::ASCIIbits;
         has_custom_input_type = true;
+        is_raw_mpx_requested  = false;
         break;
       case 'c': {
         const auto parsed_channels = parseSI<std::int32_t>(optarg);
@@ -148,6 +176,7 @@ Options getOptions(int argc, char** argv) {
       case 'h':  // For backwards compatibility
         options.input_type    = InputType::Hex;
         has_custom_input_type = true;
+        is_raw_mpx_requested  = false;
         break;
       case 'i': {
         const std::string input_type(optarg);
@@ -163,6 +192,29 @@ Options getOptions(int argc, char** argv) {
           throw std::runtime_error("unknown input format '" + input_type + "'");
         }
         has_custom_input_type = true;
+        is_raw_mpx_requested  = (input_type == "mpx");
+        break;
+      }
+      case 'F': {
+        const std::string input_format(optarg);
+        if (input_format == "s16le") {
+          options.input_format = SampleFormat::S16LE;
+        } else if (input_format == "s8") {
+          options.input_format = SampleFormat::S8;
+        } else if (input_format == "u8") {
+          options.input_format = SampleFormat::U8;
+        } else if (input_format == "f32le") {
+          options.input_format = SampleFormat::F32LE;
+        } else if (input_format == "cs16") {
+          options.input_format = SampleFormat::CS16LE;
+        } else if (input_format == "cu8") {
+          options.input_format = SampleFormat::CU8;
+        } else if (input_format == "cf32") {
+          options.input_format = SampleFormat::CF32LE;
+        } else {
+          throw std::runtime_error("unknown sample format '" + input_format + "'");
+        }
+        has_custom_input_format = true;
         break;
       }
       case 'o': {
@@ -200,6 +252,25 @@ Options getOptions(int argc, char** argv) {
         options.timestamp   = true;
         options.time_format = std::string(optarg);
         break;
+      case 'B': {
+        const auto parsed_length = parseSI<std::int32_t>(optarg);
+        if (!parsed_length.has_value || parsed_length.value < 1 ||
+            parsed_length.value > kMaxBurstErrorLength) {
+          throw std::runtime_error("maximum burst length must be between 1 and " +
+                                   std::to_string(kMaxBurstErrorLength));
+        }
+        options.max_burst_length = static_cast<std::uint32_t>(parsed_length.value);
+        break;
+      }
+      case 'T': {
+        const auto parsed_threads = parseSI<std::int32_t>(optarg);
+        if (!parsed_threads.has_value || parsed_threads.value <= 0 ||
+            parsed_threads.value > kMaxNumChannels) {
+          throw std::runtime_error("check the number of threads");
+        }
+        options.num_threads = static_cast<std::uint32_t>(parsed_threads.value);
+        break;
+      }
       case 'u': options.rbds = true; break;
       case 'l': options.loctable_dirs.emplace_back(optarg); break;
       case 'v': options.print_version = true; break;
@@ -220,9 +291,19 @@ Options getOptions(int argc, char** argv) {
     return options;
   }
 
-  options.early_exit      = options.print_usage || options.print_version;
-  options.use_fec         = (fec_flag == 1);
-  options.time_from_start = (time_offset_flag == 1);
+  options.early_exit       = options.print_usage || options.print_version;
+  options.use_fec          = (fec_flag == 1);
+  options.soft_fec         = (soft_fec_flag == 1);
+  options.io_uring         = (io_uring_flag == 1);
+  options.channelize       = (channelize_flag == 1);
+  options.time_from_start  = (time_offset_flag == 1);
+  options.fixed_point      = (fixed_point_flag == 1);
+  options.pipeline_stats   = (pipeline_stats_flag == 1);
+  options.pipeline         = (pipeline_flag == 1) || options.pipeline_stats;
+  options.parallel_streams = (parallel_streams_flag == 1);
+  options.fft_front_end    = (fft_front_end_flag == 1);
+  options.native_demod     = (native_demod_flag == 1);
+  options.lockstep         = (lockstep_flag == 1);
 
   if (argc > optind) {
     options.print_usage = true;
@@ -235,8 +316,15 @@ Options getOptions(int argc, char** argv) {
   //
 
   if (has_custom_input_type && !options.sndfilename.empty()) {
-    // --input implies stdin and --file implies a file; conflicting
-    throw std::runtime_error("incompatible options: --input and --file");
+    if (is_raw_mpx_requested) {
+      // Raw PCM from a file instead of stdin
+      options.input_type = InputType::MPX_raw_stdin;
+      if (options.sndfilename == "-")
+        options.sndfilename.clear();
+    } else {
+      // The other --input formats imply stdin and --file implies a file; conflicting
+      throw std::runtime_error("incompatible options: --input and --file");
+    }
   }
 
   if (options.feed_thru && options.input_type == InputType::MPX_container) {
@@ -260,6 +348,31 @@ Options getOptions(int argc, char** argv) {
     throw std::runtime_error("--time-from-start only works for MPX input");
   }
 
+  if (options.fixed_point && options.input_type != InputType::MPX_raw_stdin &&
+      options.input_type != InputType::MPX_container) {
+    throw std::runtime_error("--fixed-point only works for MPX input");
+  }
+
+  if (options.input_type == InputType::MPX_raw_stdin && isComplex(options.input_format)) {
+    if (options.num_channels > 1)
+      throw std::runtime_error("IQ input only has one channel");
+    if (options.fixed_point)
+      throw std::runtime_error("--fixed-point doesn't work with IQ input");
+    // It would echo the IQ samples, not the MPX signal that e.g. an audio player expects
+    if (options.feed_thru)
+      throw std::runtime_error("feed-thru is not supported for IQ input");
+  }
+
+  if (options.parallel_streams && options.num_threads > 1) {
+    throw std::runtime_error("--parallel-streams can't be used together with --threads");
+  }
+
+  if (options.channelize &&
+      (options.input_type != InputType::MPX_raw_stdin || !isComplex(options.input_format))) {
+    throw std::runtime_error("--channelize needs IQ input (--input mpx --input-format cu8, cs16, "
+                             "or cf32)");
+  }
+
   //
   // Warnings - we can start the program, but results may be surprising!
   // https://en.wikipedia.org/wiki/Principle_of_least_astonishment
@@ -270,6 +383,31 @@ Options getOptions(int argc, char** argv) {
     warn("--no-fec ignored for hex or tef6686 input");
   }
 
+  if (!options.use_fec && options.max_burst_length != kDefaultMaxBurstLength) {
+    warn("--max-burst-length ignored with --no-fec");
+  }
+
+  if (options.soft_fec && !options.use_fec) {
+    warn("--soft-fec ignored with --no-fec");
+  } else if (options.soft_fec && options.input_type != InputType::MPX_raw_stdin &&
+             options.input_type != InputType::MPX_container) {
+    warn("--soft-fec ignored for non-MPX input");
+  }
+
+  if (has_custom_input_format && options.input_type == InputType::MPX_container) {
+    warn("--input-format ignored; reading the sample format from the file header");
+  } else if (has_custom_input_format && options.input_type != InputType::MPX_raw_stdin) {
+    warn("--input-format ignored for non-MPX input");
+  }
+
+  if (options.io_uring &&
+      (options.input_type != InputType::MPX_raw_stdin || !options.sndfilename.empty())) {
+    warn("--io-uring ignored; it's only for raw MPX via stdin");
+  } else if (options.io_uring && !AsyncReader::isAvailable()) {
+    warn("--io-uring ignored; redsea was built without liburing, or the kernel doesn't allow "
+         "io_uring");
+  }
+
   if (options.show_partial && options.output_type == OutputType::Hex) {
     warn("--show-partial ignored for hex output");
   }
@@ -286,6 +424,50 @@ Options getOptions(int argc, char** argv) {
     warn("--bler ignored for hex output");
   }
 
+  if (options.num_threads > 1 && options.input_type != InputType::MPX_raw_stdin &&
+      options.input_type != InputType::MPX_container) {
+    warn("--threads ignored for non-MPX input");
+  }
+
+  if (options.fft_front_end && options.input_type != InputType::MPX_raw_stdin &&
+      options.input_type != InputType::MPX_container) {
+    warn("--fft-frontend ignored for non-MPX input");
+  } else if (options.fft_front_end && options.fixed_point) {
+    warn("--fft-frontend ignored with --fixed-point");
+  }
+
+  if (options.native_demod && options.input_type != InputType::MPX_raw_stdin &&
+      options.input_type != InputType::MPX_container) {
+    warn("--native-demod ignored for non-MPX input");
+  }
+
+  if (options.lockstep && options.input_type != InputType::MPX_raw_stdin &&
+      options.input_type != InputType::MPX_container) {
+    warn("--lockstep ignored for non-MPX input");
+  } else if (options.lockstep && options.fixed_point) {
+    warn("--lockstep ignored with --fixed-point");
+  } else if (options.lockstep && options.pipeline) {
+    warn("--lockstep ignored with --pipeline");
+  } else if (options.lockstep) {
+    if (options.num_threads > 1)
+      warn("--threads ignored with --lockstep");
+    if (options.fft_front_end)
+      warn("--fft-frontend ignored with --lockstep");
+    if (options.parallel_streams)
+      warn("--parallel-streams ignored with --lockstep");
+  }
+
+  if (options.parallel_streams && !options.streams) {
+    warn("--parallel-streams ignored without --streams");
+  }
+
+  if (options.pipeline && options.input_type != InputType::MPX_raw_stdin &&
+      options.input_type != InputType::MPX_container) {
+    warn("--pipeline ignored for non-MPX input");
+  } else if (options.pipeline && options.num_threads > 1) {
+    warn("--threads ignored with --pipeline");
+  }
+
   // --rbds doesn't have any effect for hex output either, but we choose not to warn about it
 
   if (options.is_custom_rate_defined) {
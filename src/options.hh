@@ -21,8 +21,12 @@
 #include <string>
 #include <vector>
 
+#include "src/constants.hh"
+#include "src/io/sample_format.hh"
+
 namespace redsea {
 
+// MPX_raw_stdin is also used for raw PCM from a file (--input mpx --file)
 enum class InputType : uint8_t { MPX_raw_stdin, MPX_container, ASCIIbits, Hex, TEF6686 };
 
 enum class OutputType : uint8_t { Hex, JSON };
@@ -45,11 +49,37 @@ struct Options {
   bool is_custom_rate_defined{};
   bool is_num_channels_defined{};
   bool use_fec{true};
+  // Longest burst of bit errors to correct in a block
+  std::uint32_t max_burst_length{kDefaultMaxBurstLength};
+  // Also try flipping the least reliable bits of the demodulator (MPX input only)
+  bool soft_fec{};
   bool streams{};
+  // Read stdin ahead asynchronously via io_uring (raw MPX input only)
+  bool io_uring{};
+  // Split wideband IQ input into FM channels, each decoded on its own
+  bool channelize{};
   bool time_from_start{};
+  // Integer demodulator front end (S16 input at 171 kHz only)
+  bool fixed_point{};
+  // Demodulate the RDS2 data streams in threads of their own
+  bool parallel_streams{};
+  // Extract all subcarriers with one FFT per block instead of separate mixers and filters
+  bool fft_front_end{};
+  // Inlined AGC, phase detector and symbol timing recovery instead of liquid-dsp's
+  bool native_demod{};
+  // Demodulate all channels together, with the channels in SIMD lanes
+  bool lockstep{};
+  // Run reading, demodulation, decoding and output in separate threads
+  bool pipeline{};
+  // Print the pipeline's queue depths at the end
+  bool pipeline_stats{};
   float samplerate{};
   std::uint32_t num_channels{1};
+  // Channels are decoded in parallel on this many threads
+  std::uint32_t num_threads{1};
   InputType input_type{InputType::MPX_raw_stdin};
+  // Encoding of raw MPX samples
+  SampleFormat input_format{SampleFormat::S16LE};
   OutputType output_type{OutputType::JSON};
   std::vector<std::string> loctable_dirs;
   std::string sndfilename;
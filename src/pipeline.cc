@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/pipeline.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace redsea {
+
+namespace {
+
+// Copy only the samples that are in use; the buffers are much larger than a typical chunk
+template <typename Buffer>
+void copyChunk(const Buffer& source, Buffer& destination) {
+  std::copy_n(source.data.cbegin(), source.used_size, destination.data.begin());
+  destination.used_size     = source.used_size;
+  destination.time_received = source.time_received;
+}
+
+template <typename Ring>
+void printRingStats(const char* name, const Ring& ring, std::ostream& stats_ostream) {
+  stats_ostream << ' ' << name << ' ' << ring.getPeakDepth() << '/' << ring.capacity() << " ("
+                << ring.getNumTimesFull() << "x full)";
+}
+
+}  // namespace
+
+// \note The channels and subcarriers must outlive the pipeline
+MPXPipeline::MPXPipeline(const Options& options, std::vector<std::unique_ptr<Channel>>& channels,
+                         std::vector<std::unique_ptr<SubcarrierSet>>& subcarriers)
+    : options_(options),
+      channels_(channels),
+      subcarriers_(subcarriers),
+      num_data_streams_(options.streams ? 4 : 1),
+      decoder_progress_(channels.size()),
+      num_bits_demodulated_(channels.size()) {
+  for (std::size_t i = 0; i < kNumSlots; i++) {
+    chunk_slots_.push_back(std::make_unique<ChunkSlot>());
+    bits_slots_.push_back(std::make_unique<BitsSlot>());
+    text_slots_.push_back(std::make_unique<TextSlot>());
+
+    free_chunks_.push(chunk_slots_.back().get());
+    free_bits_.push(bits_slots_.back().get());
+    free_texts_.push(text_slots_.back().get());
+  }
+}
+
+// \brief Decode the whole input. The calling thread becomes the reader.
+void MPXPipeline::run(MPXReader& mpx, std::ostream& output_ostream) {
+  std::thread dsp_thread([this] { dspStage(); });
+  std::thread decoder_thread([this] { decoderStage(); });
+  std::thread writer_thread([this, &output_ostream] { writerStage(output_ostream); });
+
+  readerStage(mpx);
+
+  dsp_thread.join();
+  decoder_thread.join();
+  writer_thread.join();
+}
+
+// Queue depths show where the bottleneck is: the ring in front of the slowest stage fills up.
+void MPXPipeline::printStats(std::ostream& stats_ostream) const {
+  stats_ostream << "redsea: pipeline queue depth (peak/capacity):";
+  printRingStats("dsp", to_dsp_, stats_ostream);
+  printRingStats("decoder", to_decoder_, stats_ostream);
+  printRingStats("writer", to_writer_, stats_ostream);
+  stats_ostream << '\n';
+}
+
+void MPXPipeline::readerStage(MPXReader& mpx) {
+  while (!mpx.eof()) {
+    for (std::uint32_t ch = 0; ch < channels_.size(); ch++) {
+      ChunkSlot* slot = free_chunks_.pop();
+      slot->channel   = ch;
+      slot->is_last   = false;
+      if (options_.fixed_point)
+        copyChunk(mpx.readChunkS16(ch), slot->chunk_s16);
+      else
+        copyChunk(mpx.readChunk(ch), slot->chunk);
+      to_dsp_.push(slot);
+    }
+  }
+
+  ChunkSlot* slot = free_chunks_.pop();
+  slot->is_last   = true;
+  to_dsp_.push(slot);
+}
+
+void MPXPipeline::dspStage() {
+  while (true) {
+    ChunkSlot* chunk_slot = to_dsp_.pop();
+    BitsSlot* bits_slot   = free_bits_.pop();
+    bits_slot->is_last    = chunk_slot->is_last;
+
+    if (!chunk_slot->is_last) {
+      const std::uint32_t ch = chunk_slot->channel;
+      auto& subcarriers      = *subcarriers_[ch];
+
+      // Same condition as in the serial loop, which checks it after the previous chunk
+      bits_slot->is_reset = subcarriers.getSecondsSinceLastReset() > 5.f && isResetDue(ch);
+      if (bits_slot->is_reset)
+        subcarriers.reset();
+
+      bits_slot->channel = ch;
+      if (options_.fixed_point)
+        subcarriers.chunkToBits(chunk_slot->chunk_s16, num_data_streams_, bits_slot->bits);
+      else
+        subcarriers.chunkToBits(chunk_slot->chunk, num_data_streams_, bits_slot->bits);
+      num_bits_demodulated_[ch] += bits_slot->bits.bits[0].size();
+    }
+
+    const bool is_last = chunk_slot->is_last;
+    free_chunks_.push(chunk_slot);
+    to_decoder_.push(bits_slot);
+    if (is_last)
+      return;
+  }
+}
+
+// \brief Has the carrier been lost for over 10 seconds, as of the last chunk the DSP stage passed
+//        on for this channel? Called by the DSP stage.
+//
+// The count of bits since the carrier was lost goes up by at most one per bit, or back to zero.
+// So the decoder's last published count, plus the bits it hasn't got to yet, is an upper bound.
+// Only when the bound is over the limit do we need to wait for the decoder to catch up.
+bool MPXPipeline::isResetDue(std::uint32_t ch) {
+  // Same arithmetic as Channel::getSecondsSinceCarrierLost()
+  auto isOverLimit = [](std::uint64_t num_bits) {
+    return static_cast<float>(num_bits) / kBitsPerSecond > 10.f;
+  };
+
+  std::unique_lock<std::mutex> lock(progress_mutex_);
+  const DecoderProgress& progress = decoder_progress_[ch];
+  const std::uint64_t num_bits_pending = num_bits_demodulated_[ch] - progress.num_bits;
+  if (!isOverLimit(progress.num_bits_since_sync_lost + num_bits_pending))
+    return false;
+
+  progress_made_.wait(lock, [&] { return progress.num_bits == num_bits_demodulated_[ch]; });
+  return isOverLimit(progress.num_bits_since_sync_lost);
+}
+
+void MPXPipeline::decoderStage() {
+  while (true) {
+    BitsSlot* bits_slot = to_decoder_.pop();
+    TextSlot* text_slot = free_texts_.pop();
+    text_slot->is_last  = bits_slot->is_last;
+
+    if (bits_slot->is_last) {
+      for (auto& channel : channels_) channel->flush(text_slot->text);
+    } else {
+      const std::uint32_t ch = bits_slot->channel;
+      auto& channel          = *channels_[ch];
+
+      if (bits_slot->is_reset)
+        channel.resetPI();
+
+      channel.processBits(bits_slot->bits, text_slot->text);
+      {
+        const std::lock_guard<std::mutex> lock(progress_mutex_);
+        decoder_progress_[ch].num_bits += bits_slot->bits.bits[0].size();
+        decoder_progress_[ch].num_bits_since_sync_lost = channel.getNumBitsSinceCarrierLost();
+      }
+      progress_made_.notify_one();
+    }
+
+    const bool is_last = bits_slot->is_last;
+    free_bits_.push(bits_slot);
+    to_writer_.push(text_slot);
+    if (is_last)
+      return;
+  }
+}
+
+void MPXPipeline::writerStage(std::ostream& output_ostream) {
+  while (true) {
+    TextSlot* slot = to_writer_.pop();
+
+    // Streaming an empty rdbuf() would set failbit on the output
+    if (slot->text.tellp() > 0) {
+      output_ostream << slot->text.rdbuf();
+      output_ostream.flush();
+    }
+    // Keeps the string's capacity
+    slot->text.str("");
+    slot->text.clear();
+
+    const bool is_last = slot->is_last;
+    free_texts_.push(slot);
+    if (is_last)
+      return;
+  }
+}
+
+}  // namespace redsea
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "src/channel.hh"
+#include "src/dsp/subcarrier.hh"
+#include "src/io/bitbuffer.hh"
+#include "src/io/input.hh"
+#include "src/options.hh"
+#include "src/util/spsc_ring.hh"
+
+namespace redsea {
+
+// \brief MPX decoding split into four threads: reader -> DSP -> decoder -> writer.
+//
+// The stages pass fixed sets of buffers around in lock-free rings, and return them upstream when
+// done, so nothing is allocated per chunk. A slow consumer of the output only stalls the writer,
+// until all the buffers in between have filled up.
+class MPXPipeline {
+ public:
+  MPXPipeline(const Options& options, std::vector<std::unique_ptr<Channel>>& channels,
+              std::vector<std::unique_ptr<SubcarrierSet>>& subcarriers);
+  void run(MPXReader& mpx, std::ostream& output_ostream);
+  void printStats(std::ostream& stats_ostream) const;
+
+  static constexpr std::size_t kNumSlots = 32;
+
+ private:
+  // One channel's worth of one input chunk
+  struct ChunkSlot {
+    std::uint32_t channel{};
+    bool is_last{};
+    MPXBuffer chunk;
+    MPXBufferS16 chunk_s16;
+  };
+  struct BitsSlot {
+    std::uint32_t channel{};
+    bool is_last{};
+    // The subcarriers were reset before this chunk; the decoder forgets the PI
+    bool is_reset{};
+    BitBuffer bits;
+  };
+  // How far the decoder has got with one channel, as of the end of a chunk
+  struct DecoderProgress {
+    // Bits of data stream 0, all chunks so far
+    std::uint64_t num_bits{};
+    std::uint32_t num_bits_since_sync_lost{};
+  };
+  struct TextSlot {
+    bool is_last{};
+    std::ostringstream text;
+  };
+
+  template <typename Slot>
+  using Ring = SPSCRing<Slot*, kNumSlots>;
+
+  void readerStage(MPXReader& mpx);
+  void dspStage();
+  void decoderStage();
+  void writerStage(std::ostream& output_ostream);
+  bool isResetDue(std::uint32_t ch);
+
+  Options options_;
+  std::vector<std::unique_ptr<Channel>>& channels_;
+  std::vector<std::unique_ptr<SubcarrierSet>>& subcarriers_;
+  int num_data_streams_{1};
+
+  std::vector<std::unique_ptr<ChunkSlot>> chunk_slots_;
+  std::vector<std::unique_ptr<BitsSlot>> bits_slots_;
+  std::vector<std::unique_ptr<TextSlot>> text_slots_;
+
+  Ring<ChunkSlot> to_dsp_;
+  Ring<ChunkSlot> free_chunks_;
+  Ring<BitsSlot> to_decoder_;
+  Ring<BitsSlot> free_bits_;
+  Ring<TextSlot> to_writer_;
+  Ring<TextSlot> free_texts_;
+
+  // The carrier-lost reset needs state from both the DSP and the decoder stage, and it has to
+  // happen before the same chunk as in the serial loop. The decoder publishes its progress; the
+  // DSP stage, which may be several chunks ahead, only waits for it when a reset is possible.
+  std::mutex progress_mutex_;
+  std::condition_variable progress_made_;
+  std::vector<DecoderProgress> decoder_progress_;
+  // DSP stage only: bits of data stream 0 passed to the decoder so far
+  std::vector<std::uint64_t> num_bits_demodulated_;
+};
+
+}  // namespace redsea
+
+#endif  // PIPELINE_H_
@@ -15,18 +15,26 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  *
  */
+#include <algorithm>
+#include <csignal>
 #include <cstdint>
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <thread>
 #include <vector>
 
 #include "config.h"
 #include "src/channel.hh"
+#include "src/dsp/simd.hh"
 #include "src/dsp/subcarrier.hh"
 #include "src/group.hh"
+#include "src/io/bitbuffer.hh"
 #include "src/io/input.hh"
 #include "src/options.hh"
+#include "src/pipeline.hh"
+#include "src/util/thread_pool.hh"
 
 namespace {
 
@@ -38,21 +46,38 @@ void printUsage() {
          "From raw PCM file: redsea -r <samplerate> < raw_pcm_file.raw\n\n"
          "-b, --input-bits       (for backwards compatibility)\n"
          "\n"
+         "--channelize           Split wideband IQ input (--input-format cu8, cs16, or\n"
+         "                       cf32) into 200 kHz channels and decode all of them. The\n"
+         "                       IQ rate must be a multiple of 400 kHz, up to 6.4 MHz\n"
+         "                       (32 channels). Channel N is centered\n"
+         "                       (N - rate / 400 kHz) * 200 kHz from the center of the\n"
+         "                       band.\n"
+         "\n"
          "-c, --channels CHANS   Number of channels in the raw input signal. Channels are\n"
          "                       interleaved streams of samples that are demodulated\n"
          "                       independently.\n"
          "\n"
          "-e, --feed-through     Echo the input signal to stdout and print decoded groups\n"
-         "                       to stderr. This only works for raw PCM.\n"
+         "                       to stderr. This only works for raw PCM, not for IQ\n"
+         "                       input. The input bytes are passed through unchanged.\n"
          "\n"
          "-E, --bler             Display the average block error rate, or the percentage\n"
          "                       of blocks that had errors before error correction.\n"
          "                       Averaged over the last 12 groups. For hex input, this is\n"
          "                       the percentage of missing blocks.\n"
          "\n"
+         "--fft-frontend         Extract the RDS subcarriers with one FFT per block,\n"
+         "                       shared by all data streams, instead of mixing and\n"
+         "                       filtering each one separately. Faster with --streams.\n"
+         "\n"
          "-f, --file FILENAME    Read MPX input from a wave file with headers (.wav,\n"
          "                       .flac, ...). If you have headered wave data via stdin,\n"
          "                       use '-'. Or you can specify another format with --input.\n"
+         "                       With --input mpx, the file is read as raw PCM.\n"
+         "\n"
+         "--fixed-point          Demodulate MPX using integer arithmetic up to the\n"
+         "                       subcarrier filters. Faster on some embedded CPUs. Only\n"
+         "                       for input at 171000 Hz.\n"
          "\n"
          "-h, --input-hex        (for backwards compatibility)\n"
          "\n"
@@ -62,16 +87,42 @@ void printUsage() {
          "characters\n"
          "                              but '0' and '1' are ignored.\n"
          "                         hex  RDS Spy hex format. (Timestamps will be ignored)\n"
-         "                         mpx  MPX as raw mono S16LE PCM. Remember to also specify\n"
-         "                              --samplerate. If you're reading from a sound file with "
-         "headers\n"
-         "                              (WAV, FLAC, ...) don't specify this.\n"
+         "                         mpx  MPX as raw PCM (S16LE unless --input-format).\n"
+         "                              Remember to also specify --samplerate. If you're\n"
+         "                              reading from a sound file with headers (WAV, FLAC,\n"
+         "                              ...) don't specify this.\n"
          "                         tef  Serial data from the TEF6686 tuner.\n"
          "\n"
+         "--input-format FORMAT  Sample format of raw MPX input (--input mpx):\n"
+         "                         s16le Signed 16-bit little-endian (default).\n"
+         "                         s8    Signed 8-bit.\n"
+         "                         u8    Unsigned 8-bit.\n"
+         "                         f32le 32-bit float little-endian.\n"
+         "                       Or complex baseband (IQ) from a receiver tuned to one\n"
+         "                       station, FM demodulated by redsea; --samplerate is then\n"
+         "                       the IQ sample rate:\n"
+         "                         cu8   Unsigned 8-bit (e.g. rtl_sdr).\n"
+         "                         cs16  Signed 16-bit little-endian.\n"
+         "                         cf32  32-bit float little-endian.\n"
+         "\n"
+         "--io-uring             Read raw MPX from stdin ahead of the demodulator with\n"
+         "                       io_uring (Linux). Helps when stdin is a slow disk.\n"
+         "\n"
          "-l, --loctable DIR     Load TMC location table from a directory in TMC Exchange\n"
          "                       format. This option can be specified multiple times to\n"
          "                       load several location tables.\n"
          "\n"
+         "--lockstep             Demodulate the channels of a multi-channel signal side by\n"
+         "                       side, several channels per SIMD instruction. Decodes\n"
+         "                       many channels on one core.\n"
+         "\n"
+         "--max-burst-length N   Correct bursts of up to N bit errors per block (1 to 5;\n"
+         "                       default 2). Longer bursts get more blocks through in\n"
+         "                       noisy conditions, but also more errors.\n"
+         "\n"
+         "--native-demod         Use redsea's own AGC, carrier phase detector, and symbol\n"
+         "                       timing recovery instead of the ones from liquid-dsp.\n"
+         "\n"
          "--no-fec               Disable forward error correction; always reject blocks\n"
          "                       with incorrect syndromes. In noisy conditions, fewer errors\n"
          "                       will slip through, but also fewer blocks in total. See wiki\n"
@@ -81,6 +132,17 @@ void printUsage() {
          "                         hex  RDS Spy hex format.\n"
          "                         json Newline-delimited JSON (default).\n"
          "\n"
+         "--parallel-streams     With --streams, demodulate RDS2 data streams 1, 2, and 3\n"
+         "                       on up to 3 extra threads, shared by all channels. Can't\n"
+         "                       be used together with --threads.\n"
+         "\n"
+         "--pipeline             Read, demodulate, decode, and print in separate threads,\n"
+         "                       so that a slow reader of the output doesn't hold up the\n"
+         "                       demodulator.\n"
+         "\n"
+         "--pipeline-stats       Like --pipeline, and print the peak depth of each stage's\n"
+         "                       input queue to stderr at the end.\n"
+         "\n"
          "-p, --show-partial     Under noisy conditions, redsea may not be able to fully\n"
          "                       receive all information. Multi-group data such as PS\n"
          "                       names, RadioText, and alternative frequencies are\n"
@@ -92,6 +154,10 @@ void printUsage() {
          "\n"
          "-R, --show-raw         Include raw group data as hex in the JSON stream.\n"
          "\n"
+         "--soft-fec             Use the demodulator's confidence in each bit to correct\n"
+         "                       blocks that burst error correction can't, by flipping\n"
+         "                       their least reliable bits. Only for MPX input.\n"
+         "\n"
          "-s, --streams          Decode RDS2 data streams 1, 2, and 3, if they exist.\n"
          "\n"
          "-t, --timestamp FORMAT Add time of decoding to JSON groups; see man strftime\n"
@@ -102,6 +168,10 @@ void printUsage() {
          "                       the group was read in by redsea; see \"Time and timestamps\"\n"
          "                       in the wiki for more.\n"
          "\n"
+         "--threads N            Decode the channels of a multi-channel signal in\n"
+         "                       parallel on N threads. The output is the same as with\n"
+         "                       one thread.\n"
+         "\n"
          "--time-from-start      Add the stream (file) position, in seconds, to each\n"
          "                       group. It works only for MPX input and represents the\n"
          "                       number of seconds from the beginning of the file until\n"
@@ -124,6 +194,7 @@ void printVersion() {
 #else
   std::cout << "redsea " << VERSION << " by OH2EIQ" << '\n';
 #endif
+  std::cout << "DSP instruction set: " << redsea::getSIMDInstructionSet() << '\n';
 }
 
 // \brief Process MPX from stdin or a file
@@ -148,6 +219,16 @@ int processMPXInput(redsea::Options options) {
   auto& output_ostream = options.feed_thru ? std::cerr : std::cout;
 
   const int num_data_streams = options.streams ? 4 : 1;
+  const bool use_lockstep    = options.lockstep && !options.fixed_point && !options.pipeline;
+
+  // The channels are demodulated one after another, so they can all share one pool for their
+  // data streams 1..3. No more workers than there are spare cores.
+  std::unique_ptr<redsea::ThreadPool> stream_pool;
+  if (options.streams && options.parallel_streams && !use_lockstep) {
+    const std::uint32_t num_cores = std::thread::hardware_concurrency();
+    stream_pool = std::make_unique<redsea::ThreadPool>(
+        std::clamp(num_cores, std::uint32_t{2}, std::uint32_t{4}) - 1);
+  }
 
   // Each PCM channel is matched with 1 subcarrier set
   std::vector<std::unique_ptr<redsea::Channel>> channels;
@@ -155,17 +236,88 @@ int processMPXInput(redsea::Options options) {
   for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
     channels.emplace_back(std::make_unique<redsea::Channel>(options, ch));
     subcarriers.push_back(std::make_unique<redsea::SubcarrierSet>(options.samplerate));
+    if (stream_pool != nullptr)
+      subcarriers.back()->enableParallelStreams(*stream_pool);
+    if (options.fft_front_end && !options.fixed_point && !use_lockstep)
+      subcarriers.back()->enableFFTFrontEnd();
+    if (options.native_demod)
+      subcarriers.back()->enableNativeDemod();
+  }
+
+  // Reused for every chunk
+  std::vector<redsea::BitBuffer> bitbuffers(options.num_channels);
+
+  auto decodeChunk = [&](std::uint32_t ch, const auto& chunk, std::ostream& ostream) {
+    subcarriers[ch]->chunkToBits(chunk, num_data_streams, bitbuffers[ch]);
+    channels[ch]->processBits(bitbuffers[ch], ostream);
+    if (channels[ch]->getSecondsSinceCarrierLost() > 10.f &&
+        subcarriers[ch]->getSecondsSinceLastReset() > 5.f) {
+      subcarriers[ch]->reset();
+      channels[ch]->resetPI();
+    }
+  };
+
+  const std::uint32_t num_threads = std::min(options.num_threads, options.num_channels);
+
+  if (options.pipeline) {
+    redsea::MPXPipeline pipeline(options, channels, subcarriers);
+    pipeline.run(mpx, output_ostream);
+    if (options.pipeline_stats)
+      pipeline.printStats(std::cerr);
+    return EXIT_SUCCESS;
   }
 
-  while (!mpx.eof()) {
-    for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
-      const auto bits = subcarriers[ch]->chunkToBits(mpx.readChunk(ch), num_data_streams);
-      channels[ch]->processBits(bits, output_ostream);
-      if (channels[ch]->getSecondsSinceCarrierLost() > 10.f &&
-          subcarriers[ch]->getSecondsSinceLastReset() > 5.f) {
-        subcarriers[ch]->reset();
-        channels[ch]->resetPI();
+  if (use_lockstep) {
+    redsea::LockstepDemodulator demodulator(subcarriers, num_data_streams);
+    std::vector<const redsea::MPXBuffer*> chunks(options.num_channels);
+
+    while (!mpx.eof()) {
+      for (std::uint32_t ch = 0; ch < options.num_channels; ch++) chunks[ch] = &mpx.readChunk(ch);
+      demodulator.chunksToBits(chunks, bitbuffers);
+
+      for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
+        channels[ch]->processBits(bitbuffers[ch], output_ostream);
+        if (channels[ch]->getSecondsSinceCarrierLost() > 10.f &&
+            subcarriers[ch]->getSecondsSinceLastReset() > 5.f) {
+          demodulator.reset(ch);
+          channels[ch]->resetPI();
+        }
+      }
+    }
+  } else if (num_threads <= 1) {
+    while (!mpx.eof()) {
+      for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
+        if (options.fixed_point)
+          decodeChunk(ch, mpx.readChunkS16(ch), output_ostream);
+        else
+          decodeChunk(ch, mpx.readChunk(ch), output_ostream);
+      }
+    }
+  } else {
+    // Each channel is a task. The reader splits the whole input chunk into channels at once, and
+    // the chunks stay valid until the next read, so the tasks can use them directly. Output is
+    // collected per channel and printed in channel order, which makes it identical to the
+    // single-threaded output.
+    redsea::ThreadPool pool(num_threads);
+    std::vector<std::ostringstream> channel_outputs(options.num_channels);
+
+    while (!mpx.eof()) {
+      for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
+        if (options.fixed_point) {
+          const auto* chunk = &mpx.readChunkS16(ch);
+          pool.submit([&, ch, chunk] { decodeChunk(ch, *chunk, channel_outputs[ch]); });
+        } else {
+          const auto* chunk = &mpx.readChunk(ch);
+          pool.submit([&, ch, chunk] { decodeChunk(ch, *chunk, channel_outputs[ch]); });
+        }
       }
+      pool.wait();
+
+      for (auto& channel_output : channel_outputs) {
+        output_ostream << channel_output.str();
+        channel_output.str("");
+      }
+      output_ostream.flush();
     }
   }
 
@@ -242,6 +394,13 @@ int main(int argc, char** argv) {
     return options.init_error ? EXIT_FAILURE : EXIT_SUCCESS;
   }
 
+#ifdef SIGPIPE
+  // The decoded output goes to stderr with --feed-through, so keep decoding even if whoever reads
+  // the passed-through input from stdout goes away; the failed writes are ignored instead
+  if (options.feed_thru)
+    static_cast<void>(std::signal(SIGPIPE, SIG_IGN));
+#endif
+
   switch (options.input_type) {
     case redsea::InputType::MPX_raw_stdin: return processMPXInput(options);
     case redsea::InputType::MPX_container: return processMPXInput(options);
@@ -60,7 +60,8 @@ std::string_view getRDSCharString(std::uint8_t code) {
 
 // \throws Conversion errors from iconvpp
 std::string decodeUCS2(const std::string& src) {
-  static iconvpp::converter converter("UTF-8", "UCS-2");
+  // iconv descriptors have internal state
+  thread_local iconvpp::converter converter("UTF-8", "UCS-2");
 
   std::string dst;
   converter.convert(src, dst);
@@ -69,10 +69,6 @@ std::string_view getUrgencyString(EventUrgency u) {
   return "none";
 }
 
-bool isEventDataEmpty() {
-  return g_event_db.empty();
-}
-
 void loadEventData() {
   const CSVTable table{readCSVContainerWithTitles(tmc_raw_data_events, ';')};
 
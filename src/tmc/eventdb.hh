@@ -86,7 +86,6 @@ std::string_view getUrgencyString(EventUrgency u);
 extern const std::array<std::string_view, 1553> tmc_raw_data_events;
 extern const std::array<std::string_view, 233> tmc_raw_data_suppl;
 
-bool isEventDataEmpty();
 void loadEventData();
 
 }  // namespace redsea::tmc
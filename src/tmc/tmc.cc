@@ -24,6 +24,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -41,6 +42,14 @@ namespace {
 
 std::map<std::uint16_t, LocationDatabase> g_location_databases;
 
+// Read-only lookup; channels may be decoded in parallel
+const LocationDatabase& getLocationDatabase(std::uint16_t ltn) {
+  static const LocationDatabase empty_database;
+
+  const auto db = g_location_databases.find(ltn);
+  return db == g_location_databases.end() ? empty_database : db->second;
+}
+
 std::vector<std::string> getScopeStrings(std::uint16_t mgs) {
   const bool mgs_i{getBool(mgs, 3)};
   const bool mgs_n{getBool(mgs, 2)};
@@ -148,8 +157,8 @@ void TMCService::receiveSystemGroup(std::uint16_t message, ObjectTree& out) {
   const auto variant = getBits<2>(message, 14);
 
   if (variant == 0) {
-    if (isEventDataEmpty())
-      loadEventData();
+    static std::once_flag event_data_loaded;
+    std::call_once(event_data_loaded, loadEventData);
 
     is_initialized_ = true;
     const auto ltn  = getBits<6>(message, 6);
@@ -294,7 +303,7 @@ void TMCService::receiveUserGroup(std::uint16_t x, std::uint16_t y, std::uint16_
 
       if (!single_message.tree().empty()) {
         out["tmc"]["message"] = single_message.tree();
-        decodeLocation(g_location_databases[ltn_], single_message, ltn_, out);
+        decodeLocation(getLocationDatabase(ltn_), single_message, ltn_, out);
       }
 
       // Part of multi-group message
@@ -311,7 +320,7 @@ void TMCService::receiveUserGroup(std::uint16_t x, std::uint16_t y, std::uint16_
 
         if (!message_.tree().empty()) {
           out["tmc"]["message"] = message_.tree();
-          decodeLocation(g_location_databases[ltn_], message_, ltn_, out);
+          decodeLocation(getLocationDatabase(ltn_), message_, ltn_, out);
         }
         message_ = Message(is_encrypted_);
       }
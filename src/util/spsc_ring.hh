@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef UTIL_SPSC_RING_H_
+#define UTIL_SPSC_RING_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace redsea {
+
+// \brief Bounded lock-free queue between exactly one producer thread and one consumer thread.
+//
+// The transfer itself is lock-free. When the ring is full or empty, push() and pop() spin for a
+// short while and then sleep on a condition variable until the other side makes progress, so
+// that threads waiting on a slow live input (e.g. rtl_fm) don't burn CPU. The mutex is only
+// touched when the other side has announced that it's sleeping. The producer also keeps track
+// of how full the ring has been, so that a slow consumer can be spotted.
+template <typename T, std::size_t Capacity>
+class SPSCRing {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+ public:
+  SPSCRing() = default;
+
+  // Producer side
+  bool tryPush(const T& item) {
+    if (!pushSlot(item))
+      return false;
+
+    wake(consumer_waiting_, not_empty_);
+    return true;
+  }
+
+  void push(const T& item) {
+    if (tryPush(item))
+      return;
+
+    num_full_.fetch_add(1, std::memory_order_relaxed);
+    for (int spin = 0; spin < kNumSpins; ++spin) {
+      if (tryPush(item))
+        return;
+      std::this_thread::yield();
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      producer_waiting_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      not_full_.wait(lock, [&] { return pushSlot(item); });
+      producer_waiting_.store(false, std::memory_order_relaxed);
+    }
+    wake(consumer_waiting_, not_empty_);
+  }
+
+  // Consumer side
+  bool tryPop(T& item) {
+    if (!popSlot(item))
+      return false;
+
+    wake(producer_waiting_, not_full_);
+    return true;
+  }
+
+  T pop() {
+    T item{};
+    if (tryPop(item))
+      return item;
+
+    for (int spin = 0; spin < kNumSpins; ++spin) {
+      if (tryPop(item))
+        return item;
+      std::this_thread::yield();
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      consumer_waiting_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      not_empty_.wait(lock, [&] { return popSlot(item); });
+      consumer_waiting_.store(false, std::memory_order_relaxed);
+    }
+    wake(producer_waiting_, not_full_);
+    return item;
+  }
+
+  // Approximate when called during a transfer
+  [[nodiscard]] std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+  [[nodiscard]] static constexpr std::size_t capacity() {
+    return Capacity;
+  }
+  // Highest number of items that has been waiting in the ring
+  [[nodiscard]] std::size_t getPeakDepth() const {
+    return peak_depth_.load(std::memory_order_relaxed);
+  }
+  // How many times the producer had to wait for room
+  [[nodiscard]] std::uint64_t getNumTimesFull() const {
+    return num_full_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // How many times push() or pop() retries before going to sleep
+  static constexpr int kNumSpins = 64;
+
+  bool pushSlot(const T& item) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t depth = tail - head_.load(std::memory_order_acquire);
+    if (depth == Capacity)
+      return false;
+
+    slots_[tail & (Capacity - 1)] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+
+    if (depth + 1 > peak_depth_.load(std::memory_order_relaxed))
+      peak_depth_.store(depth + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool popSlot(T& item) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+
+    item = slots_[head & (Capacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pairs with the fence in push()/pop(): either the sleeper sees our update before it waits,
+  // or we see its flag and notify it. Never called with mutex_ held.
+  void wake(const std::atomic<bool>& waiting, std::condition_variable& cv) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)) {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      cv.notify_one();
+    }
+  }
+
+  std::array<T, Capacity> slots_{};
+  // Written by the consumer only; on its own cache line so the two sides don't false-share
+  alignas(64) std::atomic<std::size_t> head_{0};
+  // Written by the producer only
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  std::atomic<std::size_t> peak_depth_{0};
+  std::atomic<std::uint64_t> num_full_{0};
+
+  // Only used when one side sleeps
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::atomic<bool> producer_waiting_{false};
+  std::atomic<bool> consumer_waiting_{false};
+};
+
+}  // namespace redsea
+
+#endif  // UTIL_SPSC_RING_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/util/thread_pool.hh"
+
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace redsea {
+
+ThreadPool::ThreadPool(std::size_t num_threads) {
+  assert(num_threads >= 1);
+
+  for (std::size_t i = 0; i < num_threads; i++) {
+    queues_.push_back(std::make_unique<TaskQueue>());
+  }
+  for (std::size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back([this, i] { runWorker(i); });
+  }
+}
+
+// Waits for the queued tasks to finish
+ThreadPool::~ThreadPool() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  work_available_.notify_all();
+
+  for (auto& worker : workers_) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& queue = *queues_[next_queue_];
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+    {
+      const std::lock_guard<std::mutex> queue_lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+
+    num_queued_++;
+    num_unfinished_++;
+  }
+  work_available_.notify_one();
+}
+
+// \brief Block until all submitted tasks have finished.
+// \throws The first exception thrown by a task, if any
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] { return num_unfinished_ == 0; });
+
+  if (exception_) {
+    std::rethrow_exception(std::exchange(exception_, nullptr));
+  }
+}
+
+std::size_t ThreadPool::getNumThreads() const {
+  return workers_.size();
+}
+
+// Own queue first (oldest task), then the other queues (newest task)
+bool ThreadPool::takeTask(std::size_t index, std::function<void()>& task) {
+  for (std::size_t i = 0; i < queues_.size(); i++) {
+    const bool is_own_queue = (i == 0);
+    auto& queue             = *queues_[(index + i) % queues_.size()];
+
+    const std::lock_guard<std::mutex> queue_lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+
+    if (is_own_queue) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    } else {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::runWorker(std::size_t index) {
+  while (true) {
+    std::function<void()> task;
+
+    if (takeTask(index, task)) {
+      {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        num_queued_--;
+      }
+
+      std::exception_ptr exception;
+      try {
+        task();
+      } catch (...) {
+        exception = std::current_exception();
+      }
+
+      bool is_all_done{};
+      {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        if (exception && !exception_)
+          exception_ = exception;
+        num_unfinished_--;
+        is_all_done = (num_unfinished_ == 0);
+      }
+      if (is_all_done)
+        all_done_.notify_all();
+
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_available_.wait(lock, [this] { return is_stopping_ || num_queued_ > 0; });
+    if (is_stopping_ && num_queued_ == 0)
+      return;
+  }
+}
+
+}  // namespace redsea
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#ifndef UTIL_THREAD_POOL_H_
+#define UTIL_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace redsea {
+
+// \brief A fixed set of worker threads with one task queue each.
+//
+// Tasks are spread over the queues round-robin. A worker takes tasks from the front of its own
+// queue, and when that runs dry, steals from the back of the others, so uneven tasks don't leave
+// threads idle.
+class ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t num_threads);
+  ThreadPool(const ThreadPool&)             = delete;
+  ThreadPool& operator=(const ThreadPool&)  = delete;
+  ThreadPool(ThreadPool&& other)            = delete;
+  ThreadPool& operator=(ThreadPool&& other) = delete;
+  ~ThreadPool();
+
+  void submit(std::function<void()> task);
+  void wait();
+  [[nodiscard]] std::size_t getNumThreads() const;
+
+ private:
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void runWorker(std::size_t index);
+  bool takeTask(std::size_t index, std::function<void()>& task);
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::size_t next_queue_{};
+
+  // Guards the counters below. Never held while locking a TaskQueue, except in submit().
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable all_done_;
+  // Submitted but not yet taken
+  std::size_t num_queued_{};
+  // Submitted but not yet finished
+  std::size_t num_unfinished_{};
+  bool is_stopping_{false};
+  // First exception thrown by a task since the last wait()
+  std::exception_ptr exception_;
+};
+
+}  // namespace redsea
+
+#endif  // UTIL_THREAD_POOL_H_
@@ -140,19 +140,24 @@ class RunningSum {
     clear();
   }
   T getSum() const {
-    return std::accumulate(history_.cbegin(), history_.cend(), T{0});
+    return sum_;
   }
   void push(int number) {
+    sum_ -= history_[pointer_];
     history_[pointer_] = number;
-    pointer_           = (pointer_ + 1) % history_.size();
+    sum_ += history_[pointer_];
+    pointer_ = (pointer_ + 1) % history_.size();
   }
   void clear() {
     std::fill(history_.begin(), history_.end(), T{0});
+    sum_ = T{0};
   }
 
  private:
   std::array<T, N> history_{};
   std::size_t pointer_{};
+  // Kept up to date in push(), so that getSum() doesn't have to add up the history
+  T sum_{};
 };
 
 template <typename T, std::size_t N>
@@ -0,0 +1,290 @@
+// Redsea tests: Benchmarks
+//
+// These are hidden from the default test run. Run them with:
+//   ./redsea-test "[benchmark]"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/block_sync.hh"
+#include "../src/dsp/subcarrier.hh"
+#include "../src/io/input.hh"
+#include "../src/options.hh"
+
+// Both Catch2 and liquid define a macro called DEPRECATED
+#ifdef DEPRECATED
+#pragma push_macro("DEPRECATED")
+#undef DEPRECATED
+#endif
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#ifdef DEPRECATED
+#pragma pop_macro("DEPRECATED")
+#endif
+
+namespace {
+
+// One full chunk of synthetic MPX: pilot tone and an unmodulated 57 kHz subcarrier
+std::unique_ptr<redsea::MPXBuffer> makeTestChunk(float samplerate) {
+  auto chunk       = std::make_unique<redsea::MPXBuffer>();
+  chunk->used_size = redsea::kInputChunkSize;
+  for (std::size_t i = 0; i < chunk->used_size; i++) {
+    const float t  = static_cast<float>(i) / samplerate;
+    chunk->data[i] = 0.1f * std::sin(k2Pi * 19000.f * t) + 0.05f * std::sin(k2Pi * 57000.f * t);
+  }
+  return chunk;
+}
+
+constexpr std::size_t kBitsPerBlock = 26;
+
+// A block that BlockStream received or corrected
+struct DecodedBlock {
+  redsea::eBlockNumber number;
+  std::uint16_t data;
+};
+
+// Blocks received (or corrected) in the groups of one data stream, by the sample position of
+// their last bit
+std::map<std::int32_t, DecodedBlock> decodeBlocks(const redsea::PackedBits& bits,
+                                                  const redsea::Options& options) {
+  redsea::BlockStream block_stream;
+  block_stream.init(options);
+
+  std::map<std::int32_t, DecodedBlock> blocks;
+  for (std::size_t i_bit = 0; i_bit < bits.size(); i_bit++) {
+    block_stream.pushBit(bits.get(i_bit), bits.getReliability(i_bit));
+    if (block_stream.hasGroupReady()) {
+      // The group is ready right after the last bit of its fourth block
+      const auto group = block_stream.popGroup();
+      for (const auto n : {redsea::BLOCK1, redsea::BLOCK2, redsea::BLOCK3, redsea::BLOCK4}) {
+        if (group.has(n)) {
+          const std::size_t i_last_bit = i_bit - (redsea::BLOCK4 - n) * kBitsPerBlock;
+          blocks[bits.getSamplePosition(i_last_bit)] = DecodedBlock{n, group.get(n)};
+        }
+      }
+    }
+  }
+  return blocks;
+}
+
+// Compares the blocks with those decoded from the clean signal at the same position
+struct BlockCount {
+  int num_correct{};
+  int num_wrong{};
+  // Not decoded from the clean signal, so can't tell
+  int num_unverified{};
+};
+
+BlockCount verifyBlocks(const std::map<std::int32_t, DecodedBlock>& blocks,
+                        const std::map<std::int32_t, DecodedBlock>& reference) {
+  // Noise can move the symbol clock a little
+  constexpr std::int32_t kTolerance = redsea::kSamplesPerBit / 2;
+
+  BlockCount count;
+  for (const auto& [position, block] : blocks) {
+    const auto match = reference.lower_bound(position - kTolerance);
+    if (match == reference.cend() || match->first > position + kTolerance ||
+        match->second.number != block.number)
+      count.num_unverified++;
+    else if (match->second.data == block.data)
+      count.num_correct++;
+    else
+      count.num_wrong++;
+  }
+  return count;
+}
+
+// Demodulate data stream 0 of the chunks, with white noise added, into one PackedBits with sample
+// positions counted from the start of the signal
+redsea::PackedBits demodulateWithNoise(const std::vector<std::vector<float>>& clean_chunks,
+                                       float samplerate, float noise_level) {
+  std::mt19937 rng(1234);
+  std::normal_distribution<float> noise(0.f, noise_level);
+
+  redsea::SubcarrierSet subcarriers(samplerate);
+  redsea::BitBuffer bits;
+  redsea::PackedBits all_bits;
+  auto chunk = std::make_unique<redsea::MPXBuffer>();
+  // At 171 kHz
+  double chunk_start{};
+  for (const auto& clean_chunk : clean_chunks) {
+    chunk->used_size = clean_chunk.size();
+    for (std::size_t i = 0; i < chunk->used_size; i++)
+      chunk->data[i] = clean_chunk[i] + (noise_level > 0.f ? noise(rng) : 0.f);
+
+    subcarriers.chunkToBits(*chunk, 1, bits);
+    for (std::size_t i_bit = 0; i_bit < bits.bits[0].size(); i_bit++) {
+      all_bits.push(bits.bits[0].get(i_bit),
+                    static_cast<std::int32_t>(chunk_start) + bits.bits[0].getSamplePosition(i_bit),
+                    bits.bits[0].getReliability(i_bit));
+    }
+    chunk_start += static_cast<double>(chunk->used_size) * redsea::kTargetSampleRate_Hz / samplerate;
+  }
+  return all_bits;
+}
+
+}  // namespace
+
+// Each benchmark processes kInputChunkSize samples (48 ms of signal at 171 kHz)
+TEST_CASE("MPX demodulation throughput", "[.][benchmark]") {
+  const auto chunk = makeTestChunk(redsea::kTargetSampleRate_Hz);
+  auto subcarriers = std::make_unique<redsea::SubcarrierSet>(redsea::kTargetSampleRate_Hz);
+  redsea::BitBuffer bits;
+
+  BENCHMARK("chunkToBits, 171 kHz, 1 data stream") {
+    subcarriers->chunkToBits(*chunk, 1, bits);
+    return bits.bits[0].size();
+  };
+
+  BENCHMARK("chunkToBits, 171 kHz, 4 data streams") {
+    subcarriers->chunkToBits(*chunk, 4, bits);
+    return bits.bits[0].size();
+  };
+
+  auto fft_subcarriers = std::make_unique<redsea::SubcarrierSet>(redsea::kTargetSampleRate_Hz);
+  fft_subcarriers->enableFFTFrontEnd();
+
+  BENCHMARK("chunkToBits, 171 kHz, 1 data stream, FFT front end") {
+    fft_subcarriers->chunkToBits(*chunk, 1, bits);
+    return bits.bits[0].size();
+  };
+
+  BENCHMARK("chunkToBits, 171 kHz, 4 data streams, FFT front end") {
+    fft_subcarriers->chunkToBits(*chunk, 4, bits);
+    return bits.bits[0].size();
+  };
+
+  auto native_subcarriers = std::make_unique<redsea::SubcarrierSet>(redsea::kTargetSampleRate_Hz);
+  native_subcarriers->enableNativeDemod();
+
+  BENCHMARK("chunkToBits, 171 kHz, 1 data stream, native demodulator") {
+    native_subcarriers->chunkToBits(*chunk, 1, bits);
+    return bits.bits[0].size();
+  };
+}
+
+TEST_CASE("Multi-channel demodulation throughput", "[.][benchmark]") {
+  constexpr std::size_t kNumChannels{32};
+  const auto chunk = makeTestChunk(redsea::kTargetSampleRate_Hz);
+  const std::vector<const redsea::MPXBuffer*> chunks(kNumChannels, chunk.get());
+  std::vector<redsea::BitBuffer> bitbuffers(kNumChannels);
+
+  std::vector<std::unique_ptr<redsea::SubcarrierSet>> subcarriers;
+  for (std::size_t ch = 0; ch < kNumChannels; ch++)
+    subcarriers.push_back(std::make_unique<redsea::SubcarrierSet>(redsea::kTargetSampleRate_Hz));
+
+  BENCHMARK("chunkToBits, 32 channels one by one, 1 data stream") {
+    for (std::size_t ch = 0; ch < kNumChannels; ch++)
+      subcarriers[ch]->chunkToBits(*chunks[ch], 1, bitbuffers[ch]);
+    return bitbuffers[0].bits[0].size();
+  };
+
+  redsea::LockstepDemodulator demodulator(subcarriers, 1);
+
+  BENCHMARK("chunksToBits, 32 channels in lockstep, 1 data stream") {
+    demodulator.chunksToBits(chunks, bitbuffers);
+    return bitbuffers[0].bits[0].size();
+  };
+}
+
+TEST_CASE("MPX resampling throughput", "[.][benchmark]") {
+  for (const float samplerate : {192'000.f, 2'400'000.f}) {
+    const auto chunk = makeTestChunk(samplerate);
+    auto subcarriers = std::make_unique<redsea::SubcarrierSet>(samplerate);
+    redsea::BitBuffer bits;
+
+    const std::string name =
+        "chunkToBits, " + std::to_string(static_cast<int>(samplerate)) + " Hz, 1 data stream";
+
+    BENCHMARK(name.c_str()) {
+      subcarriers->chunkToBits(*chunk, 1, bits);
+      return bits.bits[0].size();
+    };
+  }
+}
+
+TEST_CASE("Channel deinterleaving throughput", "[.][benchmark]") {
+  for (const std::uint32_t num_channels : {2U, 8U, 32U}) {
+    auto interleaved       = std::make_unique<redsea::MPXBuffer>();
+    interleaved->used_size = (redsea::kInputChunkSize / num_channels) * num_channels;
+    std::vector<redsea::MPXBuffer> channels(num_channels);
+
+    const std::string name = "deinterleave, " + std::to_string(num_channels) + " channels";
+
+    BENCHMARK(name.c_str()) {
+      redsea::deinterleave(*interleaved, num_channels, channels);
+      return channels[0].used_size;
+    };
+  }
+}
+
+TEST_CASE("Block synchronization throughput", "[.][benchmark]") {
+  // Pseudo-random bits never sync, so the syndrome is checked after every bit
+  std::vector<bool> bits(10'000);
+  std::uint32_t lfsr{0xACE1U};
+  for (auto&& bit : bits) {
+    lfsr = (lfsr >> 1U) ^ (-(lfsr & 1U) & 0xB400U);
+    bit  = (lfsr & 1U) != 0;
+  }
+
+  redsea::BlockStream block_stream;
+  block_stream.init(redsea::Options{});
+
+  BENCHMARK("BlockStream::pushBit, 10000 bits out of sync") {
+    for (const bool bit : bits) block_stream.pushBit(bit);
+    return block_stream.hasGroupReady();
+  };
+}
+
+// Not a timing benchmark: measures how many more blocks get through with --soft-fec, on a real
+// signal with added white noise, and how many of them are wrong. Blocks are checked against the
+// decode of the clean signal. The noise is seeded, so the numbers are repeatable.
+TEST_CASE("Soft-decision error correction gain", "[.][benchmark]") {
+  redsea::Options options;
+  options.sndfilename = "../test/resources/rds2-minirds-192k.flac";
+  options.input_type  = redsea::InputType::MPX_container;
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  const float samplerate = mpx.getSamplerate();
+
+  // Only the samples in use; the buffers have room for resampling
+  std::vector<std::vector<float>> clean_chunks;
+  while (!mpx.eof()) {
+    const auto& chunk = mpx.readChunk(0);
+    clean_chunks.emplace_back(chunk.data.cbegin(), chunk.data.cbegin() + chunk.used_size);
+  }
+
+  options.soft_fec     = false;
+  const auto reference = decodeBlocks(demodulateWithNoise(clean_chunks, samplerate, 0.f), options);
+  REQUIRE_FALSE(reference.empty());
+
+  for (const float noise_level : {0.05f, 0.1f, 0.15f, 0.2f, 0.25f}) {
+    // Demodulate once and decode the same bits with both settings
+    const auto bits = demodulateWithNoise(clean_chunks, samplerate, noise_level);
+
+    options.soft_fec = false;
+    const auto hard  = verifyBlocks(decodeBlocks(bits, options), reference);
+    options.soft_fec = true;
+    const auto soft  = verifyBlocks(decodeBlocks(bits, options), reference);
+
+    WARN("noise " << noise_level << ": " << hard.num_correct << " correct / " << hard.num_wrong
+                  << " wrong blocks without --soft-fec, " << soft.num_correct << " / "
+                  << soft.num_wrong << " with (" << hard.num_unverified << " / "
+                  << soft.num_unverified << " not in the clean decode)");
+
+    // The blocks that soft decoding adds should be about as trustworthy as burst-corrected ones
+    const int num_added_correct = soft.num_correct - hard.num_correct;
+    const int num_added_wrong   = soft.num_wrong - hard.num_wrong;
+    CHECK(num_added_wrong * 20 <= num_added_correct + num_added_wrong);
+  }
+}
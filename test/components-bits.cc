@@ -141,6 +141,68 @@ TEST_CASE("Error detection and correction") {
     CHECK_FALSE(groups.back().has(redsea::BLOCK1));
   }
 
+  SECTION("Corrects triple bit flip if longer bursts are allowed") {
+    options.max_burst_length = 3;
+
+    const std::string broken_group = [&]() {
+      std::string broken = correct_group;
+      flipAsciiBit(broken, 1);
+      flipAsciiBit(broken, 2);
+      flipAsciiBit(broken, 3);
+      return broken;
+    }();
+
+    const std::string test_data{correct_group + correct_group + broken_group};
+    const auto groups{asciibin2groups(test_data, options)};
+
+    REQUIRE_FALSE(groups.empty());
+    CHECK(groups.back().getNumErrors() == 1);
+    CHECK(groups.back().has(redsea::BLOCK1));
+    CHECK(groups.back().get(redsea::BLOCK1) == 0x22E1);
+  }
+
+  SECTION("Corrects scattered bit flips with soft-decision FEC") {
+    options.soft_fec = true;
+
+    const std::string broken_group = [&]() {
+      std::string broken = correct_group;
+      flipAsciiBit(broken, 1);
+      flipAsciiBit(broken, 7);
+      flipAsciiBit(broken, 14);
+      return broken;
+    }();
+
+    const std::string test_data{correct_group + correct_group + broken_group};
+    // One of the unsure bits was actually correct
+    const std::size_t start = 2 * correct_group.size();
+    const auto groups{
+        asciibin2groups(test_data, options, {start + 1, start + 7, start + 14, start + 20})};
+
+    REQUIRE_FALSE(groups.empty());
+    CHECK(groups.back().getNumErrors() == 1);
+    CHECK(groups.back().has(redsea::BLOCK1));
+    CHECK(groups.back().get(redsea::BLOCK1) == 0x22E1);
+  }
+
+  SECTION("Rejects scattered bit flips without soft-decision FEC") {
+    const std::string broken_group = [&]() {
+      std::string broken = correct_group;
+      flipAsciiBit(broken, 1);
+      flipAsciiBit(broken, 7);
+      flipAsciiBit(broken, 14);
+      return broken;
+    }();
+
+    const std::string test_data{correct_group + correct_group + broken_group};
+    const std::size_t start = 2 * correct_group.size();
+    const auto groups{
+        asciibin2groups(test_data, options, {start + 1, start + 7, start + 14, start + 20})};
+
+    REQUIRE_FALSE(groups.empty());
+    CHECK(groups.back().getNumErrors() == 1);
+    CHECK_FALSE(groups.back().has(redsea::BLOCK1));
+  }
+
   SECTION("Rejects double bit flip if FEC is disabled") {
     options.use_fec = false;
 
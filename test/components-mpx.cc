@@ -1,14 +1,26 @@
 // Redsea tests: Component tests that read MPX files
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include <sys/stat.h>
+
 #include <nlohmann/json.hpp>
 
 #include "../src/channel.hh"
 #include "../src/dsp/subcarrier.hh"
 #include "../src/io/input.hh"
 #include "../src/options.hh"
+#include "../src/pipeline.hh"
+#include "../src/util/thread_pool.hh"
+#include "test_helpers.hh"
 
 // Both Catch2 and liquid define a macro called DEPRECATED
 #ifdef DEPRECATED
@@ -35,6 +47,7 @@ TEST_CASE("MPX file input") {
   options.num_channels = mpx.getNumChannels();
 
   redsea::SubcarrierSet subcarriers(options.samplerate);
+  redsea::BitBuffer bits;
 
   std::stringstream output_stream;
 
@@ -45,7 +58,7 @@ TEST_CASE("MPX file input") {
     bool success{};
 
     while (!mpx.eof()) {
-      const auto bits = subcarriers.chunkToBits(mpx.readChunk(0), 1);
+      subcarriers.chunkToBits(mpx.readChunk(0), 1, bits);
 
       channel.processBits(bits, output_stream);
 
@@ -67,7 +80,7 @@ TEST_CASE("MPX file input") {
     std::vector<nlohmann::ordered_json> json;
 
     while (!mpx.eof()) {
-      const auto bits = subcarriers.chunkToBits(mpx.readChunk(0), 1);
+      subcarriers.chunkToBits(mpx.readChunk(0), 1, bits);
 
       channel.processBits(bits, output_stream);
 
@@ -93,7 +106,7 @@ TEST_CASE("MPX file input") {
     std::vector<nlohmann::ordered_json> json;
 
     while (!mpx.eof()) {
-      const auto bits = subcarriers.chunkToBits(mpx.readChunk(0), 1);
+      subcarriers.chunkToBits(mpx.readChunk(0), 1, bits);
       channel.processBits(bits, output_stream);
 
       if (!output_stream.str().empty()) {
@@ -131,12 +144,13 @@ TEST_CASE("RDS2/RFT station logo from MPX") {
   std::stringstream json_stream;
   redsea::Channel channel(options, 0);
   redsea::SubcarrierSet subcarriers(options.samplerate);
+  redsea::BitBuffer bits;
 
   constexpr int num_streams = 4;
   bool success{};
 
   while (!mpx.eof()) {
-    const auto bits = subcarriers.chunkToBits(mpx.readChunk(0), num_streams);
+    subcarriers.chunkToBits(mpx.readChunk(0), num_streams, bits);
 
     channel.processBits(bits, json_stream);
     if (!json_stream.str().empty()) {
@@ -183,13 +197,14 @@ TEST_CASE("Time from start") {
   std::stringstream json_stream;
   redsea::Channel channel(options, 0);
   redsea::SubcarrierSet subcarriers(options.samplerate);
+  redsea::BitBuffer bits;
 
   // One array element for each stream
   constexpr int kNStreams{4};
   std::array<std::vector<double>, kNStreams> seen_timestamps{};
 
   while (!mpx.eof()) {
-    const auto bits = subcarriers.chunkToBits(mpx.readChunk(0), kNStreams);
+    subcarriers.chunkToBits(mpx.readChunk(0), kNStreams, bits);
 
     channel.processBits(bits, json_stream);
     if (!json_stream.str().empty()) {
@@ -267,3 +282,477 @@ TEST_CASE("Time from start") {
     }
   }
 }
+
+TEST_CASE("Pipelined MPX decoding") {
+  redsea::Options options;
+
+  options.sndfilename = "../test/resources/rds2-minirds-192k.flac";
+  options.input_type  = redsea::InputType::MPX_container;
+  options.streams     = true;
+
+  const std::string serial_output = decodeMPXFile(options);
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate   = mpx.getSamplerate();
+  options.num_channels = mpx.getNumChannels();
+
+  std::vector<std::unique_ptr<redsea::Channel>> channels;
+  std::vector<std::unique_ptr<redsea::SubcarrierSet>> subcarriers;
+  channels.push_back(std::make_unique<redsea::Channel>(options, 0));
+  subcarriers.push_back(std::make_unique<redsea::SubcarrierSet>(options.samplerate));
+
+  std::stringstream output_stream;
+  redsea::MPXPipeline pipeline(options, channels, subcarriers);
+  pipeline.run(mpx, output_stream);
+
+  REQUIRE_FALSE(serial_output.empty());
+  CHECK(output_stream.str() == serial_output);
+}
+
+TEST_CASE("Pipelined MPX decoding after a lost carrier") {
+  // The test file, 12 seconds of silence, and the test file again. The subcarriers are reset
+  // during the silence, and that must happen before the same chunk as in the serial loop.
+  SF_INFO info{};
+  const auto samples = readSoundFile<float>("../test/resources/mpx-testfile-yksi.flac", info);
+  REQUIRE(samples.size() == static_cast<std::size_t>(info.frames * info.channels));
+
+  const TempFile float_file("carrier-lost.f32");
+  {
+    std::ofstream float_stream(float_file.path(), std::ios::binary);
+    for (const float sample : samples) writeFloatLE(float_stream, sample);
+    for (int i = 0; i < 12 * info.samplerate * info.channels; i++)
+      writeFloatLE(float_stream, 0.f);
+    for (const float sample : samples) writeFloatLE(float_stream, sample);
+  }
+
+  redsea::Options options;
+  options.sndfilename  = float_file.path();
+  options.input_type   = redsea::InputType::MPX_raw_stdin;
+  options.input_format = redsea::SampleFormat::F32LE;
+  options.samplerate   = static_cast<float>(info.samplerate);
+  options.num_channels = static_cast<std::uint32_t>(info.channels);
+
+  const std::string serial_output = decodeMPXFile(options);
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+
+  std::vector<std::unique_ptr<redsea::Channel>> channels;
+  std::vector<std::unique_ptr<redsea::SubcarrierSet>> subcarriers;
+  channels.push_back(std::make_unique<redsea::Channel>(options, 0));
+  subcarriers.push_back(std::make_unique<redsea::SubcarrierSet>(options.samplerate));
+
+  std::stringstream output_stream;
+  redsea::MPXPipeline pipeline(options, channels, subcarriers);
+  pipeline.run(mpx, output_stream);
+
+  REQUIRE_FALSE(serial_output.empty());
+  CHECK(output_stream.str() == serial_output);
+}
+
+TEST_CASE("RDS2 data streams in parallel") {
+  redsea::Options options;
+
+  options.sndfilename = "../test/resources/rds2-minirds-192k.flac";
+  options.input_type  = redsea::InputType::MPX_container;
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate = mpx.getSamplerate();
+
+  redsea::SubcarrierSet serial_subcarriers(options.samplerate);
+  redsea::ThreadPool stream_pool(3);
+  redsea::SubcarrierSet parallel_subcarriers(options.samplerate);
+  parallel_subcarriers.enableParallelStreams(stream_pool);
+
+  constexpr int kNStreams{4};
+  redsea::BitBuffer serial;
+  redsea::BitBuffer parallel;
+  bool has_bits{};
+  bool is_identical{true};
+
+  while (!mpx.eof()) {
+    const auto& chunk   = mpx.readChunk(0);
+    serial_subcarriers.chunkToBits(chunk, kNStreams, serial);
+    parallel_subcarriers.chunkToBits(chunk, kNStreams, parallel);
+
+    for (int n_stream{0}; n_stream < kNStreams; n_stream++) {
+      const auto& serial_bits   = serial.bits[n_stream];
+      const auto& parallel_bits = parallel.bits[n_stream];
+      has_bits                  = has_bits || !serial_bits.empty();
+
+      if (serial_bits.size() != parallel_bits.size()) {
+        is_identical = false;
+        continue;
+      }
+      for (std::size_t i = 0; i < serial_bits.size(); i++) {
+        if (serial_bits.get(i) != parallel_bits.get(i) ||
+            serial_bits.getSamplePosition(i) != parallel_bits.getSamplePosition(i))
+          is_identical = false;
+      }
+    }
+  }
+
+  CHECK(has_bits);
+  CHECK(is_identical);
+}
+
+TEST_CASE("FFT front end") {
+  redsea::Options options;
+
+  options.sndfilename = "../test/resources/rds2-minirds-192k.flac";
+  options.input_type  = redsea::InputType::MPX_container;
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate = mpx.getSamplerate();
+
+  redsea::SubcarrierSet time_domain_subcarriers(options.samplerate);
+  redsea::ThreadPool stream_pool(3);
+  redsea::SubcarrierSet fft_subcarriers(options.samplerate);
+  fft_subcarriers.enableFFTFrontEnd();
+  fft_subcarriers.enableParallelStreams(stream_pool);
+
+  constexpr int kNStreams{4};
+  redsea::BitBuffer time_domain;
+  redsea::BitBuffer fft;
+  std::size_t num_bits{};
+  std::size_t num_different_bits{};
+
+  while (!mpx.eof()) {
+    const auto& chunk = mpx.readChunk(0);
+    time_domain_subcarriers.chunkToBits(chunk, kNStreams, time_domain);
+    fft_subcarriers.chunkToBits(chunk, kNStreams, fft);
+
+    for (int n_stream{0}; n_stream < kNStreams; n_stream++) {
+      const auto& time_domain_bits = time_domain.bits[n_stream];
+      const auto& fft_bits         = fft.bits[n_stream];
+      REQUIRE(time_domain_bits.size() == fft_bits.size());
+
+      num_bits += time_domain_bits.size();
+      for (std::size_t i = 0; i < time_domain_bits.size(); i++) {
+        CHECK(time_domain_bits.getSamplePosition(i) == fft_bits.getSamplePosition(i));
+        if (time_domain_bits.get(i) != fft_bits.get(i))
+          num_different_bits++;
+      }
+    }
+  }
+
+  // The filters are the same, only rounding differs
+  CHECK(num_bits > 0);
+  CHECK(num_different_bits * 1000 < num_bits);
+}
+
+TEST_CASE("Native demodulator") {
+  // liquid-dsp's or our own AGC, phase detector and symbol timing recovery
+  redsea::Options options;
+  options.input_type = redsea::InputType::MPX_container;
+  const auto enableNativeDemod = [](redsea::SubcarrierSet& subcarriers) {
+    subcarriers.enableNativeDemod();
+  };
+
+  SECTION("RDS") {
+    options.sndfilename = "../test/resources/mpx-testfile-yksi.flac";
+  }
+
+  SECTION("RDS2 data streams") {
+    options.sndfilename = "../test/resources/rds2-minirds-192k.flac";
+    options.streams     = true;
+  }
+
+  const std::string liquid_output = decodeMPXFile(options);
+  const std::string native_output = decodeMPXFile(options, enableNativeDemod);
+  REQUIRE_FALSE(liquid_output.empty());
+  CHECK(native_output == liquid_output);
+}
+
+TEST_CASE("Lockstep demodulator") {
+  redsea::Options options;
+
+  options.sndfilename = "../test/resources/rds2-minirds-192k.flac";
+  options.input_type  = redsea::InputType::MPX_container;
+  options.streams     = true;
+
+  constexpr int kNStreams{4};
+  // Each channel gets the same signal; 12 lanes don't fit in one group
+  constexpr std::size_t kNumChannels{3};
+
+  const std::string serial_output = decodeMPXFile(options);
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate   = mpx.getSamplerate();
+  options.num_channels = mpx.getNumChannels();
+
+  std::vector<std::unique_ptr<redsea::Channel>> channels;
+  std::vector<std::unique_ptr<redsea::SubcarrierSet>> subcarriers;
+  for (std::size_t ch = 0; ch < kNumChannels; ch++) {
+    channels.push_back(std::make_unique<redsea::Channel>(options, 0));
+    subcarriers.push_back(std::make_unique<redsea::SubcarrierSet>(options.samplerate));
+  }
+
+  redsea::LockstepDemodulator demodulator(subcarriers, kNStreams);
+  std::vector<redsea::BitBuffer> bitbuffers(kNumChannels);
+  std::vector<const redsea::MPXBuffer*> chunks(kNumChannels);
+  std::vector<std::stringstream> output_streams(kNumChannels);
+
+  while (!mpx.eof()) {
+    const auto& chunk = mpx.readChunk(0);
+    std::fill(chunks.begin(), chunks.end(), &chunk);
+    demodulator.chunksToBits(chunks, bitbuffers);
+    for (std::size_t ch = 0; ch < kNumChannels; ch++)
+      channels[ch]->processBits(bitbuffers[ch], output_streams[ch]);
+  }
+
+  REQUIRE_FALSE(serial_output.empty());
+  for (std::size_t ch = 0; ch < kNumChannels; ch++) {
+    channels[ch]->flush(output_streams[ch]);
+    CHECK(output_streams[ch].str() == serial_output);
+  }
+}
+
+TEST_CASE("Memory-mapped input") {
+  // Decode the test file into 16-bit samples and write them back as WAV and raw PCM
+  redsea::Options flac_options;
+  flac_options.sndfilename = "../test/resources/mpx-testfile-yksi.flac";
+  flac_options.input_type  = redsea::InputType::MPX_container;
+
+  SF_INFO info{};
+  const auto samples = readSoundFile<std::int16_t>(flac_options.sndfilename, info);
+  REQUIRE(samples.size() == static_cast<std::size_t>(info.frames * info.channels));
+
+  const TempFile wav_file("mapped-input.wav");
+  const TempFile raw_file("mapped-input.raw");
+  const TempFile float_file("mapped-input.f32");
+
+  SF_INFO wav_info{};
+  wav_info.samplerate  = info.samplerate;
+  wav_info.channels    = info.channels;
+  wav_info.format      = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+  SNDFILE* wav_sndfile = ::sf_open(wav_file.path().c_str(), SFM_WRITE, &wav_info);
+  REQUIRE(wav_sndfile != nullptr);
+  ::sf_write_short(wav_sndfile, samples.data(), static_cast<sf_count_t>(samples.size()));
+  ::sf_close(wav_sndfile);
+
+  {
+    std::ofstream raw_stream(raw_file.path(), std::ios::binary);
+    for (const std::int16_t sample : samples) {
+      const auto bits = static_cast<std::uint16_t>(sample);
+      raw_stream.put(static_cast<char>(bits & 0xFFU));
+      raw_stream.put(static_cast<char>(bits >> 8U));
+    }
+
+    // Exactly the same values as libsndfile's conversion
+    std::ofstream float_stream(float_file.path(), std::ios::binary);
+    for (const std::int16_t sample : samples)
+      writeFloatLE(float_stream, static_cast<float>(sample) / 32768.f);
+  }
+
+  redsea::Options mapped_options;
+  SECTION("WAV") {
+    mapped_options.sndfilename = wav_file.path();
+    mapped_options.input_type  = redsea::InputType::MPX_container;
+  }
+  SECTION("Raw PCM") {
+    mapped_options.sndfilename  = raw_file.path();
+    mapped_options.input_type   = redsea::InputType::MPX_raw_stdin;
+    mapped_options.samplerate   = static_cast<float>(info.samplerate);
+    mapped_options.num_channels = static_cast<std::uint32_t>(info.channels);
+  }
+  SECTION("Raw 32-bit float") {
+    mapped_options.sndfilename  = float_file.path();
+    mapped_options.input_type   = redsea::InputType::MPX_raw_stdin;
+    mapped_options.input_format = redsea::SampleFormat::F32LE;
+    mapped_options.samplerate   = static_cast<float>(info.samplerate);
+    mapped_options.num_channels = static_cast<std::uint32_t>(info.channels);
+  }
+
+  // Same chunks as through libsndfile
+  redsea::MPXReader flac_mpx;
+  redsea::MPXReader mapped_mpx;
+  flac_mpx.init(flac_options);
+  mapped_mpx.init(mapped_options);
+  CHECK(mapped_mpx.getSamplerate() == flac_mpx.getSamplerate());
+  REQUIRE(mapped_mpx.getNumChannels() == flac_mpx.getNumChannels());
+
+  while (!flac_mpx.eof()) {
+    REQUIRE_FALSE(mapped_mpx.eof());
+    const auto& expected = flac_mpx.readChunk(0);
+    const auto& chunk    = mapped_mpx.readChunk(0);
+    REQUIRE(chunk.used_size == expected.used_size);
+    for (std::size_t i = 0; i < chunk.used_size; i++) REQUIRE(chunk.data[i] == expected.data[i]);
+  }
+  CHECK(mapped_mpx.eof());
+}
+
+TEST_CASE("Raw input file that can't be mapped") {
+  redsea::Options flac_options;
+  flac_options.sndfilename = "../test/resources/mpx-testfile-yksi.flac";
+  flac_options.input_type  = redsea::InputType::MPX_container;
+
+  SF_INFO info{};
+  const auto samples = readSoundFile<std::int16_t>(flac_options.sndfilename, info);
+
+  // A named pipe, fed from another thread
+  const TempFile fifo_file("unmapped-input.fifo");
+  REQUIRE(::mkfifo(fifo_file.path().c_str(), 0600) == 0);
+  std::thread writer([&samples, &fifo_file] {
+    std::ofstream raw_stream(fifo_file.path(), std::ios::binary);
+    for (const std::int16_t sample : samples) {
+      const auto bits = static_cast<std::uint16_t>(sample);
+      raw_stream.put(static_cast<char>(bits & 0xFFU));
+      raw_stream.put(static_cast<char>(bits >> 8U));
+    }
+  });
+
+  redsea::Options fifo_options;
+  fifo_options.sndfilename  = fifo_file.path();
+  fifo_options.input_type   = redsea::InputType::MPX_raw_stdin;
+  fifo_options.samplerate   = static_cast<float>(info.samplerate);
+  fifo_options.num_channels = static_cast<std::uint32_t>(info.channels);
+
+  redsea::MPXReader flac_mpx;
+  redsea::MPXReader fifo_mpx;
+  flac_mpx.init(flac_options);
+  fifo_mpx.init(fifo_options);
+
+  // Read to the end before checking, so that the writer isn't left blocked
+  bool is_same = true;
+  while (!fifo_mpx.eof()) {
+    const auto& chunk    = fifo_mpx.readChunk(0);
+    const auto& expected = flac_mpx.readChunk(0);
+    is_same              = is_same && chunk.used_size == expected.used_size &&
+              std::equal(chunk.data.begin(), chunk.data.begin() + chunk.used_size,
+                         expected.data.begin());
+  }
+  writer.join();
+
+  CHECK(is_same);
+  CHECK(flac_mpx.eof());
+}
+
+TEST_CASE("IQ input") {
+  // FM modulate the test file into complex baseband at the same sample rate, with the MPX at
+  // full scale deviating by 75 kHz
+  SF_INFO info{};
+  const auto samples = readSoundFile<float>("../test/resources/mpx-testfile-yksi.flac", info);
+  REQUIRE(samples.size() == static_cast<std::size_t>(info.frames * info.channels));
+
+  const TempFile iq_file("iq-input.cf32");
+  {
+    std::ofstream iq_stream(iq_file.path(), std::ios::binary);
+    double phase{};
+    for (std::size_t i = 0; i < samples.size(); i += static_cast<std::size_t>(info.channels)) {
+      phase += k2PiDouble * 75'000.0 * samples[i] / info.samplerate;
+      writeFloatLE(iq_stream, static_cast<float>(std::cos(phase)));
+      writeFloatLE(iq_stream, static_cast<float>(std::sin(phase)));
+    }
+  }
+
+  redsea::Options options;
+  options.sndfilename  = iq_file.path();
+  options.input_type   = redsea::InputType::MPX_raw_stdin;
+  options.input_format = redsea::SampleFormat::CF32LE;
+  options.samplerate   = static_cast<float>(info.samplerate);
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate = mpx.getSamplerate();
+
+  redsea::SubcarrierSet subcarriers(options.samplerate);
+  redsea::BitBuffer bits;
+  redsea::Channel channel(options, 0);
+  std::stringstream output_stream;
+  std::vector<nlohmann::ordered_json> json;
+
+  while (!mpx.eof()) {
+    subcarriers.chunkToBits(mpx.readChunk(0), 1, bits);
+    channel.processBits(bits, output_stream);
+
+    if (!output_stream.str().empty()) {
+      nlohmann::ordered_json jsonroot;
+      output_stream >> jsonroot;
+      json.push_back(jsonroot);
+
+      output_stream.str("");
+      output_stream.clear();
+    }
+  }
+
+  // Same as from the MPX file
+  CHECK(json.size() == 2);
+  CHECK(json.at(0)["pi"] == "0x6201");
+}
+
+TEST_CASE("Channelized IQ input") {
+  // The test file's station at +200 kHz in a 800 kS/s capture, which makes 4 channels
+  constexpr double kIQRate      = 800'000.0;
+  constexpr double kStationFreq = 200'000.0;
+  SF_INFO info{};
+  const auto samples = readSoundFile<float>("../test/resources/mpx-testfile-yksi.flac", info);
+  REQUIRE(samples.size() == static_cast<std::size_t>(info.frames * info.channels));
+
+  const TempFile iq_file("channelized-iq-input.cf32");
+  {
+    std::ofstream iq_stream(iq_file.path(), std::ios::binary);
+    double phase{};
+    const auto num_frames = static_cast<double>(info.frames);
+    for (double t = 0.0; t * info.samplerate < num_frames - 1.0; t += 1.0 / kIQRate) {
+      // MPX linearly interpolated up to the IQ rate
+      const double position = t * info.samplerate;
+      const auto i_frame    = static_cast<std::size_t>(position);
+      const double fraction = position - static_cast<double>(i_frame);
+      const double mpx      = (1.0 - fraction) * samples[i_frame * info.channels] +
+                         fraction * samples[(i_frame + 1) * info.channels];
+
+      phase += k2PiDouble * (kStationFreq + 75'000.0 * mpx) / kIQRate;
+      writeFloatLE(iq_stream, static_cast<float>(std::cos(phase)));
+      writeFloatLE(iq_stream, static_cast<float>(std::sin(phase)));
+    }
+  }
+
+  redsea::Options options;
+  options.sndfilename  = iq_file.path();
+  options.input_type   = redsea::InputType::MPX_raw_stdin;
+  options.input_format = redsea::SampleFormat::CF32LE;
+  options.samplerate   = static_cast<float>(kIQRate);
+  options.channelize   = true;
+
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate   = mpx.getSamplerate();
+  options.num_channels = mpx.getNumChannels();
+  REQUIRE(options.num_channels == 4);
+
+  std::vector<std::unique_ptr<redsea::SubcarrierSet>> subcarriers;
+  std::vector<std::unique_ptr<redsea::Channel>> channels;
+  for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
+    subcarriers.push_back(std::make_unique<redsea::SubcarrierSet>(options.samplerate));
+    channels.push_back(std::make_unique<redsea::Channel>(options, ch));
+  }
+  redsea::BitBuffer bits;
+  std::stringstream output_stream;
+  std::vector<nlohmann::ordered_json> json;
+
+  while (!mpx.eof()) {
+    for (std::uint32_t ch = 0; ch < options.num_channels; ch++) {
+      subcarriers[ch]->chunkToBits(mpx.readChunk(ch), 1, bits);
+      channels[ch]->processBits(bits, output_stream);
+
+      if (!output_stream.str().empty()) {
+        nlohmann::ordered_json jsonroot;
+        output_stream >> jsonroot;
+        if (jsonroot["channel"] == 3)
+          json.push_back(jsonroot);
+
+        output_stream.str("");
+        output_stream.clear();
+      }
+    }
+  }
+
+  // Same as from the MPX file, in the channel 200 kHz above the center
+  CHECK(json.size() == 2);
+  CHECK(json.at(0)["pi"] == "0x6201");
+}
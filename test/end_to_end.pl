@@ -395,6 +395,7 @@ sub test_VersionString {
 
     checkExitSuccess( runRedseaWithArgs(q{--version}) );
     checkStdoutMatches('^redsea');
+    checkStdoutMatches('DSP instruction set: (AVX-512|AVX2|SSE2|NEON|none)');
 
     # https://github.com/windytan/redsea/issues/140
     checkStderrEmpty();
@@ -5,14 +5,26 @@
 
 #include "../src/block_sync.hh"
 #include "../src/channel.hh"
+#include "../src/dsp/liquid_wrappers.hh"
+#include "../src/dsp/subcarrier.hh"
 #include "../src/group.hh"
 #include "../src/io/input.hh"
 #include "../src/options.hh"
 
+#include <sndfile.h>
+
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <initializer_list>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 using HexInputData = std::initializer_list<std::uint64_t>;
@@ -91,6 +103,27 @@ inline std::vector<redsea::Group> asciibin2groups(const std::string& bindata,
   return result;
 }
 
+// Same as above, but the demodulator is unsure about the bits at the given string positions.
+inline std::vector<redsea::Group> asciibin2groups(const std::string& bindata,
+                                                  const redsea::Options& options,
+                                                  const std::vector<std::size_t>& unreliable_bits) {
+  std::vector<redsea::Group> result;
+  redsea::BlockStream block_stream;
+  block_stream.init(options);
+
+  for (std::size_t i = 0; i < bindata.size(); i++) {
+    const bool is_unreliable = std::find(unreliable_bits.cbegin(), unreliable_bits.cend(), i) !=
+                               unreliable_bits.cend();
+
+    block_stream.pushBit(bindata[i] == '1', is_unreliable ? 10 : redsea::kMaxBitReliability);
+    if (block_stream.hasGroupReady()) {
+      result.push_back(block_stream.popGroup());
+    }
+  }
+
+  return result;
+}
+
 // Run redsea's full decoder and convert the ASCII JSON output back into JSON objects.
 inline std::vector<nlohmann::ordered_json> groups2json(const std::vector<redsea::Group>& data,
                                                        const redsea::Options& options,
@@ -141,4 +174,87 @@ inline void flipAsciiBit(std::string& str, size_t bit_index) {
   str[bit_index] = str[bit_index] == '0' ? '1' : '0';
 }
 
+// Decode the first channel of an MPX file one chunk at a time, the same way as redsea.cc does
+// with a single thread, and return the output.
+// \param configure Called on the SubcarrierSet before decoding, e.g. to enable an option
+inline std::string decodeMPXFile(
+    redsea::Options options,
+    const std::function<void(redsea::SubcarrierSet&)>& configure = nullptr) {
+  redsea::MPXReader mpx;
+  mpx.init(options);
+  options.samplerate   = mpx.getSamplerate();
+  options.num_channels = mpx.getNumChannels();
+
+  redsea::Channel channel(options, 0);
+  redsea::SubcarrierSet subcarriers(options.samplerate);
+  if (configure)
+    configure(subcarriers);
+
+  const int num_data_streams = options.streams ? 4 : 1;
+  redsea::BitBuffer bits;
+  std::stringstream output_stream;
+  while (!mpx.eof()) {
+    subcarriers.chunkToBits(mpx.readChunk(0), num_data_streams, bits);
+    channel.processBits(bits, output_stream);
+
+    if (channel.getSecondsSinceCarrierLost() > 10.f &&
+        subcarriers.getSecondsSinceLastReset() > 5.f) {
+      subcarriers.reset();
+      channel.resetPI();
+    }
+  }
+  channel.flush(output_stream);
+  return output_stream.str();
+}
+
+// A file in the system's temporary directory. It's removed when this goes out of scope, also when
+// a REQUIRE fails.
+class TempFile {
+ public:
+  explicit TempFile(const std::string& name)
+      : path_((std::filesystem::temp_directory_path() / ("redsea-test-" + name)).string()) {}
+  TempFile(const TempFile&)            = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  ~TempFile() {
+    static_cast<void>(std::remove(path_.c_str()));
+  }
+
+  [[nodiscard]] const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+};
+
+// Read all (interleaved) samples of a sound file with libsndfile, as int16 or float.
+template <typename T>
+std::vector<T> readSoundFile(const std::string& filename, SF_INFO& info) {
+  static_assert(std::is_same_v<T, std::int16_t> || std::is_same_v<T, float>);
+
+  info             = SF_INFO{};
+  SNDFILE* sndfile = ::sf_open(filename.c_str(), SFM_READ, &info);
+  std::vector<T> samples;
+  if (sndfile == nullptr)
+    return samples;
+
+  samples.resize(static_cast<std::size_t>(info.frames * info.channels));
+  sf_count_t num_read{};
+  if constexpr (std::is_same_v<T, std::int16_t>)
+    num_read = ::sf_read_short(sndfile, samples.data(), static_cast<sf_count_t>(samples.size()));
+  else
+    num_read = ::sf_read_float(sndfile, samples.data(), static_cast<sf_count_t>(samples.size()));
+  samples.resize(static_cast<std::size_t>(num_read));
+  ::sf_close(sndfile);
+  return samples;
+}
+
+// Write a float as 4 little-endian bytes (f32le / one half of cf32).
+inline void writeFloatLE(std::ostream& file, float value) {
+  std::uint32_t bits{};
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i_byte = 0; i_byte < 4; i_byte++)
+    file.put(static_cast<char>((bits >> (8 * i_byte)) & 0xFFU));
+}
+
 #endif  // TEST_HELPERS_H_
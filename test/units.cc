@@ -1,21 +1,55 @@
 // Redsea tests: Unit tests
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <variant>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
 
+#include "../src/dsp/coeff_cache.hh"
+#include "../src/dsp/decimator.hh"
+#include "../src/dsp/fft_frontend.hh"
+#include "../src/dsp/fixed_point.hh"
+#include "../src/dsp/fm_channelizer.hh"
+#include "../src/dsp/fm_discriminator.hh"
+#include "../src/dsp/halfband.hh"
+#include "../src/dsp/liquid_wrappers.hh"
+#include "../src/dsp/lockstep.hh"
+#include "../src/dsp/native_demod.hh"
+#include "../src/dsp/oscillator.hh"
+#include "../src/dsp/resampler.hh"
+#include "../src/io/async_reader.hh"
+#include "../src/io/bitbuffer.hh"
+#include "../src/io/input.hh"
+#include "../src/io/mapped_file.hh"
+#include "../src/io/raw_stream.hh"
+#include "../src/io/sample_format.hh"
 #include "../src/rft.hh"
 #include "../src/text/rdsstring.hh"
 #include "../src/util/base64.hh"
 #include "../src/util/csv.hh"
+#include "../src/util/spsc_ring.hh"
+#include "../src/util/thread_pool.hh"
 #include "../src/util/tree.hh"
 #include "../src/util/util.hh"
+#include "test_helpers.hh"
 
 TEST_CASE("Bitfield extraction") {
   constexpr std::uint16_t block1{0b0001'0010'0011'0100};
@@ -275,3 +309,964 @@ TEST_CASE("UTF-8 sanitization") {
     CHECK(redsea::sanitizeUtf8(std::string("test\xF0\x9F\x98")) == "test?");
   }
 }
+
+TEST_CASE("Filter coefficient cache") {
+  // A filter is designed only once, and equal coefficients are only stored once
+  const auto lowpass = redsea::getKaiserLowpass(63, 0.1f);
+  CHECK(redsea::getKaiserLowpass(63, 0.1f) == lowpass);
+  CHECK(redsea::getKaiserLowpass(63, 0.2f) != lowpass);
+  CHECK(*lowpass == liquid::designKaiserLowpass(63, 0.1f));
+  CHECK(redsea::shareCoeffs(liquid::designKaiserLowpass(63, 0.1f)) == lowpass);
+
+  const std::vector<std::int16_t> coeffs_q15{1, 2, 3};
+  CHECK(redsea::shareCoeffs(coeffs_q15) == redsea::shareCoeffs(coeffs_q15));
+  CHECK(redsea::shareCoeffs(coeffs_q15) != redsea::shareCoeffs(std::vector<std::int16_t>{1, 2}));
+}
+
+TEST_CASE("FIR decimator") {
+  const std::vector<float> coeffs{0.1f, -0.2f, 0.3f, 0.5f, 1.0f, 0.5f, 0.3f, -0.2f, 0.1f, 0.05f};
+  constexpr std::uint32_t kRatio = 3;
+
+  std::vector<std::complex<float>> input(200);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = {static_cast<float>(i % 7) - 3.f, static_cast<float>((i * 5) % 11) - 5.f};
+  }
+
+  // Reference: full-rate convolution, then keep every kRatio'th sample
+  std::vector<std::complex<float>> expected;
+  for (std::size_t n = 0; n < input.size(); n += kRatio) {
+    std::complex<float> sum;
+    for (std::size_t k = 0; k < coeffs.size() && k <= n; k++) sum += coeffs[k] * input[n - k];
+    expected.push_back(sum);
+  }
+
+  redsea::FIRDecimator decimator;
+  decimator.init(coeffs, kRatio);
+
+  // Odd block sizes, so that the decimation phase is carried over between blocks
+  std::vector<std::complex<float>> output;
+  std::size_t i_input{};
+  for (const std::size_t block_size : {1, 7, 13, 2, 0, 40, 37, 100}) {
+    const std::size_t expected_index = output.size() * kRatio - i_input;
+    CHECK(decimator.getNextOutputIndex() == expected_index);
+
+    std::vector<std::complex<float>> block_output(decimator.getOutputSize(block_size));
+    const auto num_output = decimator.execute(&input[i_input], block_size, block_output.data());
+    REQUIRE(num_output == block_output.size());
+    output.insert(output.end(), block_output.begin(), block_output.end());
+    i_input += block_size;
+  }
+  REQUIRE(i_input == input.size());
+  REQUIRE(output.size() == expected.size());
+
+  for (std::size_t i = 0; i < output.size(); i++) {
+    CHECK_THAT(output[i].real(), Catch::Matchers::WithinAbs(expected[i].real(), 1e-4));
+    CHECK_THAT(output[i].imag(), Catch::Matchers::WithinAbs(expected[i].imag(), 1e-4));
+  }
+
+  CHECK(decimator.getGroupDelay() == 4.5f);
+}
+
+TEST_CASE("Oscillator") {
+  constexpr float kFrequency = 2.0943951f;  // 57 kHz at 171 kHz
+
+  std::vector<float> input(5000);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<float>(i % 13) * 0.1f - 0.6f;
+  }
+
+  redsea::Oscillator oscillator;
+  oscillator.init(kFrequency);
+
+  // Block sizes that don't line up with the internal lanes or re-seeding interval
+  std::vector<std::complex<float>> output(input.size());
+  std::size_t i_input{};
+  for (const std::size_t block_size : {3, 1021, 8, 0, 2000, 1968}) {
+    oscillator.mixDown(&input[i_input], block_size, &output[i_input]);
+    i_input += block_size;
+  }
+  REQUIRE(i_input == input.size());
+
+  for (std::size_t i = 0; i < input.size(); i++) {
+    const double phase  = -static_cast<double>(kFrequency) * static_cast<double>(i);
+    const auto expected = static_cast<double>(input[i]) * std::polar(1.0, phase);
+    CHECK_THAT(output[i].real(), Catch::Matchers::WithinAbs(expected.real(), 1e-4));
+    CHECK_THAT(output[i].imag(), Catch::Matchers::WithinAbs(expected.imag(), 1e-4));
+  }
+}
+
+TEST_CASE("FFT front end") {
+  constexpr std::uint32_t kRatio = 24;
+  const std::vector<float> frequencies{2.0943951f, 2.4434610f, 2.6179939f, 2.7925268f};
+  const auto coeffs = liquid::designKaiserLowpass(255, 2400.f / 171000.f);
+
+  std::vector<float> input(20'000);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = std::sin(0.37f * static_cast<float>(i)) + static_cast<float>(i % 13) * 0.1f - 0.6f;
+  }
+
+  redsea::FFTFrontEnd front_end;
+  front_end.init(coeffs, kRatio, frequencies);
+
+  std::vector<redsea::Oscillator> oscillators(frequencies.size());
+  std::vector<redsea::FIRDecimator> decimators(frequencies.size());
+  for (std::size_t i_band = 0; i_band < frequencies.size(); i_band++) {
+    oscillators[i_band].init(frequencies[i_band]);
+    decimators[i_band].init(coeffs, kRatio);
+  }
+
+  std::vector<std::vector<std::complex<float>>> outputs(
+      frequencies.size(), std::vector<std::complex<float>>(input.size() / kRatio + 1));
+  std::vector<std::complex<float>*> output_pointers;
+  for (auto& output : outputs) output_pointers.push_back(output.data());
+
+  // Block sizes that don't line up with the FFT blocks or the decimation ratio
+  std::size_t i_input{};
+  for (const std::size_t block_size : {5000, 7, 0, 3001, 8192, 3800}) {
+    const std::size_t output_index = front_end.getNextOutputIndex();
+    const std::size_t num_output =
+        front_end.execute(&input[i_input], block_size, frequencies.size(), output_pointers.data());
+
+    for (std::size_t i_band = 0; i_band < frequencies.size(); i_band++) {
+      std::vector<std::complex<float>> baseband(block_size);
+      std::vector<std::complex<float>> expected(decimators[i_band].getOutputSize(block_size));
+      oscillators[i_band].mixDown(&input[i_input], block_size, baseband.data());
+      CHECK(decimators[i_band].getNextOutputIndex() == output_index);
+      REQUIRE(decimators[i_band].execute(baseband.data(), block_size, expected.data()) ==
+              num_output);
+
+      for (std::size_t i = 0; i < num_output; i++) {
+        CHECK_THAT(outputs[i_band][i].real(), Catch::Matchers::WithinAbs(expected[i].real(), 1e-4));
+        CHECK_THAT(outputs[i_band][i].imag(), Catch::Matchers::WithinAbs(expected[i].imag(), 1e-4));
+      }
+    }
+    i_input += block_size;
+  }
+  REQUIRE(i_input == input.size());
+}
+
+TEST_CASE("Lockstep front end") {
+  constexpr std::uint32_t kRatio  = 24;
+  constexpr float kAGCBandwidth   = 0.003f;
+  constexpr float kAGCInitialGain = 0.08f;
+  constexpr std::size_t kNumInput = 20'000;
+  const auto coeffs               = liquid::designKaiserLowpass(255, 2400.f / 171000.f);
+
+  // More lanes than fit in one group, so that the last group is partly unused
+  const std::size_t num_lanes = redsea::LockstepFrontEnd::kNumLanes + 3;
+  std::vector<float> frequencies;
+  std::vector<std::vector<float>> inputs(num_lanes, std::vector<float>(kNumInput));
+  for (std::size_t i_lane = 0; i_lane < num_lanes; i_lane++) {
+    frequencies.push_back(2.0943951f + 0.1f * static_cast<float>(i_lane));
+    for (std::size_t i = 0; i < kNumInput; i++) {
+      inputs[i_lane][i] = std::sin((0.37f + 0.01f * static_cast<float>(i_lane)) *
+                                   static_cast<float>(i)) +
+                          static_cast<float>((i + i_lane) % 13) * 0.1f - 0.6f;
+    }
+  }
+
+  redsea::LockstepFrontEnd front_end;
+  front_end.init(coeffs, kRatio, frequencies, kAGCBandwidth, kAGCInitialGain);
+  REQUIRE(front_end.getNumLanes() == num_lanes);
+
+  // Reference: each lane on its own
+  std::vector<redsea::Oscillator> oscillators(num_lanes);
+  std::vector<redsea::FIRDecimator> decimators(num_lanes);
+  std::vector<redsea::NativeAGC> agcs(num_lanes);
+  for (std::size_t i_lane = 0; i_lane < num_lanes; i_lane++) {
+    oscillators[i_lane].init(frequencies[i_lane]);
+    decimators[i_lane].init(coeffs, kRatio);
+    agcs[i_lane].init(kAGCBandwidth, kAGCInitialGain);
+  }
+
+  std::vector<std::vector<std::complex<float>>> outputs(
+      num_lanes, std::vector<std::complex<float>>(kNumInput / kRatio + 1));
+  std::vector<std::complex<float>*> output_pointers;
+  for (auto& output : outputs) output_pointers.push_back(output.data());
+
+  // Block sizes that don't line up with the decimation ratio or the oscillator's re-seeding
+  std::size_t i_input{};
+  for (const std::size_t block_size : {5000, 7, 0, 3001, 8192, 3800}) {
+    std::vector<const float*> input_pointers;
+    for (const auto& input : inputs) input_pointers.push_back(&input[i_input]);
+
+    const std::size_t output_index = front_end.getNextOutputIndex();
+    const std::size_t num_output =
+        front_end.execute(input_pointers.data(), block_size, output_pointers.data());
+
+    for (std::size_t i_lane = 0; i_lane < num_lanes; i_lane++) {
+      std::vector<std::complex<float>> baseband(block_size);
+      std::vector<std::complex<float>> expected(decimators[i_lane].getOutputSize(block_size));
+      oscillators[i_lane].mixDown(&inputs[i_lane][i_input], block_size, baseband.data());
+      CHECK(decimators[i_lane].getNextOutputIndex() == output_index);
+      REQUIRE(decimators[i_lane].execute(baseband.data(), block_size, expected.data()) ==
+              num_output);
+      agcs[i_lane].execute(expected.data(), num_output, expected.data());
+
+      for (std::size_t i = 0; i < num_output; i++) {
+        CHECK_THAT(outputs[i_lane][i].real(),
+                   Catch::Matchers::WithinAbs(expected[i].real(), 1e-3));
+        CHECK_THAT(outputs[i_lane][i].imag(),
+                   Catch::Matchers::WithinAbs(expected[i].imag(), 1e-3));
+      }
+    }
+    i_input += block_size;
+  }
+  REQUIRE(i_input == kNumInput);
+}
+
+TEST_CASE("Rational resampling ratio") {
+  SECTION("Common sample rates") {
+    const auto ratio = redsea::findRationalRatio(192000.f, 171000.f);
+    REQUIRE(ratio.has_value);
+    CHECK(ratio.value.interpolation == 57);
+    CHECK(ratio.value.decimation == 64);
+
+    CHECK(redsea::findRationalRatio(228000.f, 171000.f).value.interpolation == 3);
+    CHECK(redsea::findRationalRatio(250000.f, 171000.f).has_value);
+  }
+
+  SECTION("Odd sample rates") {
+    CHECK_FALSE(redsea::findRationalRatio(250001.f, 171000.f).has_value);
+    CHECK_FALSE(redsea::findRationalRatio(192000.5f, 171000.f).has_value);
+  }
+}
+
+TEST_CASE("Rational resampler") {
+  constexpr float kInputRate  = 48000.f;
+  constexpr float kOutputRate = 171000.f;
+  constexpr float kToneFreq   = 1000.f;
+
+  const auto ratio = redsea::findRationalRatio(kInputRate, kOutputRate);
+  REQUIRE(ratio.has_value);
+
+  redsea::RationalResampler resampler;
+  resampler.init(ratio.value, kInputRate, kInputRate / 2.f, 14000.f);
+
+  std::vector<float> input(4800);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = std::sin(k2Pi * kToneFreq * static_cast<float>(i) / kInputRate);
+  }
+
+  // Block sizes that don't line up with the ratio
+  std::vector<float> output;
+  std::size_t i_input{};
+  for (const std::size_t block_size : {1, 100, 0, 333, 4366}) {
+    std::vector<float> block_output(resampler.getMaxOutputSize(block_size));
+    const auto num_output = resampler.execute(&input[i_input], block_size, block_output.data());
+    REQUIRE(num_output <= block_output.size());
+    output.insert(output.end(), block_output.begin(), block_output.begin() + num_output);
+    i_input += block_size;
+  }
+  REQUIRE(i_input == input.size());
+  CHECK(output.size() == 17100);
+
+  // Skip the filter's warm-up
+  const float delay = resampler.getDelay();
+  for (std::size_t i = 1000; i < output.size(); i++) {
+    const double t        = (static_cast<double>(i) - delay) / kOutputRate;
+    const double expected = std::sin(static_cast<double>(k2Pi * kToneFreq) * t);
+    CHECK_THAT(output[i], Catch::Matchers::WithinAbs(expected, 1e-2));
+  }
+}
+
+TEST_CASE("Arbitrary-ratio resampler") {
+  constexpr float kRatio = 171000.f / 250000.f;
+
+  liquid::Resampler resampler(13);
+  resampler.setRatio(kRatio);
+
+  std::vector<float> input(10'000);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = std::sin(0.05f * static_cast<float>(i));
+  }
+
+  std::size_t num_output{};
+  std::size_t i_input{};
+  for (const std::size_t block_size : {1, 2, 0, 997, 4000, 5000}) {
+    std::vector<float> block_output(resampler.getMaxOutputSize(block_size));
+    const auto num_block_output =
+        resampler.execute(&input[i_input], block_size, block_output.data());
+    REQUIRE(num_block_output <= block_output.size());
+    num_output += num_block_output;
+    i_input += block_size;
+  }
+  REQUIRE(i_input == input.size());
+  CHECK_THAT(static_cast<float>(num_output),
+             Catch::Matchers::WithinAbs(static_cast<float>(input.size()) * kRatio, 2.f));
+}
+
+TEST_CASE("Symbol synchronizer") {
+  constexpr std::uint32_t kSamplesPerSymbol = 3;
+
+  liquid::SymSync symsync;
+  symsync.init(LIQUID_FIRFILT_RRC, kSamplesPerSymbol, 3, 0.8f, 32);
+  symsync.setOutputRate(1);
+
+  // Alternating symbols
+  std::vector<std::complex<float>> input(3000);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = (i / kSamplesPerSymbol) % 2 == 0 ? 1.f : -1.f;
+  }
+
+  std::vector<std::complex<float>> symbols;
+  std::vector<std::size_t> positions;
+  symsync.execute(input.data(), input.size(), symbols, positions);
+
+  REQUIRE(symbols.size() == positions.size());
+  CHECK_THAT(static_cast<double>(symbols.size()),
+             Catch::Matchers::WithinAbs(static_cast<double>(input.size() / kSamplesPerSymbol), 2.));
+  CHECK(std::is_sorted(positions.cbegin(), positions.cend()));
+  CHECK(positions.back() < input.size());
+}
+
+TEST_CASE("Native demodulator") {
+  SECTION("AGC") {
+    redsea::NativeAGC agc;
+    agc.init(0.01f, 1.f);
+
+    std::vector<std::complex<float>> samples(2000, std::complex<float>(0.f, 0.05f));
+    agc.execute(samples.data(), samples.size(), samples.data());
+    CHECK_THAT(std::abs(samples.back()), Catch::Matchers::WithinAbs(1.0, 0.01));
+  }
+
+  SECTION("BPSK phase error") {
+    CHECK(redsea::bpskPhaseError({1.f, 0.1f}) == 0.1f);
+    CHECK(redsea::bpskPhaseError({-1.f, 0.1f}) == -0.1f);
+    CHECK(redsea::bpskPhaseError({0.5f, -0.2f}) == -0.2f);
+  }
+
+  SECTION("Symbol timing recovery") {
+    // Biphase symbols at 171 kHz, with the transmitter's clock 200 ppm off
+    constexpr std::size_t kNumInput = 171'000;
+    constexpr double kSymbolLength  = 72. * 1.0002;
+    // In pairs
+    std::vector<float> symbol_values(
+        (static_cast<std::size_t>(kNumInput / kSymbolLength) / 2 + 1) * 2);
+    std::uint32_t lfsr{0xACE1U};
+    for (std::size_t i = 0; i < symbol_values.size(); i += 2) {
+      lfsr                 = (lfsr >> 1U) ^ (-(lfsr & 1U) & 0xB400U);
+      symbol_values[i]     = (lfsr & 1U) != 0 ? 1.f : -1.f;
+      symbol_values[i + 1] = -symbol_values[i];
+    }
+
+    std::vector<std::complex<float>> input(kNumInput);
+    for (std::size_t i = 0; i < input.size(); i++)
+      input[i] = symbol_values[static_cast<std::size_t>(static_cast<double>(i) / kSymbolLength)];
+
+    // Down to 3 samples per symbol, like the subcarriers
+    redsea::FIRDecimator decimator;
+    decimator.init(liquid::designKaiserLowpass(255, 2400.f / 171000.f), 24);
+    std::vector<std::complex<float>> decimated(decimator.getOutputSize(input.size()));
+    const std::size_t num_decimated =
+        decimator.execute(input.data(), input.size(), decimated.data());
+
+    redsea::GardnerSync<3> sync;
+    sync.init(3, 0.8f, 0.01f);
+
+    // Block sizes that don't line up with the symbols
+    std::vector<std::complex<float>> symbols;
+    std::vector<std::size_t> positions;
+    std::size_t i_input{};
+    for (const std::size_t block_size : {1, 100, 0, 2001, 4999}) {
+      REQUIRE(i_input + block_size <= num_decimated);
+      const std::size_t first_symbol = symbols.size();
+      sync.execute(&decimated[i_input], block_size, symbols, positions);
+      for (std::size_t i = first_symbol; i < symbols.size(); i++) {
+        CHECK(positions[i] < block_size);
+      }
+      i_input += block_size;
+    }
+    CHECK_THAT(static_cast<double>(symbols.size()),
+               Catch::Matchers::WithinAbs(static_cast<double>(i_input) / 3., 3.));
+
+    // After locking, every symbol matches the transmitted one, apart from the delay
+    std::size_t best_num_errors = symbols.size();
+    for (std::size_t delay = 0; delay < 20; delay++) {
+      std::size_t num_errors{};
+      for (std::size_t i = 500; i < symbols.size(); i++) {
+        if ((symbols[i].real() > 0.f) != (symbol_values[i - delay] > 0.f))
+          num_errors++;
+      }
+      best_num_errors = std::min(best_num_errors, num_errors);
+    }
+    CHECK(best_num_errors == 0);
+  }
+}
+
+TEST_CASE("Half-band decimator") {
+  constexpr float kInputRate = 400000.f;
+
+  auto decimate = [](float tone_freq) {
+    redsea::HalfbandDecimator decimator;
+    decimator.init(80000.f / kInputRate);
+
+    std::vector<float> input(4000);
+    for (std::size_t i = 0; i < input.size(); i++) {
+      input[i] = std::sin(k2Pi * tone_freq * static_cast<float>(i) / kInputRate);
+    }
+
+    // Odd block sizes, so that the decimation phase is carried over between blocks
+    std::vector<float> output;
+    std::size_t i_input{};
+    for (const std::size_t block_size : {1, 0, 999, 3000}) {
+      std::vector<float> block_output(decimator.getMaxOutputSize(block_size));
+      const auto num_output = decimator.execute(&input[i_input], block_size, block_output.data());
+      REQUIRE(num_output <= block_output.size());
+      output.insert(output.end(), block_output.begin(), block_output.begin() + num_output);
+      i_input += block_size;
+    }
+    REQUIRE(output.size() == input.size() / 2);
+    return std::make_pair(output, decimator.getGroupDelay());
+  };
+
+  SECTION("Passband") {
+    constexpr float kToneFreq  = 10000.f;
+    const auto [output, delay] = decimate(kToneFreq);
+
+    for (std::size_t i = 200; i < output.size(); i++) {
+      const double t        = (2.0 * static_cast<double>(i) - delay) / kInputRate;
+      const double expected = std::sin(static_cast<double>(k2Pi * kToneFreq) * t);
+      CHECK_THAT(output[i], Catch::Matchers::WithinAbs(expected, 1e-2));
+    }
+  }
+
+  SECTION("Aliases are suppressed") {
+    // Would alias to 10 kHz
+    const auto output = decimate(190000.f).first;
+
+    for (std::size_t i = 200; i < output.size(); i++) {
+      CHECK_THAT(output[i], Catch::Matchers::WithinAbs(0.0, 2e-3));
+    }
+  }
+}
+
+TEST_CASE("Fixed-point oscillator") {
+  constexpr float kFrequency = 2.0943951f;  // 57 kHz at 171 kHz
+
+  std::vector<std::int16_t> input(5000);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<std::int16_t>((static_cast<int>(i % 13) - 6) * 5000);
+  }
+
+  redsea::OscillatorQ15 oscillator;
+  oscillator.init(kFrequency);
+
+  std::vector<std::int16_t> output(2 * input.size());
+  std::size_t i_input{};
+  for (const std::size_t block_size : {3, 1021, 0, 3976}) {
+    oscillator.mixDown(&input[i_input], block_size, &output[2 * i_input]);
+    i_input += block_size;
+  }
+  REQUIRE(i_input == input.size());
+
+  for (std::size_t i = 0; i < input.size(); i++) {
+    const double phase  = -static_cast<double>(kFrequency) * static_cast<double>(i);
+    const auto expected = static_cast<double>(input[i]) / 32768.0 * std::polar(1.0, phase);
+    CHECK_THAT(output[2 * i] / 32768.0, Catch::Matchers::WithinAbs(expected.real(), 2e-3));
+    CHECK_THAT(output[2 * i + 1] / 32768.0, Catch::Matchers::WithinAbs(expected.imag(), 2e-3));
+  }
+}
+
+TEST_CASE("Fixed-point FIR decimator") {
+  // Exactly representable in Q15
+  const std::vector<float> coeffs{0.125f, -0.25f, 0.375f, 0.5f, 0.0625f, 0.5f, -0.03125f};
+  constexpr std::uint32_t kRatio = 4;
+
+  std::vector<std::int16_t> input(2 * 300);
+  for (std::size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<std::int16_t>(static_cast<int>((i * 7919) % 65536) - 32768);
+  }
+
+  // Reference: integer convolution, then keep every kRatio'th sample. Should be bit-exact.
+  std::vector<std::complex<float>> expected;
+  for (std::size_t n = 0; n < input.size() / 2; n += kRatio) {
+    std::int32_t sum_i{};
+    std::int32_t sum_q{};
+    for (std::size_t k = 0; k < coeffs.size() && k <= n; k++) {
+      const auto coeff = static_cast<std::int32_t>(coeffs[k] * 32768.f);
+      sum_i += coeff * input[2 * (n - k)];
+      sum_q += coeff * input[2 * (n - k) + 1];
+    }
+    expected.emplace_back(static_cast<float>(sum_i) / 1073741824.f,
+                          static_cast<float>(sum_q) / 1073741824.f);
+  }
+
+  redsea::FIRDecimatorQ15 decimator;
+  decimator.init(coeffs, kRatio);
+
+  std::vector<std::complex<float>> output;
+  std::size_t i_input{};
+  for (const std::size_t block_size : {1, 7, 13, 0, 79, 200}) {
+    std::vector<std::complex<float>> block_output(decimator.getOutputSize(block_size));
+    const auto num_output =
+        decimator.execute(&input[2 * i_input], block_size, block_output.data());
+    REQUIRE(num_output == block_output.size());
+    output.insert(output.end(), block_output.begin(), block_output.end());
+    i_input += block_size;
+  }
+  REQUIRE(2 * i_input == input.size());
+  REQUIRE(output.size() == expected.size());
+
+  for (std::size_t i = 0; i < output.size(); i++) {
+    CHECK(output[i] == expected[i]);
+  }
+}
+
+TEST_CASE("Thread pool") {
+  redsea::ThreadPool pool(4);
+  REQUIRE(pool.getNumThreads() == 4);
+
+  SECTION("Runs all tasks") {
+    std::vector<int> results(1000);
+    for (int round = 0; round < 3; round++) {
+      for (std::size_t i = 0; i < results.size(); i++) {
+        pool.submit([&results, i] { results[i]++; });
+      }
+      pool.wait();
+    }
+
+    for (const int result : results) CHECK(result == 3);
+  }
+
+  SECTION("Passes exceptions on to wait()") {
+    pool.submit([] { throw std::runtime_error("task failed"); });
+    CHECK_THROWS_AS(pool.wait(), std::runtime_error);
+
+    // Still usable afterwards
+    bool has_run{};
+    pool.submit([&has_run] { has_run = true; });
+    CHECK_NOTHROW(pool.wait());
+    CHECK(has_run);
+  }
+}
+
+TEST_CASE("SPSC ring") {
+  SECTION("Bounded") {
+    redsea::SPSCRing<int, 4> ring;
+    for (int i = 0; i < 4; i++) CHECK(ring.tryPush(i));
+    CHECK_FALSE(ring.tryPush(4));
+    CHECK(ring.size() == 4);
+    CHECK(ring.getPeakDepth() == 4);
+
+    int item{};
+    REQUIRE(ring.tryPop(item));
+    CHECK(item == 0);
+    CHECK(ring.tryPush(4));
+  }
+
+  SECTION("Keeps the order across threads") {
+    redsea::SPSCRing<int, 8> ring;
+    constexpr int kNumItems = 100000;
+
+    std::thread producer([&ring] {
+      for (int i = 0; i < kNumItems; i++) ring.push(i);
+    });
+
+    bool is_in_order{true};
+    for (int i = 0; i < kNumItems; i++) {
+      if (ring.pop() != i)
+        is_in_order = false;
+    }
+    producer.join();
+
+    CHECK(is_in_order);
+    CHECK(ring.size() == 0);
+    CHECK(ring.getPeakDepth() <= 8);
+  }
+
+  SECTION("Wakes up a sleeping consumer") {
+    redsea::SPSCRing<int, 4> ring;
+
+    // Slow producer, like a live input: the consumer goes to sleep between items
+    std::thread producer([&ring] {
+      for (int i = 0; i < 5; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ring.push(i);
+      }
+    });
+
+    bool is_in_order{true};
+    for (int i = 0; i < 5; i++) {
+      if (ring.pop() != i)
+        is_in_order = false;
+    }
+    producer.join();
+
+    CHECK(is_in_order);
+  }
+}
+
+TEST_CASE("Packed bits") {
+  redsea::PackedBits bits;
+
+  // A slip after bit 100 (symbol sync skipped a symbol)
+  for (std::size_t i = 0; i < 200; i++) {
+    const auto position =
+        static_cast<std::int32_t>(i * redsea::kSamplesPerBit) - 50 + (i > 100 ? 24 : 0);
+    bits.push(i % 3 == 0, position);
+  }
+
+  REQUIRE(bits.size() == 200);
+  for (std::size_t i = 0; i < bits.size(); i++) {
+    CHECK(bits.get(i) == (i % 3 == 0));
+    CHECK(bits.getSamplePosition(i) ==
+          static_cast<std::int32_t>(i * redsea::kSamplesPerBit) - 50 + (i > 100 ? 24 : 0));
+  }
+
+  bits.clear();
+  CHECK(bits.empty());
+  bits.push(true, 0);
+  CHECK(bits.get(0));
+  CHECK(bits.getSamplePosition(0) == 0);
+}
+
+TEST_CASE("Channel deinterleaving") {
+  // Not a multiple of the block size, so the remainder gets tested too
+  constexpr std::size_t num_frames = 250;
+
+  for (const std::uint32_t num_channels : {2U, 3U, 4U, 8U, 32U}) {
+    auto interleaved       = std::make_unique<redsea::MPXBuffer>();
+    auto interleaved_s16   = std::make_unique<redsea::MPXBufferS16>();
+    interleaved->used_size = interleaved_s16->used_size = num_frames * num_channels;
+    for (std::size_t i = 0; i < interleaved->used_size; i++) {
+      interleaved->data[i]     = static_cast<float>(i);
+      interleaved_s16->data[i] = static_cast<std::int16_t>(i);
+    }
+
+    std::vector<redsea::MPXBuffer> channels(num_channels);
+    std::vector<redsea::MPXBufferS16> channels_s16(num_channels);
+    redsea::deinterleave(*interleaved, num_channels, channels);
+    redsea::deinterleave(*interleaved_s16, num_channels, channels_s16);
+
+    for (std::uint32_t ch = 0; ch < num_channels; ch++) {
+      REQUIRE(channels[ch].used_size == num_frames);
+      REQUIRE(channels_s16[ch].used_size == num_frames);
+      for (std::size_t i = 0; i < num_frames; i++) {
+        CHECK(channels[ch].data[i] == static_cast<float>(i * num_channels + ch));
+        CHECK(channels_s16[ch].data[i] == static_cast<std::int16_t>(i * num_channels + ch));
+      }
+    }
+  }
+}
+
+TEST_CASE("WAV header parsing") {
+  std::vector<std::uint8_t> file;
+  auto append = [&file](const std::string& fourcc) {
+    file.insert(file.end(), fourcc.begin(), fourcc.end());
+  };
+  auto append16 = [&file](std::uint32_t value) {
+    file.push_back(static_cast<std::uint8_t>(value & 0xFFU));
+    file.push_back(static_cast<std::uint8_t>((value >> 8U) & 0xFFU));
+  };
+  auto append32 = [&](std::uint32_t value) {
+    append16(value & 0xFFFFU);
+    append16(value >> 16U);
+  };
+
+  SECTION("16-bit PCM with an odd-sized chunk before the data") {
+    append("RIFF");
+    append32(0);
+    append("WAVE");
+    append("fmt ");
+    append32(16);
+    append16(1);  // PCM
+    append16(2);  // Channels
+    append32(171000);
+    append32(171000 * 4);
+    append16(4);
+    append16(16);
+    append("LIST");
+    append32(3);
+    file.insert(file.end(), {'a', 'b', 'c', 0});
+    append("data");
+    append32(8);
+    file.insert(file.end(), 8, 0);
+
+    const auto layout = redsea::parseWAVHeader(file.data(), file.size());
+    REQUIRE(layout.has_value);
+    CHECK(layout.value.format == redsea::SampleFormat::S16LE);
+    CHECK(layout.value.num_channels == 2);
+    CHECK(layout.value.samplerate == 171000.f);
+    CHECK(layout.value.data_offset == file.size() - 8);
+    CHECK(layout.value.data_size == 8);
+  }
+
+  SECTION("Extensible float, data size missing") {
+    append("RIFF");
+    append32(0);
+    append("WAVE");
+    append("fmt ");
+    append32(40);
+    append16(0xFFFE);  // Extensible
+    append16(1);
+    append32(192000);
+    append32(192000 * 4);
+    append16(4);
+    append16(32);
+    append16(22);
+    append16(32);
+    append32(0);
+    append16(3);  // Sub-format: float
+    file.insert(file.end(), 14, 0);
+    append("data");
+    append32(0);
+    file.insert(file.end(), 12, 0);
+
+    const auto layout = redsea::parseWAVHeader(file.data(), file.size());
+    REQUIRE(layout.has_value);
+    CHECK(layout.value.format == redsea::SampleFormat::F32LE);
+    CHECK(layout.value.samplerate == 192000.f);
+    CHECK(layout.value.data_size == 12);
+  }
+
+  SECTION("Not a WAV file") {
+    append("fLaC");
+    file.insert(file.end(), 40, 0);
+    CHECK_FALSE(redsea::parseWAVHeader(file.data(), file.size()).has_value);
+  }
+}
+
+TEST_CASE("FM discriminator") {
+  SECTION("Arctangent") {
+    for (int i = -1000; i <= 1000; i++) {
+      const float angle = static_cast<float>(i) * 0.00314f;
+      for (const float radius : {1e-6f, 0.3f, 1.f, 3000.f}) {
+        const float y = radius * std::sin(angle);
+        const float x = radius * std::cos(angle);
+        REQUIRE_THAT(redsea::fastAtan2(y, x), Catch::Matchers::WithinAbs(std::atan2(y, x), 1e-6));
+      }
+    }
+    CHECK(redsea::fastAtan2(0.f, 0.f) == 0.f);
+  }
+
+  // Constant frequency offset; gives 1.0 at 75 kHz
+  auto demodulateTone = [](float iq_rate, float tone_freq) {
+    redsea::FMDiscriminator discriminator;
+    discriminator.init(iq_rate);
+
+    std::vector<float> in_i(8192);
+    std::vector<float> in_q(8192);
+    for (std::size_t n = 0; n < in_i.size(); n++) {
+      const double phase = k2PiDouble * tone_freq * static_cast<double>(n) / iq_rate;
+      in_i[n]            = static_cast<float>(std::cos(phase));
+      in_q[n]            = static_cast<float>(std::sin(phase));
+    }
+
+    std::vector<float> output(in_i.size());
+    const std::size_t num_output =
+        discriminator.execute(in_i.data(), in_q.data(), in_i.size(), output.data());
+    output.resize(num_output);
+    return std::make_pair(output, discriminator.getOutputSamplerate());
+  };
+
+  SECTION("No decimation") {
+    const auto [output, rate] = demodulateTone(228000.f, -15000.f);
+    CHECK(rate == 228000.f);
+    REQUIRE(output.size() == 8192);
+    for (std::size_t n = 1; n < output.size(); n++)
+      REQUIRE_THAT(output[n], Catch::Matchers::WithinAbs(-0.2f, 1e-5));
+  }
+
+  SECTION("Decimated to 300 kHz") {
+    const auto [output, rate] = demodulateTone(2400000.f, 30000.f);
+    CHECK(rate == 300000.f);
+    REQUIRE(output.size() == 1024);
+    // After the filters have settled
+    for (std::size_t n = 200; n < output.size(); n++)
+      REQUIRE_THAT(output[n], Catch::Matchers::WithinAbs(0.4f, 1e-3));
+  }
+}
+
+TEST_CASE("FM channelizer") {
+  constexpr float kIQRate = 2'400'000.f;
+
+  redsea::FMChannelizer channelizer;
+  channelizer.init(kIQRate);
+  REQUIRE(channelizer.getNumChannels() == 12);
+  CHECK(channelizer.getOutputSamplerate() == 400'000.f);
+  CHECK_THROWS_AS(redsea::FMChannelizer().init(2'200'000.f), std::runtime_error);
+  // More channels than kMaxNumChannels
+  CHECK_THROWS_AS(redsea::FMChannelizer().init(10'000'000.f), std::runtime_error);
+  CHECK(channelizer.getChannelOffset(6) == 0.f);
+  CHECK(channelizer.getChannelOffset(4) == -400'000.f);
+
+  // Unmodulated carriers, each off its channel's center by a constant deviation
+  struct Carrier {
+    std::uint32_t channel;
+    double deviation;
+  };
+  const std::vector<Carrier> carriers{{1, -60'000.0}, {4, 15'000.0}, {6, 45'000.0}, {9, -30'000.0}};
+
+  std::vector<std::complex<float>> input(60'003);
+  for (std::size_t n = 0; n < input.size(); n++) {
+    std::complex<double> sum;
+    for (const auto& carrier : carriers) {
+      const double freq = channelizer.getChannelOffset(carrier.channel) + carrier.deviation;
+      sum += std::polar(0.2, k2PiDouble * freq * static_cast<double>(n) / kIQRate);
+    }
+    input[n] = std::complex<float>(sum);
+  }
+
+  // Blocks split across calls are carried over
+  std::vector<std::vector<float>> outputs(channelizer.getNumChannels());
+  std::vector<std::vector<float>> buffers(channelizer.getNumChannels(),
+                                          std::vector<float>(input.size()));
+  std::vector<float*> buffer_pointers;
+  for (auto& buffer : buffers) buffer_pointers.push_back(buffer.data());
+  for (std::size_t position = 0; position < input.size(); position += 1001) {
+    const std::size_t num_output = channelizer.execute(
+        input.data() + position, std::min<std::size_t>(1001, input.size() - position),
+        buffer_pointers.data());
+    for (std::uint32_t ch = 0; ch < channelizer.getNumChannels(); ch++)
+      outputs[ch].insert(outputs[ch].end(), buffers[ch].cbegin(),
+                         buffers[ch].cbegin() + static_cast<std::ptrdiff_t>(num_output));
+  }
+
+  for (const auto& carrier : carriers) {
+    const auto& output = outputs[carrier.channel];
+    REQUIRE(output.size() == input.size() / 6);
+    // After the filters have settled
+    for (std::size_t n = 100; n < output.size(); n++)
+      REQUIRE_THAT(output[n], Catch::Matchers::WithinAbs(carrier.deviation / 75'000.0, 1e-3));
+  }
+}
+
+TEST_CASE("Raw sample conversion") {
+  using redsea::SampleFormat;
+
+  SECTION("Signed 16-bit") {
+    const std::array<std::uint8_t, 2> bytes{0x00, 0x80};
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::S16LE>(bytes.data()) == -1.f);
+    CHECK(redsea::loadSampleAsS16<SampleFormat::S16LE>(bytes.data()) == -32768);
+  }
+
+  SECTION("Signed 8-bit") {
+    const std::array<std::uint8_t, 2> bytes{0xC0, 0x40};
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::S8>(&bytes[0]) == -0.5f);
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::S8>(&bytes[1]) == 0.5f);
+    CHECK(redsea::loadSampleAsS16<SampleFormat::S8>(&bytes[0]) == -16384);
+  }
+
+  SECTION("Unsigned 8-bit") {
+    const std::array<std::uint8_t, 3> bytes{0x00, 0x80, 0xC0};
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::U8>(&bytes[0]) == -1.f);
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::U8>(&bytes[1]) == 0.f);
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::U8>(&bytes[2]) == 0.5f);
+    CHECK(redsea::loadSampleAsS16<SampleFormat::U8>(&bytes[2]) == 16384);
+  }
+
+  SECTION("32-bit float") {
+    // 0.25f and 2.f
+    const std::array<std::uint8_t, 8> bytes{0x00, 0x00, 0x80, 0x3E, 0x00, 0x00, 0x00, 0x40};
+    CHECK(redsea::loadSampleAsFloat<SampleFormat::F32LE>(&bytes[0]) == 0.25f);
+    CHECK(redsea::loadSampleAsS16<SampleFormat::F32LE>(&bytes[0]) == 8192);
+    // Clipped
+    CHECK(redsea::loadSampleAsS16<SampleFormat::F32LE>(&bytes[4]) == 32767);
+  }
+}
+
+TEST_CASE("Asynchronous reader") {
+  if (!redsea::AsyncReader::isAvailable())
+    SKIP("io_uring isn't built in or isn't allowed by the kernel");
+
+  // Longer than all the buffers together, and not a multiple of their size
+  std::vector<std::uint8_t> contents(10'000);
+  for (std::size_t i = 0; i < contents.size(); i++)
+    contents[i] = static_cast<std::uint8_t>(i * 7 + (i >> 8U));
+
+  std::vector<std::uint8_t> result;
+  auto readAll = [&result](int fd) {
+    redsea::AsyncReader reader(fd, 1024, 4);
+    std::vector<std::uint8_t> chunk(1500);
+    while (!reader.eof()) {
+      const std::size_t num_read = reader.read(chunk.data(), chunk.size());
+      result.insert(result.end(), chunk.begin(), chunk.begin() + num_read);
+    }
+  };
+
+  SECTION("Regular file") {
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    REQUIRE(std::fwrite(contents.data(), 1, contents.size(), file) == contents.size());
+    std::fflush(file);
+    std::rewind(file);
+
+    readAll(::fileno(file));
+    std::fclose(file);
+    CHECK(result == contents);
+  }
+
+  SECTION("Pipe") {
+    std::array<int, 2> fds{};
+    REQUIRE(::pipe(fds.data()) == 0);
+    // Written in small pieces so that reads come back short
+    std::thread writer([&contents, fds] {
+      for (std::size_t i = 0; i < contents.size(); i += 300) {
+        const std::size_t size = std::min<std::size_t>(300, contents.size() - i);
+        static_cast<void>(::write(fds[1], contents.data() + i, size));
+      }
+      ::close(fds[1]);
+    });
+
+    readAll(fds[0]);
+    writer.join();
+    ::close(fds[0]);
+    CHECK(result == contents);
+  }
+
+  SECTION("Leaving early on an idle pipe") {
+    std::array<int, 2> fds{};
+    REQUIRE(::pipe(fds.data()) == 0);
+    // Nothing is written and the writer stays open; the read in flight has to be cancelled, or
+    // this never returns
+    { redsea::AsyncReader reader(fds[0], 1024, 4); }
+    ::close(fds[1]);
+    ::close(fds[0]);
+  }
+}
+
+TEST_CASE("Raw stream feed-through") {
+  std::vector<std::uint8_t> contents(100'000);
+  for (std::size_t i = 0; i < contents.size(); i++)
+    contents[i] = static_cast<std::uint8_t>(i * 13 + (i >> 8U));
+
+  std::array<int, 2> input_fds{};
+  std::array<int, 2> echo_fds{};
+  REQUIRE(::pipe(input_fds.data()) == 0);
+  REQUIRE(::pipe(echo_fds.data()) == 0);
+
+  std::thread writer([&contents, input_fds] {
+    for (std::size_t i = 0; i < contents.size(); i += 3000) {
+      const std::size_t size = std::min<std::size_t>(3000, contents.size() - i);
+      static_cast<void>(::write(input_fds[1], contents.data() + i, size));
+    }
+    ::close(input_fds[1]);
+  });
+
+  std::vector<std::uint8_t> echoed;
+  std::thread echo_reader([&echoed, echo_fds] {
+    std::array<std::uint8_t, 4096> chunk{};
+    ssize_t num_read{};
+    while ((num_read = ::read(echo_fds[0], chunk.data(), chunk.size())) > 0)
+      echoed.insert(echoed.end(), chunk.begin(), chunk.begin() + num_read);
+  });
+
+  std::vector<std::uint8_t> result;
+  {
+    redsea::RawStreamReader reader(input_fds[0], echo_fds[1]);
+    std::vector<std::uint8_t> chunk(16384);
+    while (!reader.eof()) {
+      const std::size_t num_read = reader.read(chunk.data(), chunk.size());
+      result.insert(result.end(), chunk.begin(), chunk.begin() + num_read);
+    }
+  }
+  ::close(echo_fds[1]);
+  writer.join();
+  echo_reader.join();
+  ::close(input_fds[0]);
+  ::close(echo_fds[0]);
+
+  CHECK(result == contents);
+  CHECK(echoed == contents);
+}